@@ -0,0 +1,200 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file async_memento_originator.h
+ *
+ * @brief Captures the state of an object in O(1), creating the memento in the background
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 4:55 PM
+ */
+
+#ifndef ASYNC_MEMENTO_ORIGINATOR_H_20261018
+#define ASYNC_MEMENTO_ORIGINATOR_H_20261018
+
+#include <mwheel/memento_originator.h>
+#include <mwheel/singleton.h>
+#include <mwheel/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace mwheel {
+
+/**
+ * @brief Originator that keeps its state copy-on-write, so that capturing
+ * it doesn't stall the calling thread
+ *
+ * capture() freezes the current state by sharing it, which is O(1), and
+ * asks a thread pool to turn the frozen state into a memento (e.g. a deep
+ * copy, or a serialized form). Derived classes read their state with
+ * state() and modify it with mutable_state(): the first modification
+ * after a capture copies the state only if the capture is still in
+ * progress or someone else holds the frozen state. Otherwise the state is
+ * modified in place.
+ *
+ * @warning The originator is not thread-safe: only the mementos are
+ * created concurrently
+ *
+ * @tparam T type of the memento (may be abstract)
+ * @tparam State type of the state (must be copy constructible)
+ */
+template <class T, class State> class AsyncMementoOriginator : public MementoOriginator<T> {
+public:
+  /// Type of the memento associated with the interface
+  using memento_type = typename MementoOriginator<T>::memento_type;
+  /// Type of the state
+  using state_type = State;
+  /// Creates a memento from a frozen state (called on a worker thread)
+  using materializer_type = std::function<memento_type(const State &)>;
+  /// Memento being created in the background
+  using future_type = std::shared_future<memento_type>;
+
+  /**
+   * @brief Creates a memento on the calling thread
+   *
+   * @return memento of the current state
+   */
+  memento_type create_memento() const override { return (*m_materializer)(*m_state); }
+
+  /**
+   * @brief Freezes the current state and creates its memento in the background
+   *
+   * @return memento of the current state, once it is ready
+   */
+  future_type capture() const {
+    // Forget the captures that are over
+    m_captures.erase(std::remove_if(m_captures.begin(), m_captures.end(), is_ready),
+                     m_captures.end());
+    std::shared_ptr<const State> frozen = m_state;
+    auto materializer = m_materializer;
+    future_type outcome = m_pool
+                              .submit([frozen, materializer]() mutable {
+                                auto memento = (*materializer)(*frozen);
+                                // Done with the state: let the originator reuse it
+                                frozen.reset();
+                                return memento;
+                              })
+                              .share();
+    m_captures.push_back(outcome);
+    return outcome;
+  }
+
+  /**
+   * @brief Returns the number of times the state was copied by a
+   * modification that followed a capture
+   *
+   * @return number of copies of the state
+   */
+  std::size_t copies() const { return m_copies; }
+
+protected:
+  /**
+   * @brief Initializes the state of the originator
+   *
+   * @param[in] state initial state
+   * @param[in] materializer creates a memento from a frozen state
+   * @param[in] pool pool whose threads create the mementos (must outlive the originator)
+   */
+  AsyncMementoOriginator(std::shared_ptr<State> state, materializer_type materializer,
+                         ThreadPool &pool = Singleton<ThreadPool>::get_instance())
+      : m_state(std::move(state)),
+        m_materializer(std::make_shared<const materializer_type>(std::move(materializer))),
+        m_pool(pool), m_copies(0) {}
+
+  /**
+   * @brief Returns the state for reading
+   *
+   * @return current state
+   */
+  const State &state() const { return *m_state; }
+
+  /**
+   * @brief Returns the state for writing, copying it if a capture still uses it
+   *
+   * @return current state
+   */
+  State &mutable_state() {
+    // A finished capture happens before its future is ready: only then
+    // use_count can tell whether someone else kept the frozen state
+    auto idle = std::all_of(m_captures.begin(), m_captures.end(), is_ready);
+    if (!idle || m_state.use_count() > 1) {
+      m_state = std::make_shared<State>(*m_state);
+      ++m_copies;
+    }
+    m_captures.clear();
+    return *m_state;
+  }
+
+  /**
+   * @brief Replaces the state (e.g. when setting it from a memento)
+   *
+   * The state may be shared, e.g. with the memento it comes from: it is
+   * copied by the first modification.
+   *
+   * @param[in] state new state
+   */
+  void replace_state(std::shared_ptr<State> state) {
+    m_state = std::move(state);
+    m_captures.clear();
+  }
+
+private:
+  /**
+   * @brief Checks whether a capture is over
+   *
+   * @param[in] capture capture to be checked
+   *
+   * @return true if the memento is ready, false otherwise
+   */
+  static bool is_ready(const future_type &capture) {
+    return capture.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  /// Current state
+  std::shared_ptr<State> m_state;
+  /// Creates a memento from a frozen state
+  std::shared_ptr<const materializer_type> m_materializer;
+  /// Pool whose threads create the mementos
+  ThreadPool &m_pool;
+  /// Captures that may still use the current state
+  mutable std::vector<future_type> m_captures;
+  /// Number of copies of the state made by mutable_state
+  std::size_t m_copies;
+};
+}
+
+#endif /* ASYNC_MEMENTO_ORIGINATOR_H_20261018 */
@@ -0,0 +1,196 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file async_serializer.h
+ *
+ * @brief Serializes objects to disk without blocking the caller
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 9:15 PM
+ */
+
+#ifndef ASYNC_SERIALIZER_H_20261018
+#define ASYNC_SERIALIZER_H_20261018
+
+#include <mwheel/serializable_object.h>
+#include <mwheel/singleton.h>
+#include <mwheel/thread_pool.h>
+#include <mwheel/utility.h>
+
+#include <boost/filesystem.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+
+namespace mwheel {
+
+namespace implementation {
+class IoRing;
+struct IoRequest;
+}
+
+/**
+ * @brief Runs SerializableObject::serialize and deserialize in the
+ * background, returning a future for each of them
+ *
+ * On Linux kernels that support it, the states are (de)serialized in
+ * memory on a thread pool, and the files are read and written through an
+ * io_uring instance. Elsewhere, or if the ring can't be created, the
+ * path-based versions run on the thread pool.
+ *
+ * At most `queue_depth` operations are in flight at any time: further
+ * requests block the caller until an operation completes.
+ *
+ * @warning The objects must stay alive, and must not be used by anyone
+ * else, until their future is ready
+ */
+class AsyncSerializer {
+public:
+  /// @brief Exception stored in a future if a file can't be read or written
+  MWHEEL_RUNTIME_EXCEPTION(io_error);
+
+  /// How the files are read and written
+  enum class Backend {
+    io_uring,   ///< asynchronous system calls, completed by a dedicated thread
+    thread_pool ///< blocking system calls, on the thread pool
+  };
+
+  /// @brief Configuration of the serializer
+  struct Options {
+    Options() : queue_depth(64), use_io_uring(true) {}
+
+    /// Maximum number of operations in flight
+    std::size_t queue_depth;
+    /// If false the thread pool is used even if io_uring is available
+    bool use_io_uring;
+  };
+
+  /**
+   * @brief Creates a serializer
+   *
+   * @param[in] pool threads that (de)serialize the states
+   * @param[in] options configuration of the serializer
+   */
+  explicit AsyncSerializer(ThreadPool &pool = Singleton<ThreadPool>::get_instance(),
+                           Options options = Options());
+
+  AsyncSerializer(const AsyncSerializer &) = delete;
+  AsyncSerializer &operator=(const AsyncSerializer &) = delete;
+
+  /**
+   * @brief Serializes the state of an object in the background
+   *
+   * @param[in] object object to be serialized
+   * @param[in] path name of the file where to serialize object state
+   *
+   * @return future that becomes ready when the file is written, or holds what was thrown
+   */
+  std::future<void> serialize(const SerializableObject &object,
+                              const boost::filesystem::path &path);
+
+  /**
+   * @brief De-serializes the state of an object in the background
+   *
+   * @param[in,out] object object that receives the state
+   * @param[in] path name of the file where the state is stored
+   *
+   * @return future that becomes ready when the object is updated, or holds what was thrown
+   */
+  std::future<void> deserialize(SerializableObject &object, const boost::filesystem::path &path);
+
+  /**
+   * @brief Returns how the files are read and written
+   *
+   * @return backend in use
+   */
+  Backend backend() const;
+
+  /**
+   * @brief Returns the number of operations in flight
+   *
+   * @return number of operations in flight
+   */
+  std::size_t in_flight() const;
+
+  /**
+   * @brief Waits until no operation is in flight
+   */
+  void wait() const;
+
+  /**
+   * @brief Waits for the operations in flight, then releases the ring
+   */
+  ~AsyncSerializer();
+
+private:
+  /**
+   * @brief Blocks until an operation can be started, and accounts for it
+   */
+  void acquire();
+
+  /**
+   * @brief Accounts for an operation that completed
+   */
+  void release();
+
+  /**
+   * @brief Completes a request, and the operation it belongs to
+   *
+   * @param[in] request request whose I/O completed
+   * @param[in] result number of bytes transferred, or minus the error code
+   */
+  void complete(std::shared_ptr<implementation::IoRequest> request, int result);
+
+  /**
+   * @brief Sets the future of a request after its I/O completed
+   *
+   * @param[in] request request whose I/O is over
+   */
+  void finish(std::shared_ptr<implementation::IoRequest> request);
+
+  /// Threads that (de)serialize the states
+  ThreadPool &m_pool;
+  /// Maximum number of operations in flight
+  std::size_t m_queue_depth;
+  /// Ring used to read and write the files, null for the thread pool backend
+  std::unique_ptr<implementation::IoRing> m_ring;
+  /// Guards the number of operations in flight
+  mutable std::mutex m_mutex;
+  /// Signals that an operation completed
+  mutable std::condition_variable m_completed;
+  /// Number of operations in flight
+  std::size_t m_in_flight;
+};
+}
+
+#endif /* ASYNC_SERIALIZER_H_20261018 */
@@ -0,0 +1,301 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file byte_stream.h
+ *
+ * @brief Destinations and origins of serialized bytes
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 7:50 PM
+ */
+
+#ifndef BYTE_STREAM_H_20261018
+#define BYTE_STREAM_H_20261018
+
+#include <mwheel/utility.h>
+
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+namespace mwheel {
+
+/// @brief Contiguous range of bytes to be written
+struct ConstBuffer {
+  /// First byte of the range
+  const void *data;
+  /// Number of bytes in the range
+  std::size_t size;
+};
+
+/// @brief Contiguous range of bytes to be filled
+struct MutableBuffer {
+  /// First byte of the range
+  void *data;
+  /// Number of bytes in the range
+  std::size_t size;
+};
+
+/**
+ * @brief Destination of serialized bytes
+ */
+class ByteSink {
+public:
+  /// @brief Exception thrown if the bytes can't be written
+  MWHEEL_RUNTIME_EXCEPTION(write_error);
+
+  /**
+   * @brief Writes a contiguous range of bytes
+   *
+   * @param[in] data first byte
+   * @param[in] size number of bytes
+   *
+   * @throw write_error if the bytes can't be written
+   */
+  virtual void write(const void *data, std::size_t size) = 0;
+
+  /**
+   * @brief Writes several ranges of bytes, one after the other (gather)
+   *
+   * The default writes each range in turn.
+   *
+   * @param[in] buffers ranges of bytes
+   * @param[in] count number of ranges
+   *
+   * @throw write_error if the bytes can't be written
+   */
+  virtual void write(const ConstBuffer *buffers, std::size_t count);
+
+  /**
+   * @brief The infamous virtual destructor
+   */
+  virtual ~ByteSink();
+};
+
+/**
+ * @brief Origin of serialized bytes
+ */
+class ByteSource {
+public:
+  /// @brief Exception thrown if the bytes can't be read, or end too early
+  MWHEEL_RUNTIME_EXCEPTION(read_error);
+
+  /**
+   * @brief Reads at most `size` bytes
+   *
+   * @param[out] data where the bytes are stored
+   * @param[in] size maximum number of bytes
+   *
+   * @throw read_error if the bytes can't be read
+   *
+   * @return number of bytes read, 0 only at the end of the source
+   */
+  virtual std::size_t read_some(void *data, std::size_t size) = 0;
+
+  /**
+   * @brief Fills several ranges of bytes, one after the other (scatter)
+   *
+   * The default fills each range in turn.
+   *
+   * @param[in] buffers ranges of bytes
+   * @param[in] count number of ranges
+   *
+   * @throw read_error if the bytes can't be read, or the source ends first
+   */
+  virtual void read(const MutableBuffer *buffers, std::size_t count);
+
+  /**
+   * @brief Reads exactly `size` bytes
+   *
+   * @param[out] data where the bytes are stored
+   * @param[in] size number of bytes
+   *
+   * @throw read_error if the bytes can't be read, or the source ends first
+   */
+  void read(void *data, std::size_t size);
+
+  /**
+   * @brief The infamous virtual destructor
+   */
+  virtual ~ByteSource();
+};
+
+/**
+ * @brief Appends bytes to a vector
+ */
+class VectorSink : public ByteSink {
+public:
+  /**
+   * @brief Creates a sink that appends to a vector
+   *
+   * @param[in,out] buffer vector where the bytes are appended
+   */
+  explicit VectorSink(std::vector<char> &buffer) : m_buffer(buffer) {}
+
+  using ByteSink::write;
+  void write(const void *data, std::size_t size) override;
+
+private:
+  /// Vector where the bytes are appended
+  std::vector<char> &m_buffer;
+};
+
+/**
+ * @brief Reads bytes from a contiguous range of memory
+ */
+class MemorySource : public ByteSource {
+public:
+  /**
+   * @brief Creates a source that reads a range of memory (which is not copied)
+   *
+   * @param[in] data first byte
+   * @param[in] size number of bytes
+   */
+  MemorySource(const void *data, std::size_t size)
+      : m_position(static_cast<const char *>(data)),
+        m_end(static_cast<const char *>(data) + size) {}
+
+  using ByteSource::read;
+  std::size_t read_some(void *data, std::size_t size) override;
+
+  /**
+   * @brief Returns the bytes not read yet, to parse them in place
+   *
+   * @return first byte not read yet
+   */
+  const char *position() const { return m_position; }
+
+  /**
+   * @brief Returns the number of bytes not read yet
+   *
+   * @return number of bytes not read yet
+   */
+  std::size_t remaining() const { return static_cast<std::size_t>(m_end - m_position); }
+
+  /**
+   * @brief Skips bytes that were parsed in place
+   *
+   * @param[in] size number of bytes (at most remaining())
+   */
+  void skip(std::size_t size);
+
+private:
+  /// First byte not read yet
+  const char *m_position;
+  /// End of the range
+  const char *m_end;
+};
+
+/**
+ * @brief Writes bytes to a file descriptor (file, pipe, socket, ...)
+ */
+class FileDescriptorSink : public ByteSink {
+public:
+  /**
+   * @brief Creates a sink that writes to a file descriptor (which is not closed)
+   *
+   * @param[in] fd file descriptor open for writing
+   */
+  explicit FileDescriptorSink(int fd) : m_fd(fd) {}
+
+  void write(const void *data, std::size_t size) override;
+  void write(const ConstBuffer *buffers, std::size_t count) override;
+
+private:
+  /// File descriptor open for writing
+  int m_fd;
+};
+
+/**
+ * @brief Reads bytes from a file descriptor (file, pipe, socket, ...)
+ */
+class FileDescriptorSource : public ByteSource {
+public:
+  /**
+   * @brief Creates a source that reads from a file descriptor (which is not closed)
+   *
+   * @param[in] fd file descriptor open for reading
+   */
+  explicit FileDescriptorSource(int fd) : m_fd(fd) {}
+
+  using ByteSource::read;
+  std::size_t read_some(void *data, std::size_t size) override;
+  void read(const MutableBuffer *buffers, std::size_t count) override;
+
+private:
+  /// File descriptor open for reading
+  int m_fd;
+};
+
+/**
+ * @brief Writes bytes to a binary std::ostream
+ */
+class StreamSink : public ByteSink {
+public:
+  /**
+   * @brief Creates a sink that writes to a stream
+   *
+   * @param[in,out] stream binary stream
+   */
+  explicit StreamSink(std::ostream &stream) : m_stream(stream) {}
+
+  using ByteSink::write;
+  void write(const void *data, std::size_t size) override;
+
+private:
+  /// Binary stream
+  std::ostream &m_stream;
+};
+
+/**
+ * @brief Reads a given number of bytes from a binary std::istream
+ */
+class StreamSource : public ByteSource {
+public:
+  /**
+   * @brief Creates a source that reads from a stream
+   *
+   * @param[in,out] stream binary stream
+   * @param[in] size number of bytes that belong to the source
+   */
+  StreamSource(std::istream &stream, std::size_t size) : m_stream(stream), m_remaining(size) {}
+
+  using ByteSource::read;
+  std::size_t read_some(void *data, std::size_t size) override;
+
+private:
+  /// Binary stream
+  std::istream &m_stream;
+  /// Number of bytes not read yet
+  std::size_t m_remaining;
+};
+}
+
+#endif /* BYTE_STREAM_H_20261018 */
@@ -40,12 +40,25 @@
 #define COMPOSITE_BASE_H_20150604
 
 #include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace mwheel {
 
 /**
  * @brief Implements all the common operations needed by a composite object
+ *
+ * The ownership of the children is decided by StoredType:
+ * - `std::shared_ptr<InterfaceType>` (default) shares the children with the caller
+ * - `std::unique_ptr<InterfaceType>` makes the composite their sole owner, so that
+ * adding, moving or removing a child never touches an atomic reference count
+ * - `InterfaceType *` stores non-owning pointers, whose lifetime must be managed
+ * elsewhere (typically by an ObjectArena shared by the whole tree)
+ *
+ * @tparam InterfaceType interface implemented by the composite and by its children
+ * @tparam StoredType type used to store the children
  */
 template <class InterfaceType, class StoredType = std::shared_ptr<InterfaceType>>
 class CompositeBase : public InterfaceType {
@@ -114,10 +127,70 @@ public:
    *
    * @param[in] item item to be appended
    */
-  template <class T> void push_back(T &&item) { m_items.push_back(std::forward<T>(item)); }
+  template <class T> void push_back(T &&item) {
+    static_assert(std::is_constructible<StoredType, T &&>::value,
+                  "item is not convertible to StoredType (move-only types must be passed as "
+                  "rvalues, e.g. using std::move)");
+    m_items.push_back(std::forward<T>(item));
+  }
+
+  /**
+   * @brief Removes the item at specified location
+   *
+   * @param[in] position specified location
+   *
+   * @throws std::out_of_range if position is out of the range of the stored items
+   */
+  void erase(typename ContainerType::size_type position) {
+    check_range(position);
+    m_items.erase(m_items.begin() + position);
+  }
+
+  /**
+   * @brief Removes the last item
+   *
+   * @throws std::out_of_range if the composite is empty
+   */
+  void pop_back() {
+    check_range(0);
+    m_items.pop_back();
+  }
+
+  /**
+   * @brief Moves the item at specified location out of the composite
+   *
+   * Permits to re-parent a child without copying the StoredType (i.e. without
+   * reference count traffic for shared pointers)
+   *
+   * @param[in] position specified location
+   *
+   * @throws std::out_of_range if position is out of the range of the stored items
+   *
+   * @return the item that was stored at specified location
+   */
+  StoredType extract(typename ContainerType::size_type position) {
+    check_range(position);
+    auto item = std::move(m_items[position]);
+    m_items.erase(m_items.begin() + position);
+    return item;
+  }
 
 protected:
   ContainerType m_items;
+
+private:
+  /**
+   * @brief Checks that a position refers to a stored item
+   *
+   * @param[in] position position to be checked
+   *
+   * @throws std::out_of_range if position is out of the range of the stored items
+   */
+  void check_range(typename ContainerType::size_type position) const {
+    if (position >= m_items.size()) {
+      throw std::out_of_range("ERROR : position out of the range of the stored items");
+    }
+  }
 };
 }
 
@@ -0,0 +1,300 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file compression.h
+ *
+ * @brief Block-based compression of serialized states, with pluggable codecs
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 10:40 PM
+ */
+
+#ifndef COMPRESSION_H_20261018
+#define COMPRESSION_H_20261018
+
+#include <mwheel/byte_stream.h>
+#include <mwheel/plugin.h>
+#include <mwheel/singleton.h>
+#include <mwheel/thread_pool.h>
+#include <mwheel/utility.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mwheel {
+
+/**
+ * @brief Compresses and decompresses independent blocks of bytes
+ *
+ * Codecs are registered in their factory under a name, which is stored
+ * in every compressed stream. The library registers "identity", "lz" (a
+ * fast LZ77 variant with no dependencies) and, if zlib was found at build
+ * time, "zlib". Plug-ins may register more.
+ *
+ * Codecs must be stateless: the same object compresses many blocks at
+ * the same time.
+ */
+class Codec {
+public:
+  using clone_type = std::shared_ptr<Codec>;
+  MWHEEL_EXPOSE_INTERFACE_FACTORY(Codec, std::string);
+
+  /// @brief Exception thrown if compressed data can't be decoded
+  MWHEEL_RUNTIME_EXCEPTION(corrupted_data);
+
+  /**
+   * @brief Compresses a block
+   *
+   * @param[in] data first byte of the block
+   * @param[in] size number of bytes of the block
+   * @param[out] output where the compressed block is appended
+   */
+  virtual void compress(const char *data, std::size_t size, std::vector<char> &output) const = 0;
+
+  /**
+   * @brief Decompresses a block
+   *
+   * @param[in] data first byte of the compressed block
+   * @param[in] size number of bytes of the compressed block
+   * @param[out] output where the block is stored
+   * @param[in] original_size number of bytes of the block
+   *
+   * @throw corrupted_data if the block doesn't decompress to `original_size` bytes
+   */
+  virtual void decompress(const char *data, std::size_t size, char *output,
+                          std::size_t original_size) const = 0;
+
+  /**
+   * @brief Returns a new instance of the codec
+   */
+  virtual clone_type clone() = 0;
+
+  /**
+   * @brief The infamous virtual destructor
+   */
+  virtual ~Codec();
+};
+
+/**
+ * @brief Sink that compresses the bytes in fixed-size blocks before
+ * passing them on to another sink
+ *
+ * Full blocks are accumulated until there is one for each thread of the
+ * pool, then compressed in parallel and written in order. finish() writes
+ * the last block and an index with the position of each block, which
+ * CompressedReader uses to decompress any range without reading the
+ * others. Blocks that don't shrink are stored as they are.
+ *
+ * The stream starts with a magic string, the block size and the name of
+ * the codec. Each block has a header with its stored and original sizes,
+ * the CRC-32 of its original bytes and flags. An empty header ends the
+ * blocks, and is followed by the index and a trailer (offset of the
+ * index, number of blocks, original size and magic string). All the
+ * integers are little-endian.
+ */
+class CompressedSink : public ByteSink {
+public:
+  /// Default number of bytes of a block
+  static constexpr std::size_t default_block_size = 1 << 20;
+
+  /**
+   * @brief Starts a compressed stream
+   *
+   * @param[in,out] destination where the compressed stream is written
+   * @param[in] codec name of the codec in its factory
+   * @param[in] block_size number of bytes of a block
+   * @param[in] pool threads that compress the blocks
+   *
+   * @throw PrototypeFactory::tag_not_registered if the codec is unknown
+   */
+  CompressedSink(ByteSink &destination, const std::string &codec,
+                 std::size_t block_size = default_block_size,
+                 ThreadPool &pool = Singleton<ThreadPool>::get_instance());
+
+  CompressedSink(const CompressedSink &) = delete;
+  CompressedSink &operator=(const CompressedSink &) = delete;
+
+  using ByteSink::write;
+  void write(const void *data, std::size_t size) override;
+
+  /**
+   * @brief Writes the buffered bytes, the index and the trailer
+   *
+   * Nothing can be written afterwards. A stream that was not finished
+   * can't be read.
+   */
+  void finish();
+
+private:
+  /**
+   * @brief Compresses the buffered blocks in parallel, then writes them
+   */
+  void write_blocks();
+
+  /// Where the compressed stream is written
+  ByteSink &m_destination;
+  /// Codec that compresses the blocks
+  Codec::clone_type m_codec;
+  /// Number of bytes of a block
+  std::size_t m_block_size;
+  /// Threads that compress the blocks
+  ThreadPool &m_pool;
+  /// Blocks not compressed yet, the last one may be partial
+  std::vector<std::vector<char>> m_blocks;
+  /// Offset of each block written
+  std::vector<std::uint64_t> m_index;
+  /// Bytes written to the destination
+  std::uint64_t m_offset;
+  /// Bytes received
+  std::uint64_t m_size;
+  /// True after finish()
+  bool m_finished;
+};
+
+/**
+ * @brief Source that decompresses a stream written by CompressedSink, block by block
+ *
+ * The source ends with the last block: the index and the trailer are not read.
+ */
+class CompressedSource : public ByteSource {
+public:
+  /**
+   * @brief Reads the header of a compressed stream
+   *
+   * @param[in,out] source where the compressed stream is read
+   *
+   * @throw Codec::corrupted_data if the source is not a compressed stream
+   * @throw PrototypeFactory::tag_not_registered if the codec is unknown
+   */
+  explicit CompressedSource(ByteSource &source);
+
+  using ByteSource::read;
+  std::size_t read_some(void *data, std::size_t size) override;
+
+private:
+  /**
+   * @brief Decompresses the next block
+   *
+   * @return false if there are no more blocks
+   */
+  bool next_block();
+
+  /// Where the compressed stream is read
+  ByteSource &m_source;
+  /// Codec that decompresses the blocks
+  Codec::clone_type m_codec;
+  /// Block size of the stream
+  std::size_t m_block_size;
+  /// Current block, decompressed
+  std::vector<char> m_block;
+  /// Compressed bytes of the current block
+  std::vector<char> m_compressed;
+  /// Bytes of the current block already read
+  std::size_t m_position;
+  /// True after the last block
+  bool m_ended;
+};
+
+/**
+ * @brief Decompresses any range of a compressed stream held in memory
+ * (e.g. a MappedFile), using its index
+ */
+class CompressedReader {
+public:
+  /**
+   * @brief Reads the index of a compressed stream
+   *
+   * @param[in] data first byte of the stream (not copied)
+   * @param[in] size number of bytes of the stream
+   * @param[in] pool threads that decompress the blocks
+   *
+   * @throw Codec::corrupted_data if the range is not a finished compressed stream
+   * @throw PrototypeFactory::tag_not_registered if the codec is unknown
+   */
+  CompressedReader(const char *data, std::size_t size,
+                   ThreadPool &pool = Singleton<ThreadPool>::get_instance());
+
+  /**
+   * @brief Returns the number of bytes before compression
+   *
+   * @return number of bytes before compression
+   */
+  std::size_t size() const { return m_size; }
+
+  /**
+   * @brief Returns the number of blocks
+   *
+   * @return number of blocks
+   */
+  std::size_t blocks() const { return m_index.size(); }
+
+  /**
+   * @brief Decompresses a range of bytes, in parallel if it spans many blocks
+   *
+   * @param[in] offset first byte of the range
+   * @param[in] size number of bytes of the range
+   * @param[out] output where the bytes are stored
+   *
+   * @throw Codec::corrupted_data if the range is out of bounds, or a block is corrupted
+   */
+  void read(std::size_t offset, std::size_t size, char *output) const;
+
+private:
+  /**
+   * @brief Decompresses part of a block
+   *
+   * @param[in] block index of the block
+   * @param[in] first first byte of the block to be copied
+   * @param[in] size number of bytes to be copied
+   * @param[out] output where the bytes are stored
+   */
+  void read_block(std::size_t block, std::size_t first, std::size_t size, char *output) const;
+
+  /// First byte of the stream
+  const char *m_data;
+  /// Number of bytes of the stream
+  std::size_t m_stream_size;
+  /// Codec that decompresses the blocks
+  Codec::clone_type m_codec;
+  /// Block size of the stream
+  std::size_t m_block_size;
+  /// Number of bytes before compression
+  std::size_t m_size;
+  /// Offset of each block
+  std::vector<std::uint64_t> m_index;
+  /// Threads that decompress the blocks
+  ThreadPool &m_pool;
+};
+}
+
+#endif /* COMPRESSION_H_20261018 */
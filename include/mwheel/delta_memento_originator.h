@@ -0,0 +1,433 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file delta_memento_originator.h
+ *
+ * @brief Checkpoints the state of an object by recording its changes
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 2:05 PM
+ */
+
+#ifndef DELTA_MEMENTO_ORIGINATOR_H_20261018
+#define DELTA_MEMENTO_ORIGINATOR_H_20261018
+
+#include <mwheel/memento_originator.h>
+#include <mwheel/memento_pool.h>
+#include <mwheel/utility.h>
+
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mwheel {
+
+template <class Delta> class DeltaMementoOriginator;
+template <class Delta> class MementoHistory;
+
+namespace implementation {
+/**
+ * @brief Spare vectors of changes, given back by the released mementos
+ *
+ * Lets an originator store its next changes in the memory of the
+ * mementos it released. Only the thread that created the recycler uses
+ * the spare vectors, so that no synchronization is needed: vectors
+ * released on other threads are simply freed.
+ *
+ * @tparam Delta type of the changes
+ */
+template <class Delta> class DeltaRecycler {
+public:
+  /// @brief Counters of the recycler
+  struct Statistics {
+    /// Number of vectors taken from the spare ones
+    std::size_t reuses;
+    /// Number of spare vectors
+    std::size_t spare_vectors;
+  };
+
+  DeltaRecycler() : m_owner(std::this_thread::get_id()), m_reuses(0) {}
+
+  DeltaRecycler(const DeltaRecycler &) = delete;
+  DeltaRecycler &operator=(const DeltaRecycler &) = delete;
+
+  /**
+   * @brief Returns an empty vector, with the memory of a released one if possible
+   *
+   * @return empty vector of changes
+   */
+  std::vector<Delta> take() {
+    std::vector<Delta> deltas;
+    if (std::this_thread::get_id() == m_owner && !m_spare.empty()) {
+      deltas.swap(m_spare.back());
+      m_spare.pop_back();
+      ++m_reuses;
+    }
+    return deltas;
+  }
+
+  /**
+   * @brief Keeps the memory of a vector for later use
+   *
+   * @param[in,out] deltas vector of changes, left empty
+   */
+  void give(std::vector<Delta> &deltas) {
+    if (std::this_thread::get_id() != m_owner || deltas.capacity() == 0 ||
+        m_spare.size() == max_spare) {
+      return;
+    }
+    deltas.clear();
+    m_spare.push_back(std::vector<Delta>());
+    m_spare.back().swap(deltas);
+  }
+
+  /**
+   * @brief Returns the counters of the recycler
+   *
+   * @return counters of the recycler
+   */
+  Statistics statistics() const { return Statistics{m_reuses, m_spare.size()}; }
+
+private:
+  /// Maximum number of spare vectors
+  static const std::size_t max_spare = 8;
+
+  /// Only thread that takes or gives vectors
+  const std::thread::id m_owner;
+  /// Vectors given back by the released mementos
+  std::vector<std::vector<Delta>> m_spare;
+  /// Number of vectors taken from the spare ones
+  std::size_t m_reuses;
+};
+}
+
+/**
+ * @brief Checkpoint made of the changes since the previous checkpoint
+ *
+ * Mementos form a tree rooted at the initial state of their originator:
+ * each one stores the deltas that lead from its parent to itself, and
+ * is immutable once created. Keeping a memento alive keeps alive all its
+ * ancestors, which are shared with the other mementos.
+ *
+ * @tparam Delta type of the changes
+ */
+template <class Delta> class DeltaMemento {
+public:
+  /// Type of the changes
+  using delta_type = Delta;
+
+  /// Restricts the creation of mementos to their originator and history
+  class Key {
+    friend class DeltaMementoOriginator<Delta>;
+    friend class MementoHistory<Delta>;
+    Key() {}
+  };
+
+  /**
+   * @brief Creates a memento
+   *
+   * @param[in] parent memento this one is taken after, nullptr for the initial state
+   * @param[in] deltas changes since the parent
+   * @param[in] recycler where the changes are given back on destruction (optional)
+   */
+  DeltaMemento(Key, std::shared_ptr<DeltaMemento> parent, std::vector<Delta> deltas,
+               std::shared_ptr<implementation::DeltaRecycler<Delta>> recycler = nullptr)
+      : m_parent(std::move(parent)), m_deltas(std::move(deltas)),
+        m_depth(m_parent ? m_parent->m_depth + 1 : 0), m_root(m_parent ? m_parent->m_root : this),
+        m_recycler(std::move(recycler)) {}
+
+  DeltaMemento(const DeltaMemento &) = delete;
+  DeltaMemento &operator=(const DeltaMemento &) = delete;
+
+  /**
+   * @brief Returns the memento this one was taken after
+   *
+   * @return parent of the memento, nullptr for the initial state
+   */
+  const std::shared_ptr<DeltaMemento> &parent() const { return m_parent; }
+
+  /**
+   * @brief Returns the changes since the parent memento
+   *
+   * @return changes since the parent memento, in the order they were made
+   */
+  const std::vector<Delta> &deltas() const { return m_deltas; }
+
+  /**
+   * @brief Returns the number of ancestors of the memento
+   *
+   * @return number of ancestors of the memento
+   */
+  std::size_t depth() const { return m_depth; }
+
+  /**
+   * @brief Returns the memento of the initial state of the originator
+   *
+   * @return first ancestor of the memento (itself for the initial state)
+   */
+  const DeltaMemento *root() const { return m_root; }
+
+  /**
+   * @brief Releases the ancestors iteratively, so that long chains can't
+   * overflow the stack, and gives the changes back to the recycler
+   */
+  ~DeltaMemento() {
+    auto ancestor = std::move(m_parent);
+    while (ancestor && ancestor.use_count() == 1) {
+      auto next = std::move(ancestor->m_parent);
+      ancestor = std::move(next);
+    }
+    if (m_recycler) {
+      m_recycler->give(m_deltas);
+    }
+  }
+
+private:
+  /// Memento this one was taken after
+  std::shared_ptr<DeltaMemento> m_parent;
+  /// Changes since the parent
+  std::vector<Delta> m_deltas;
+  /// Number of ancestors
+  std::size_t m_depth;
+  /// Memento of the initial state of the originator
+  const DeltaMemento *m_root;
+  /// Where the changes are given back on destruction
+  std::shared_ptr<implementation::DeltaRecycler<Delta>> m_recycler;
+};
+
+/**
+ * @brief Originator whose checkpoints cost as much as the changes they record
+ *
+ * Derived classes call record() for every change to their state, and
+ * implement apply() and revert(). Creating a memento moves the changes
+ * recorded since the previous one into a new DeltaMemento; setting the
+ * state reverts the changes up to the closest common ancestor of the
+ * current state and the memento, then applies the changes down to it.
+ *
+ * @warning Not thread-safe: mementos may be shared among threads, the
+ * originator may not
+ *
+ * @tparam Delta type of the changes (moved into the mementos, never copied)
+ */
+template <class Delta>
+class DeltaMementoOriginator : public MementoOriginator<DeltaMemento<Delta>> {
+public:
+  /// Exception thrown when setting the state from a memento of another originator
+  MWHEEL_RUNTIME_EXCEPTION(foreign_memento);
+
+  /// Type of the memento associated with the interface
+  using memento_type = typename MementoOriginator<DeltaMemento<Delta>>::memento_type;
+
+  /**
+   * @brief Creates a memento with the changes recorded since the last one
+   *
+   * The changes are moved into the memento, and the next ones are
+   * recorded in the memory of a memento that was released, if any.
+   *
+   * @return the current memento if nothing changed, a new one otherwise
+   */
+  memento_type create_memento() const final {
+    if (!m_pending.empty()) {
+      m_head = m_pool.make(typename DeltaMemento<Delta>::Key(), std::move(m_head),
+                           std::move(m_pending), m_recycler);
+      m_pending = m_recycler->take();
+    }
+    return m_head;
+  }
+
+  /**
+   * @brief Brings the object to the state of a memento
+   *
+   * @param[in] token memento created by this object
+   *
+   * @throw foreign_memento if the memento was created by another object
+   */
+  void set_state(memento_type token) final {
+    if (!token || token->root() != m_head->root()) {
+      std::stringstream estream;
+      estream << "ERROR : cannot set the state of an object from a memento it didn't create"
+              << std::endl;
+      throw foreign_memento(estream.str());
+    }
+    // Find the closest common ancestor, and the path down to the memento
+    auto current = m_head.get();
+    auto target = token.get();
+    std::vector<const DeltaMemento<Delta> *> forward;
+    while (target->depth() > current->depth()) {
+      forward.push_back(target);
+      target = target->parent().get();
+    }
+    while (current->depth() > target->depth()) {
+      current = current->parent().get();
+    }
+    while (current != target) {
+      forward.push_back(target);
+      current = current->parent().get();
+      target = target->parent().get();
+    }
+    // Revert the changes not yet in a memento, then those down to the ancestor
+    for (auto it = m_pending.rbegin(); it != m_pending.rend(); ++it) {
+      revert(*it);
+    }
+    m_pending.clear();
+    for (auto node = m_head.get(); node != current; node = node->parent().get()) {
+      const auto &deltas = node->deltas();
+      for (auto it = deltas.rbegin(); it != deltas.rend(); ++it) {
+        revert(*it);
+      }
+    }
+    for (auto it = forward.rbegin(); it != forward.rend(); ++it) {
+      for (const auto &delta : (*it)->deltas()) {
+        apply(delta);
+      }
+    }
+    m_head = std::move(token);
+  }
+
+  /**
+   * @brief Returns the number of changes recorded since the last memento
+   *
+   * @return number of changes recorded since the last memento
+   */
+  std::size_t pending_changes() const { return m_pending.size(); }
+
+  /**
+   * @brief Returns the counters of the pool that recycles the mementos
+   *
+   * Mementos released by set_state, or evicted by a MementoHistory, give
+   * their memory back to the pool (the changes they store excluded).
+   *
+   * @return number of mementos allocated, reused and available
+   */
+  typename MementoPool<DeltaMemento<Delta>>::Statistics pool_statistics() const {
+    return m_pool.statistics();
+  }
+
+  /**
+   * @brief Returns the counters of the recycler of the changes
+   *
+   * Mementos released on the thread that created the originator give the
+   * memory of their changes back, to record the next changes.
+   *
+   * @return number of vectors of changes reused and available
+   */
+  typename implementation::DeltaRecycler<Delta>::Statistics delta_statistics() const {
+    return m_recycler->statistics();
+  }
+
+  /**
+   * @brief Replaces the current memento with an equivalent one
+   *
+   * Used by MementoHistory to let the originator drop the chain of
+   * mementos it compacted. Does nothing if the current memento is not
+   * the one being replaced.
+   *
+   * @param[in] previous memento being replaced
+   * @param[in] equivalent memento that leads to the same state
+   *
+   * @throw foreign_memento if the replacement was not derived from the
+   * initial state of this object
+   */
+  void replace_memento(const memento_type &previous, memento_type equivalent) {
+    if (m_head != previous) {
+      return;
+    }
+    if (!equivalent || equivalent->root() != m_head->root()) {
+      std::stringstream estream;
+      estream << "ERROR : cannot replace the memento of an object with one it didn't create"
+              << std::endl;
+      throw foreign_memento(estream.str());
+    }
+    m_head = std::move(equivalent);
+  }
+
+  /**
+   * @brief Merges a sequence of changes into an equivalent shorter one
+   *
+   * Called by MementoHistory when it compacts consecutive mementos.
+   * Override it so that merging every change since the initial state
+   * yields a full checkpoint (e.g. by keeping a single change per element
+   * of the state). The default can't merge anything: a history then keeps
+   * every change, with neither keyframes nor evictions.
+   *
+   * @param[in,out] deltas changes in the order they were made
+   *
+   * @return true if the changes were merged, false if they can't be
+   */
+  virtual bool coalesce(std::vector<Delta> & /* deltas */) const { return false; }
+
+protected:
+  /**
+   * @brief Initializes the originator with a memento of the initial state
+   */
+  DeltaMementoOriginator()
+      : m_recycler(std::make_shared<implementation::DeltaRecycler<Delta>>()),
+        m_head(m_pool.make(typename DeltaMemento<Delta>::Key(), nullptr, std::vector<Delta>())) {}
+
+  /**
+   * @brief Records a change to the state of the object
+   *
+   * Must be called after each change, with enough information to both
+   * apply and revert it.
+   *
+   * @param[in] delta change made to the state
+   */
+  void record(Delta delta) { m_pending.push_back(std::move(delta)); }
+
+  /**
+   * @brief Applies a change to the state of the object (without recording it)
+   *
+   * @param[in] delta change previously recorded
+   */
+  virtual void apply(const Delta &delta) = 0;
+
+  /**
+   * @brief Reverts a change to the state of the object (without recording it)
+   *
+   * @param[in] delta change previously recorded
+   */
+  virtual void revert(const Delta &delta) = 0;
+
+private:
+  /// Recycles the memory of the mementos that were released
+  mutable MementoPool<DeltaMemento<Delta>> m_pool;
+  /// Recycles the vectors of changes of the mementos that were released
+  std::shared_ptr<implementation::DeltaRecycler<Delta>> m_recycler;
+  /// Memento of the state before the pending changes
+  mutable memento_type m_head;
+  /// Changes not yet stored in a memento
+  mutable std::vector<Delta> m_pending;
+};
+}
+
+#endif /* DELTA_MEMENTO_ORIGINATOR_H_20261018 */
@@ -39,21 +39,59 @@
 #ifndef DLMANAGER_H_20150317
 #define DLMANAGER_H_20150317
 
+#include <mwheel/expected.h>
+#include <mwheel/plugin.h>
+#include <mwheel/read_copy_update.h>
 #include <mwheel/utility.h>
 
 #include <boost/filesystem.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace mwheel {
 
 /**
  * @brief Manages dynamic loading of shared libraries
  *
+ * Products created by the factories from prototypes registered by a plug-in
+ * keep the plug-in loaded: when a library is unloaded or reloaded, its
+ * registrations are removed right away but `dlclose` is deferred until the
+ * last of its products is destroyed.
+ *
+ * All the member functions can be called concurrently. Queries read an
+ * immutable snapshot of the loaded libraries through a read-copy-update
+ * scheme: they take no lock and never wait for loads or unloads, which
+ * instead wait for the queries still reading an older snapshot. Loads of
+ * different libraries proceed in parallel, and concurrent loads of the same
+ * library wait for a single `dlopen`. Unloads and reloads are serialized among
+ * themselves.
+ *
+ * A library may stay resident after it is unloaded: the dynamic linker never
+ * unmaps objects flagged with `NODELETE` (e.g. those that were the first to
+ * define a `STB_GNU_UNIQUE` symbol, as GCC does for template static data
+ * members), and something else may still hold it. Loading it again from the
+ * same path then reuses the resident instance, registering its products once
+ * more, as its static initializers won't run again.
+ *
  * @warning Current limitations:
  * - works only for POSIX systems
  * - external libraries and client application must be built with a
  * compatible compiler (there is no C-ABI layer)
+ * - only products returned as `std::shared_ptr` keep their library loaded
  *
  */
 class DLManager {
@@ -64,16 +102,183 @@ public:
   MWHEEL_RUNTIME_EXCEPTION(error_unloading_dynamic_library);
   /// @brief Exception thrown when trying to unload a library that was not previously loaded
   MWHEEL_RUNTIME_EXCEPTION(library_not_loaded);
+  /// @brief Exception thrown when a symbol can't be resolved in a loaded library
+  MWHEEL_RUNTIME_EXCEPTION(symbol_not_found);
+  /// @brief Exception thrown when a plug-in descriptor doesn't match what the application expects
+  MWHEEL_RUNTIME_EXCEPTION(incompatible_plugin);
+
+  /// @brief Options that control how a shared library is opened
+  struct LoadOptions {
+    /// When undefined function references are resolved
+    enum class Binding {
+      lazy, ///< at their first call (`RTLD_LAZY`)
+      now   ///< before `dlopen` returns (`RTLD_NOW`)
+    };
+    /// Whether the symbols of the library are available to libraries loaded afterwards
+    enum class Visibility {
+      local, ///< they are not (`RTLD_LOCAL`)
+      global ///< they are (`RTLD_GLOBAL`)
+    };
+
+    /// @brief Default options: lazy binding, local symbols, descriptor not required
+    LoadOptions()
+        : binding(Binding::lazy), visibility(Visibility::local), no_delete(false),
+          deep_bind(false), require_descriptor(false) {}
+
+    /// Binding mode of the library
+    Binding binding;
+    /// Visibility of the symbols of the library
+    Visibility visibility;
+    /// If true the library is never unmapped, even after it is unloaded (`RTLD_NODELETE`)
+    bool no_delete;
+    /// If true the library prefers its own symbols over global ones (`RTLD_DEEPBIND`)
+    bool deep_bind;
+    /// If true a library without MWHEEL_PLUGIN_DESCRIPTOR is rejected
+    bool require_descriptor;
+  };
+
+  /**
+   * @brief Time spent loading a shared library
+   *
+   * The start of static initialization is detected by a hook that plugin.h
+   * adds to each shared object including it: for libraries that don't, all the
+   * time is accounted as relocation.
+   */
+  struct LoadTimings {
+    /// Wall-clock time spent in `dlopen`, static initialization included
+    std::chrono::nanoseconds dlopen;
+    /// Time spent mapping and relocating the library and its dependencies (with
+    /// lazy binding, function references are resolved later at their first call)
+    std::chrono::nanoseconds relocation;
+    /// Time spent in static initializers, registrations of MWHEEL_REGISTER_* included
+    std::chrono::nanoseconds static_initialization;
+    /// Time spent importing the products added with MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY,
+    /// after `dlopen` returned (for a resident instance that is reused, time spent
+    /// registering its products again)
+    std::chrono::nanoseconds table_import;
+  };
+
+  /// @brief Options that control how the pages of a library are warmed up
+  struct WarmUpOptions {
+    /// @brief Default options: pages are only prefaulted
+    WarmUpOptions() : lock(false), huge_pages(false) {}
+
+    /// If true the pages are locked in memory with `mlock`
+    bool lock;
+    /// If true transparent huge pages are requested for executable segments
+    bool huge_pages;
+  };
+
+  /// @brief Outcome of a warm-up
+  struct WarmUpReport {
+    /// Pages of the loaded segments that were touched
+    size_t pages;
+    /// Pages that were locked in memory
+    size_t locked_pages;
+    /// Pages of executable segments for which transparent huge pages were requested
+    size_t huge_pages;
+  };
+
+  /// @brief Options that control how DLManager::unload_all tears down the libraries
+  struct TeardownOptions {
+    /// @brief Default options: libraries are closed, in parallel where possible
+    TeardownOptions() : skip_dlclose(false), parallel(true) {}
+
+    /// If true registrations are removed but libraries are never closed (fast
+    /// shutdown at process exit, when unmapping is wasted work)
+    bool skip_dlclose;
+    /// If true libraries that don't depend on each other are unloaded
+    /// concurrently (a single library is always unloaded by the calling thread)
+    bool parallel;
+  };
+
+  /// @brief Failure to unload a library during a teardown
+  struct UnloadError {
+    /// Path of the library
+    boost::filesystem::path library;
+    /// Description of the error
+    std::string message;
+  };
+
+  /// Outcome of the loading of each library in a batch
+  using batch_report_type =
+      std::vector<std::pair<boost::filesystem::path, Expected<LoadTimings>>>;
+
+  /// Explicit dependencies: each library is mapped to the libraries that must be loaded before it
+  using dependency_manifest_type =
+      std::map<boost::filesystem::path, std::vector<boost::filesystem::path>>;
+
+  /// @brief Entry of a table of symbols to be resolved by DLManager::bind
+  struct SymbolBinding {
+    /// Name of the symbol
+    std::string name;
+    /// Stores the resolved address into its destination
+    std::function<void(void *)> assign;
+  };
+
+  /**
+   * @brief Creates an entry of a table of symbols to be resolved by DLManager::bind
+   *
+   * @tparam Signature type of the symbol (a function type for functions)
+   *
+   * @param[in] name name of the symbol
+   * @param[out] target pointer that will store the address of the symbol
+   *
+   * @return entry of the table
+   */
+  template <class Signature>
+  static SymbolBinding binding(std::string name, Signature *&target) {
+    auto destination = &target;
+    return SymbolBinding{std::move(name), [destination](void *address) {
+                           *destination = reinterpret_cast<Signature *>(address);
+                         }};
+  }
 
   /**
    * @brief Loads the shared library specified by the given path
    *
    * @param[in] library_path path of the library to be loaded
+   * @param[in] options how the library is opened
    *
    * @throw error_loading_dynamic_library exception thrown if an error
-   * occurred during the loading operation
+   * occurred during the loading operation, or if the options are not
+   * supported on this platform
+   *
+   * @return time spent loading the library (zero if it was already loaded, in
+   * which case the options are ignored)
+   */
+  LoadTimings load_library(const boost::filesystem::path &library_path,
+                           const LoadOptions &options = LoadOptions());
+
+  /**
+   * @brief Loads a batch of shared libraries, honoring the dependencies among them
+   *
+   * Dependencies among the libraries in the batch are deduced from their
+   * DT_NEEDED entries (matched against the soname or the file name of the other
+   * libraries) and from an optional manifest. The files are scanned and
+   * prefetched into the page cache concurrently, then each library is opened
+   * after all of its dependencies.
+   *
+   * A failure doesn't stop the batch: it is reported for the library that
+   * failed and for all the libraries that depend on it.
+   *
+   * @param[in] library_paths range of paths of the libraries to be loaded
+   * @param[in] manifest explicit dependencies among the libraries in the batch
+   * @param[in] options how the libraries are opened
+   *
+   * @return outcome of the loading of each library, in the order of the request
    */
-  void load_library(const boost::filesystem::path &library_path);
+  template <class Range>
+  batch_report_type
+  load_libraries(const Range &library_paths,
+                 const dependency_manifest_type &manifest = dependency_manifest_type(),
+                 const LoadOptions &options = LoadOptions()) {
+    std::vector<boost::filesystem::path> paths;
+    for (const auto &x : library_paths) {
+      paths.emplace_back(x);
+    }
+    return load_batch(paths, manifest, options);
+  }
 
   /**
    * @brief Unloads the shared library specified by the given path
@@ -87,20 +292,380 @@ public:
    * occurred during the unloading operation
    *
    * @warning Trying to unload a library that introduces classes in the
-   * application that are currently in scope may cause memory access violations
+   * application that are currently in scope may cause memory access violations,
+   * unless the objects are products of a factory (see the class description)
    */
   void unload_library(const boost::filesystem::path &library_path);
 
   /**
    * @brief Unloads all the libraries loaded so far
+   *
+   * Libraries are unloaded in reverse load order. A library is unloaded only
+   * after all the libraries that depend on it (see DLManager::load_libraries):
+   * libraries that don't depend on each other may be unloaded concurrently.
+   * A failure doesn't stop the teardown.
+   *
+   * @param[in] options how the libraries are torn down
+   *
+   * @return failures, empty if all the libraries were unloaded (or deferred
+   * until their last product is destroyed)
+   */
+  std::vector<UnloadError> unload_all(const TeardownOptions &options = TeardownOptions());
+
+  /**
+   * @brief Replaces a loaded library with a new version, without a window
+   * during which its products can't be created
+   *
+   * The new version is loaded side by side with the old one (with the options
+   * the old one was loaded with), staging the registrations it performs.
+   * Once it is loaded, each staged registration replaces the old one in a
+   * single step, and registrations of the old version that have no
+   * replacement are removed. The old version is
+   * closed when its last product is destroyed.
+   *
+   * @param[in] library_path path under which the library was loaded
+   * @param[in] replacement_path path of the new version (if empty, the file at
+   * `library_path` is loaded again: useful if it was replaced on disk)
+   *
+   * @throw library_not_loaded exception thrown if the library was not
+   * previously loaded
+   *
+   * @throw error_loading_dynamic_library exception thrown if the new version
+   * can't be loaded (the old version stays in place)
+   *
+   * @throw error_unloading_dynamic_library exception thrown if an error
+   * occurred while closing the old version (the new version is in place)
+   */
+  void reload_library(const boost::filesystem::path &library_path,
+                      const boost::filesystem::path &replacement_path = boost::filesystem::path());
+
+  /**
+   * @brief Returns the address of a symbol exported by a loaded library
+   *
+   * Addresses are cached per library, so `dlsym` is called only the first time
+   * a symbol is requested. The cache is dropped when the library is unloaded
+   * or reloaded: addresses obtained before that must not be used afterwards.
+   *
+   * @tparam Signature type of the symbol (a function type for functions)
+   *
+   * @param[in] library_path path of the library
+   * @param[in] name name of the symbol
+   *
+   * @throw library_not_loaded exception thrown if the library was not
+   * previously loaded
+   *
+   * @throw symbol_not_found exception thrown if the library doesn't export the symbol
+   *
+   * @return address of the symbol
+   */
+  template <class Signature>
+  Signature *get_symbol(const boost::filesystem::path &library_path, const std::string &name) {
+    return reinterpret_cast<Signature *>(find_symbol(library_path, name));
+  }
+
+  /**
+   * @brief Resolves a table of symbols exported by a loaded library
+   *
+   * Meant to be called right after loading a library, so that hot paths call
+   * through plain function pointers. Either all the symbols are resolved, or
+   * none of the destinations is modified.
+   *
+   * @param[in] library_path path of the library
+   * @param[in] table entries created with DLManager::binding
+   *
+   * @throw library_not_loaded exception thrown if the library was not
+   * previously loaded
+   *
+   * @throw symbol_not_found exception thrown if the library doesn't export
+   * some of the symbols (all of them are listed in the message)
+   */
+  void bind(const boost::filesystem::path &library_path, const std::vector<SymbolBinding> &table);
+
+  /**
+   * @brief Faults in the pages of a loaded library, so that the first calls
+   * into it don't wait for the disk
+   *
+   * The segments of the library are read from `dl_iterate_phdr`, advised
+   * with `MADV_WILLNEED` to start read-ahead, then touched page by page.
+   * Locking and huge pages are best effort: failures (e.g. because of
+   * `RLIMIT_MEMLOCK`, or a kernel without huge pages for file mappings) are
+   * only reflected in the report.
+   *
+   * @param[in] library_path path of the library
+   * @param[in] options what else is done with the pages
+   *
+   * @throw library_not_loaded exception thrown if the library was not
+   * previously loaded
+   *
+   * @return number of pages touched, locked and advised for huge pages
+   */
+  WarmUpReport warm_up(const boost::filesystem::path &library_path,
+                       const WarmUpOptions &options = WarmUpOptions());
+
+  /**
+   * @brief Declares the interface of a factory the application is built against
+   *
+   * The descriptor of each library loaded afterwards (see MWHEEL_PLUGIN_DESCRIPTOR)
+   * is read from the file before `dlopen`, so no code of the library runs if
+   * it is rejected. A library exposing the same interface is accepted only
+   * if it was built for the same C++ ABI (see implementation::abi_tag), its
+   * tag type is the same and its version is compatible: same major version
+   * and minor version not greater than that of the application. Libraries
+   * exposing other interfaces are not checked.
+   *
+   * @tparam InterfaceType interface exposed with MWHEEL_EXPOSE_INTERFACE_FACTORY
+   * or MWHEEL_EXPOSE_VERSIONED_INTERFACE_FACTORY
+   */
+  template <class InterfaceType> void require_interface() {
+    require_descriptor(InterfaceType::plugin_descriptor());
+  }
+
+  /**
+   * @brief Checks whether a library was loaded by this manager
+   *
+   * @param[in] library_path path of the library
+   *
+   * @return true if the library is loaded, false otherwise
+   */
+  bool is_loaded(const boost::filesystem::path &library_path) const;
+
+  /**
+   * @brief Returns the products that a library registered while it was loaded
+   *
+   * Only products registered with MWHEEL_REGISTER_TAG_PLUGIN_OBJECT_PAIR
+   * (directly or through other plug-in macros) are recorded.
+   *
+   * @param[in] library_path path of the library
+   *
+   * @throw library_not_loaded exception thrown if the library was not
+   * previously loaded
+   *
+   * @return products registered by the library
+   */
+  std::vector<PluginProduct> registered_products(const boost::filesystem::path &library_path) const;
+
+  /**
+   * @brief Creates a manager with no library loaded
+   */
+  DLManager();
+
+  /**
+   * @brief Unloads all the libraries loaded so far, one at a time
+   *
+   * Errors are ignored: call DLManager::unload_all before destruction to
+   * retrieve them, or to tear down the libraries in parallel.
+   *
+   * @warning Must not run concurrently with other member functions
    */
   ~DLManager();
 
 private:
+  /**
+   * @brief Implementation of DLManager::load_libraries
+   *
+   * @param[in] library_paths paths of the libraries to be loaded
+   * @param[in] manifest explicit dependencies among the libraries in the batch
+   * @param[in] options how the libraries are opened
+   *
+   * @return outcome of the loading of each library, in the order of the request
+   */
+  batch_report_type load_batch(const std::vector<boost::filesystem::path> &library_paths,
+                               const dependency_manifest_type &manifest,
+                               const LoadOptions &options);
+
+  /**
+   * @brief Opens a library and stores its record, or waits for a concurrent
+   * load of the same library
+   *
+   * @param[in] library_path path of the library to be loaded
+   * @param[in] dependencies libraries managed by this object that the library depends on
+   * @param[in] options how the library is opened
+   *
+   * @throw error_loading_dynamic_library exception thrown if an error
+   * occurred during the loading operation
+   *
+   * @return time spent loading the library
+   */
+  LoadTimings load_single(const boost::filesystem::path &library_path,
+                          std::vector<boost::filesystem::path> dependencies,
+                          const LoadOptions &options);
+
+  /**
+   * @brief Implementation of DLManager::get_symbol
+   *
+   * @param[in] library_path path of the library
+   * @param[in] name name of the symbol
+   *
+   * @throw library_not_loaded exception thrown if the library was not
+   * previously loaded
+   *
+   * @throw symbol_not_found exception thrown if the library doesn't export the symbol
+   *
+   * @return address of the symbol
+   */
+  void *find_symbol(const boost::filesystem::path &library_path, const std::string &name);
+
+  /**
+   * @brief Implementation of DLManager::require_interface
+   *
+   * @param[in] descriptor descriptor of the interface, as seen by the application
+   */
+  void require_descriptor(const PluginDescriptor &descriptor);
+
+  /**
+   * @brief Checks the descriptor of a library against the required interfaces
+   *
+   * @param[in] library_path path of the library
+   * @param[in] descriptor descriptor of the library, nullptr if it has none
+   * @param[in] options how the library is going to be opened
+   *
+   * @throw incompatible_plugin exception thrown if the library must not be loaded
+   */
+  void check_compatibility(const boost::filesystem::path &library_path,
+                           const PluginDescriptor *descriptor, const LoadOptions &options) const;
+
+  /**
+   * @brief Bookkeeping information on a loaded library
+   *
+   * Records are immutable once published, except for the symbol cache.
+   */
+  struct LibraryRecord {
+    /// Type of the cache of resolved symbols
+    using symbol_map_type = std::unordered_map<std::string, void *>;
+
+    /// Frees the symbol cache
+    ~LibraryRecord() { delete symbols.load(); }
+
+    /// Handle returned by `dlopen`
+    void *handle;
+    /// Options the library was opened with
+    LoadOptions options;
+    /// Closes the library when the manager and all the products of the library
+    /// release it (declared first, so the callbacks below are destroyed before)
+    std::shared_ptr<void> lifetime;
+    /// Libraries managed by this object that were loaded as dependencies of this one
+    std::vector<boost::filesystem::path> dependencies;
+    /// Position of the library in the load history
+    unsigned long long sequence;
+    /// Products registered while the library was loaded
+    std::vector<PluginProduct> products;
+    /// Callbacks that remove the registrations of the library from the factories
+    std::vector<std::function<void()>> retire;
+    /// True if this instance was opened from the path of the library, so that a
+    /// later load can reuse it if it is still resident
+    bool reusable = false;
+    /// Load address of the instance
+    std::uintptr_t base = 0;
+    /// Entries that register the products of the instance again
+    std::vector<implementation::RestoreEntry> restore;
+    /// Addresses of the symbols resolved so far (copy-on-write, read within DLManager::m_rcu)
+    mutable std::atomic<const symbol_map_type *> symbols{nullptr};
+    /// Serializes the updates of the symbol cache
+    mutable std::mutex symbols_mutex;
+  };
+
+  /// Type of a pointer to a published record
+  using record_pointer = std::shared_ptr<const LibraryRecord>;
+
   /// Type used to store loaded libraries
-  using DLMap = std::map<boost::filesystem::path, void *>;
-  /// Map to store library handles once loaded
-  DLMap m_dl_map;
+  using DLMap = std::map<boost::filesystem::path, record_pointer>;
+
+  /**
+   * @brief Returns the record of a library
+   *
+   * @param[in] library_path path of the library
+   *
+   * @return record of the library, nullptr if it is not loaded
+   */
+  record_pointer find_record(const boost::filesystem::path &library_path) const;
+
+  /**
+   * @brief Publishes a new snapshot where a library is mapped to a new record
+   *
+   * @param[in] library_path path of the library
+   * @param[in] record new record of the library, nullptr to remove it
+   *
+   * @note Must be called with DLManager::m_write_mutex held
+   */
+  void publish(const boost::filesystem::path &library_path, record_pointer record);
+
+  /**
+   * @brief Replaces the snapshot, once no reader can access the old one anymore
+   *
+   * @param[in] snapshot new snapshot
+   *
+   * @return the old snapshot
+   *
+   * @note Must be called with DLManager::m_write_mutex held
+   */
+  std::unique_ptr<const DLMap> replace_snapshot(std::unique_ptr<const DLMap> snapshot);
+
+  /// @brief Instance of a library that was unloaded, and may still be resident
+  struct UnloadedInstance {
+    /// Load address of the instance
+    std::uintptr_t base;
+    /// Entries that register the products of the instance again
+    std::vector<implementation::RestoreEntry> restore;
+  };
+
+  /**
+   * @brief Remembers how to register again the products of a library that is
+   * being unloaded, in case its instance stays resident
+   *
+   * @param[in] library_path path of the library
+   * @param[in] record record of the library
+   */
+  void remember_unloaded(const boost::filesystem::path &library_path,
+                         const LibraryRecord &record);
+
+  /**
+   * @brief Removes the registrations of a library from the factories
+   *
+   * @param[in] record record of the library
+   */
+  static void retire_registrations(const LibraryRecord &record);
+
+  /**
+   * @brief Closes a library whose registrations were retired and whose record
+   * was dropped, or defers it if something else still holds the library
+   *
+   * @param[in] library_path path of the library (for error reporting)
+   * @param[in] lifetime lease of the library
+   *
+   * @throw error_unloading_dynamic_library exception thrown if an error
+   * occurred during the unloading operation
+   */
+  static void release_library(const boost::filesystem::path &library_path,
+                              std::shared_ptr<void> lifetime);
+
+  /// A load in progress
+  struct InFlightLoad {
+    /// Thread performing the load
+    std::thread::id loader;
+    /// Outcome of the load
+    std::shared_future<LoadTimings> outcome;
+  };
+
+  /// Protects the snapshot and the symbol caches from being destroyed while they are read
+  mutable ReadCopyUpdate m_rcu;
+  /// Snapshot of the loaded libraries (owned, read within m_rcu)
+  std::atomic<const DLMap *> m_snapshot;
+  /// Serializes the publication of snapshots and the access to the maps below
+  std::mutex m_write_mutex;
+  /// Loads in progress
+  std::map<boost::filesystem::path, InFlightLoad> m_in_flight;
+  /// Libraries that were unloaded, possibly still resident because something holds them
+  std::set<boost::filesystem::path> m_retired;
+  /// Instances of the libraries that were unloaded, that a later load may reuse
+  std::map<boost::filesystem::path, UnloadedInstance> m_unloaded;
+  /// Sequence number of the next library to be loaded
+  unsigned long long m_next_sequence;
+  /// Serializes unloads and reloads
+  std::mutex m_update_mutex;
+  /// Interfaces required by the application, by hash of their name
+  std::unordered_map<std::uint64_t, PluginDescriptor> m_required;
+  /// Guards the access to the required interfaces
+  mutable std::mutex m_required_mutex;
 };
 }
 
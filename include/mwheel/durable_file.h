@@ -0,0 +1,263 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file durable_file.h
+ *
+ * @brief Crash-safe and incremental ways to write serialized states
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 9:55 PM
+ */
+
+#ifndef DURABLE_FILE_H_20261018
+#define DURABLE_FILE_H_20261018
+
+#include <mwheel/byte_stream.h>
+#include <mwheel/serializable_object.h>
+#include <mwheel/utility.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mwheel {
+
+/**
+ * @brief Sink that replaces a file atomically
+ *
+ * The bytes go to an anonymous file (`O_TMPFILE`) in the same directory
+ * as the target, or to a hidden temporary file where the file system
+ * doesn't support it or `/proc` is not mounted (an anonymous file is
+ * named through `/proc/self/fd`). commit() synchronizes the file with the disk and
+ * renames it over the target: readers see either the old content or the
+ * new one, even after a crash.
+ */
+class AtomicFileSink : public ByteSink {
+public:
+  /// @brief Exception thrown if the file can't be created or committed
+  MWHEEL_RUNTIME_EXCEPTION(commit_error);
+
+  /**
+   * @brief Prepares the replacement of a file
+   *
+   * @param[in] path file to be replaced (created if it doesn't exist)
+   *
+   * @throw commit_error if the temporary file can't be created
+   */
+  explicit AtomicFileSink(const boost::filesystem::path &path);
+
+  AtomicFileSink(const AtomicFileSink &) = delete;
+  AtomicFileSink &operator=(const AtomicFileSink &) = delete;
+
+  using ByteSink::write;
+  void write(const void *data, std::size_t size) override;
+  void write(const ConstBuffer *buffers, std::size_t count) override;
+
+  /**
+   * @brief Replaces the target with what was written
+   *
+   * @throw commit_error if the file can't be synchronized or renamed
+   */
+  void commit();
+
+  /**
+   * @brief Discards what was written, unless it was committed
+   */
+  ~AtomicFileSink();
+
+private:
+  /// File to be replaced
+  boost::filesystem::path m_path;
+  /// Name of the temporary file, empty for an anonymous one
+  boost::filesystem::path m_temporary;
+  /// File descriptor of the temporary file, -1 after commit
+  int m_fd;
+};
+
+/**
+ * @brief Object able to serialize any part of its state, and to tell
+ * which parts changed since it was last written
+ */
+class IncrementalSerializableObject : public SerializableObject {
+public:
+  /// @brief Range of bytes of the state
+  struct Region {
+    /// First byte
+    std::size_t offset;
+    /// Number of bytes
+    std::size_t size;
+  };
+
+  /**
+   * @brief Returns the size of the state
+   *
+   * @return number of bytes of the state
+   */
+  virtual std::size_t state_size() const = 0;
+
+  /**
+   * @brief Serializes part of the state
+   *
+   * @param[in] offset first byte
+   * @param[in] size number of bytes
+   * @param[out] destination where the bytes are stored
+   */
+  void serialize(std::size_t offset, std::size_t size, char *destination) const {
+    do_serialize_region(offset, size, destination);
+  }
+
+  /**
+   * @brief Returns the parts of the state that changed since the last
+   * call to clear_dirty_regions()
+   *
+   * @return regions that changed, in any order (they may overlap)
+   */
+  virtual std::vector<Region> dirty_regions() const = 0;
+
+  /**
+   * @brief Marks the whole state as written
+   */
+  virtual void clear_dirty_regions() = 0;
+
+  using SerializableObject::serialize;
+
+protected:
+  /**
+   * @brief Serializes part of the state
+   *
+   * @param[in] offset first byte
+   * @param[in] size number of bytes
+   * @param[out] destination where the bytes are stored
+   */
+  virtual void do_serialize_region(std::size_t offset, std::size_t size,
+                                   char *destination) const = 0;
+
+  /**
+   * @brief Serializes the whole state, one part at a time
+   *
+   * @param[in,out] sink where the state is appended
+   */
+  void do_serialize(ByteSink &sink) const override;
+};
+
+/**
+ * @brief File updated in place, rewriting only the blocks that changed
+ *
+ * The file starts with a header (magic string, block size, size of the
+ * state and CRC-32 of the checksum table), followed by the state split in
+ * fixed-size blocks and by the table of the CRC-32 of each block. All the
+ * integers are little-endian. Blocks are written first and the header
+ * last, each step followed by `fdatasync`: a crash in between is detected
+ * by the checksums when the file is read, and the next write() repairs
+ * the file by rewriting it completely.
+ *
+ * Use AtomicFileSink when a crash must never lose the previous state.
+ */
+class IncrementalFile {
+public:
+  /// @brief Exception thrown if the file can't be read or written
+  MWHEEL_RUNTIME_EXCEPTION(file_error);
+
+  /// Default size of a block
+  static constexpr std::size_t default_block_size = 1 << 16;
+
+  /**
+   * @brief Opens a file, creating it if it doesn't exist
+   *
+   * An existing file keeps its own block size.
+   *
+   * @param[in] path path of the file
+   * @param[in] block_size size of a block for a new file
+   *
+   * @throw file_error if the file can't be opened, or is not an incremental file
+   */
+  explicit IncrementalFile(const boost::filesystem::path &path,
+                           std::size_t block_size = default_block_size);
+
+  IncrementalFile(const IncrementalFile &) = delete;
+  IncrementalFile &operator=(const IncrementalFile &) = delete;
+
+  /**
+   * @brief Writes the blocks of the state that changed, then clears the
+   * dirty regions of the object
+   *
+   * @param[in,out] object object to be serialized
+   *
+   * @throw file_error if the file can't be written
+   *
+   * @return number of blocks written
+   */
+  std::size_t write(IncrementalSerializableObject &object);
+
+  /**
+   * @brief De-serializes the state stored in the file
+   *
+   * @param[in,out] object object that receives the state
+   *
+   * @throw file_error if the file can't be read, or a block is corrupted
+   */
+  void read(SerializableObject &object) const;
+
+  /**
+   * @brief Returns the size of a block
+   *
+   * @return number of bytes of a block
+   */
+  std::size_t block_size() const { return m_block_size; }
+
+  /**
+   * @brief Closes the file
+   */
+  ~IncrementalFile();
+
+private:
+  /**
+   * @brief Returns the offset of a block in the file
+   */
+  std::uint64_t block_offset(std::size_t block) const;
+
+  /// Path of the file
+  boost::filesystem::path m_path;
+  /// File descriptor of the file
+  int m_fd;
+  /// Size of a block
+  std::size_t m_block_size;
+  /// Size of the state in the file
+  std::uint64_t m_size;
+  /// Checksum of each block in the file
+  std::vector<std::uint32_t> m_checksums;
+  /// If false the file must be rewritten completely
+  bool m_valid;
+};
+}
+
+#endif /* DURABLE_FILE_H_20261018 */
@@ -0,0 +1,135 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file mapped_file.h
+ *
+ * @brief Read-only memory mapping of a file
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 7:05 PM
+ */
+
+#ifndef MAPPED_FILE_H_20261018
+#define MAPPED_FILE_H_20261018
+
+#include <mwheel/utility.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstddef>
+
+namespace mwheel {
+
+/**
+ * @brief Maps a whole file read-only in memory, and unmaps it at destruction
+ *
+ * The view starts at a page boundary, so that implementations of
+ * SerializableObject can parse it in place, or keep references into it as
+ * long as the object lives.
+ */
+class MappedFile {
+public:
+  /// @brief Exception thrown if a file can't be mapped
+  MWHEEL_RUNTIME_EXCEPTION(mapping_error);
+
+  /// How the mapping is going to be accessed (see `madvise`)
+  enum class Access {
+    normal,     ///< no particular pattern (`MADV_NORMAL`)
+    sequential, ///< from the beginning to the end, once (`MADV_SEQUENTIAL`)
+    random,     ///< in no particular order (`MADV_RANDOM`)
+    will_need   ///< soon: start reading ahead now (`MADV_WILLNEED`)
+  };
+
+  /**
+   * @brief Maps a file
+   *
+   * @param[in] path path of the file
+   * @param[in] access expected access pattern
+   *
+   * @throw mapping_error if the file can't be opened or mapped
+   */
+  explicit MappedFile(const boost::filesystem::path &path, Access access = Access::sequential);
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  /// @brief Takes over the mapping of another object
+  MappedFile(MappedFile &&other);
+  /// @brief Takes over the mapping of another object
+  MappedFile &operator=(MappedFile &&other);
+
+  /**
+   * @brief Returns the first byte of the file
+   *
+   * @return page-aligned pointer to the first byte, nullptr if the file is empty
+   */
+  const char *data() const { return m_data; }
+
+  /**
+   * @brief Returns the size of the file
+   *
+   * @return size of the file in bytes
+   */
+  std::size_t size() const { return m_size; }
+
+  /**
+   * @brief Returns the path of the file
+   *
+   * @return path of the file
+   */
+  const boost::filesystem::path &path() const { return m_path; }
+
+  /**
+   * @brief Changes the expected access pattern of a range of the file
+   *
+   * Hints are best effort: errors are ignored.
+   *
+   * @param[in] access expected access pattern
+   * @param[in] offset first byte of the range (rounded down to a page boundary)
+   * @param[in] length length of the range (the whole file after `offset` if 0)
+   */
+  void advise(Access access, std::size_t offset = 0, std::size_t length = 0) const;
+
+  /**
+   * @brief Unmaps the file
+   */
+  ~MappedFile();
+
+private:
+  /// Path of the file
+  boost::filesystem::path m_path;
+  /// First byte of the mapping
+  const char *m_data;
+  /// Size of the mapping
+  std::size_t m_size;
+};
+}
+
+#endif /* MAPPED_FILE_H_20261018 */
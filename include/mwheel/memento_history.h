@@ -0,0 +1,466 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file memento_history.h
+ *
+ * @brief Undo/redo history of delta mementos, within a memory budget
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 3:40 PM
+ */
+
+#ifndef MEMENTO_HISTORY_H_20261018
+#define MEMENTO_HISTORY_H_20261018
+
+#include <mwheel/delta_memento_originator.h>
+#include <mwheel/utility.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace mwheel {
+
+/**
+ * @brief Linear history of the states of a DeltaMementoOriginator
+ *
+ * Each checkpoint gets a sequence number, which gives access to the state
+ * in O(log n). Every `keyframe_interval` checkpoints the history stores a
+ * keyframe: all the changes since the initial state, merged with
+ * DeltaMementoOriginator::coalesce into a full checkpoint. Mementos then
+ * hang off the closest keyframe, so restoring any state replays at most
+ * two keyframes and `keyframe_interval` checkpoints worth of changes.
+ *
+ * When the mementos exceed the memory budget the oldest checkpoints are
+ * evicted, and the oldest one left is turned into a keyframe, so that
+ * nothing references the evicted changes any longer.
+ *
+ * Keyframes and evictions both need DeltaMementoOriginator::coalesce: if
+ * the originator doesn't override it, every change since the initial
+ * state is kept and the budget is not enforced.
+ *
+ * @warning The state of the originator must change only through the
+ * history (or by recording new changes), and the history must be the
+ * only one creating its mementos, otherwise the evicted changes can't
+ * be released
+ *
+ * @tparam Delta type of the changes (must be copyable)
+ */
+template <class Delta> class MementoHistory {
+public:
+  /// Exception thrown when accessing a state that is not in the history
+  MWHEEL_RUNTIME_EXCEPTION(state_not_available);
+  /// Exception thrown if the originator was moved to a state outside the history
+  MWHEEL_RUNTIME_EXCEPTION(inconsistent_history);
+
+  /// Type of the originator
+  using originator_type = DeltaMementoOriginator<Delta>;
+  /// Type of the mementos
+  using memento_type = typename originator_type::memento_type;
+  /// Type of the sequence numbers of the checkpoints
+  using sequence_type = std::uint64_t;
+
+  /// @brief Options that trade memory for restore latency
+  struct Options {
+    /// @brief Default options: 64 MiB budget, a keyframe every 64 checkpoints
+    Options() : budget(64u << 20), keyframe_interval(64), delta_size() {}
+
+    /// Memory in bytes above which the oldest checkpoints are evicted
+    std::size_t budget;
+    /// Number of checkpoints between two keyframes
+    std::size_t keyframe_interval;
+    /// Memory in bytes used by a change (`sizeof(Delta)` if empty)
+    std::function<std::size_t(const Delta &)> delta_size;
+  };
+
+  /// @brief Memory and time accounted by the history
+  struct Statistics {
+    /// Number of checkpoints in the history
+    std::size_t entries;
+    /// Number of keyframes in the history
+    std::size_t keyframes;
+    /// Memory in bytes used by the mementos of the history
+    std::size_t bytes;
+    /// Largest value of `bytes` so far
+    std::size_t peak_bytes;
+    /// Number of checkpoints evicted to stay within the budget
+    std::uint64_t evictions;
+    /// Number of compactions performed
+    std::uint64_t compactions;
+    /// Number of mementos allocated by keyframes and compactions
+    std::uint64_t allocations;
+    /// Memory in bytes allocated by keyframes and compactions
+    std::uint64_t allocated_bytes;
+    /// Number of states restored
+    std::uint64_t restores;
+    /// Time spent restoring states
+    std::chrono::nanoseconds restore_time;
+  };
+
+  /**
+   * @brief Creates an empty history
+   *
+   * @param[in] originator object whose states are recorded (must outlive the history)
+   * @param[in] options memory budget and keyframe interval
+   */
+  explicit MementoHistory(originator_type &originator, const Options &options = Options())
+      : m_originator(originator), m_options(options), m_root(originator.create_memento()),
+        m_next_sequence(0), m_current(0), m_statistics() {
+    // Probes whether coalesce is overridden
+    std::vector<Delta> none;
+    m_coalesces = originator.coalesce(none);
+    while (m_root->parent()) {
+      m_root = m_root->parent();
+    }
+    m_options.keyframe_interval = std::max<std::size_t>(m_options.keyframe_interval, 1);
+  }
+
+  MementoHistory(const MementoHistory &) = delete;
+  MementoHistory &operator=(const MementoHistory &) = delete;
+
+  /**
+   * @brief Records the current state of the originator
+   *
+   * After a restore, the checkpoints that followed the restored state are
+   * discarded first.
+   *
+   * @return sequence number of the checkpoint (that of the current
+   * state if nothing changed since)
+   */
+  sequence_type checkpoint() {
+    auto memento = m_originator.create_memento();
+    while (!m_entries.empty() && m_entries.back().sequence > m_current) {
+      m_statistics.bytes -= m_entries.back().bytes;
+      m_entries.pop_back();
+    }
+    if (!m_entries.empty() && m_entries.back().memento == memento) {
+      return m_current;
+    }
+    auto previous = m_entries.empty() ? m_root.get() : m_entries.back().memento.get();
+    Entry entry{m_next_sequence++, memento, 0, false};
+    for (auto node = memento.get(); node && node != previous; node = node->parent().get()) {
+      entry.bytes += node_bytes(*node);
+    }
+    m_statistics.bytes += entry.bytes;
+    m_current = entry.sequence;
+    m_entries.push_back(std::move(entry));
+    // Without merging, a keyframe would copy the whole history
+    if (m_coalesces &&
+        (m_entries.size() == 1 || since_keyframe() >= m_options.keyframe_interval)) {
+      rebuild(m_entries.size() - 1);
+    }
+    if (m_statistics.bytes > m_options.budget) {
+      compact();
+    }
+    m_statistics.peak_bytes = std::max(m_statistics.peak_bytes, m_statistics.bytes);
+    return m_current;
+  }
+
+  /**
+   * @brief Brings the originator to a recorded state
+   *
+   * @param[in] sequence sequence number of the checkpoint
+   *
+   * @throw state_not_available if the checkpoint was evicted or discarded
+   */
+  void restore(sequence_type sequence) {
+    auto memento = find(sequence);
+    if (!memento) {
+      std::stringstream estream;
+      estream << "ERROR : state " << sequence << " is not in the history" << std::endl;
+      throw state_not_available(estream.str());
+    }
+    auto start = std::chrono::steady_clock::now();
+    m_originator.set_state(std::move(memento));
+    m_statistics.restore_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    ++m_statistics.restores;
+    m_current = sequence;
+  }
+
+  /**
+   * @brief Restores the checkpoint before the current one
+   *
+   * @return true if there was such a checkpoint, false otherwise
+   */
+  bool undo() {
+    auto it = position(m_current);
+    if (it == m_entries.end() || it == m_entries.begin()) {
+      return false;
+    }
+    restore((it - 1)->sequence);
+    return true;
+  }
+
+  /**
+   * @brief Restores the checkpoint after the current one
+   *
+   * @return true if there was such a checkpoint, false otherwise
+   */
+  bool redo() {
+    auto it = position(m_current);
+    if (it == m_entries.end() || it + 1 == m_entries.end()) {
+      return false;
+    }
+    restore((it + 1)->sequence);
+    return true;
+  }
+
+  /**
+   * @brief Returns the memento of a checkpoint
+   *
+   * @param[in] sequence sequence number of the checkpoint
+   *
+   * @return memento of the checkpoint, nullptr if it is not in the history
+   */
+  memento_type find(sequence_type sequence) const {
+    auto it = position(sequence);
+    return it != m_entries.end() ? it->memento : memento_type();
+  }
+
+  /**
+   * @brief Returns the sequence number of the state of the originator
+   *
+   * @return sequence number of the last checkpoint taken or restored
+   */
+  sequence_type current() const { return m_current; }
+
+  /**
+   * @brief Returns the number of checkpoints in the history
+   *
+   * @return number of checkpoints in the history
+   */
+  std::size_t size() const { return m_entries.size(); }
+
+  /**
+   * @brief Returns the memory and time accounted so far
+   *
+   * @return statistics of the history
+   */
+  Statistics statistics() const {
+    auto statistics = m_statistics;
+    statistics.entries = m_entries.size();
+    statistics.keyframes = static_cast<std::size_t>(std::count_if(
+        m_entries.begin(), m_entries.end(), [](const Entry &x) { return x.keyframe; }));
+    return statistics;
+  }
+
+  /**
+   * @brief Evicts the oldest checkpoints until the history fits its budget
+   *
+   * The current state is never evicted, and nothing is if the originator
+   * can't coalesce its changes.
+   */
+  void compact() {
+    if (!m_coalesces) {
+      return;
+    }
+    ++m_statistics.compactions;
+    // The new oldest keyframe may be larger than what was evicted: repeat until it fits
+    while (m_statistics.bytes > m_options.budget) {
+      std::size_t evicted = 0;
+      auto remaining = m_statistics.bytes;
+      while (remaining > m_options.budget && evicted + 1 < m_entries.size() &&
+             m_entries[evicted].sequence < m_current) {
+        remaining -= m_entries[evicted].bytes;
+        ++evicted;
+      }
+      if (evicted == 0) {
+        return;
+      }
+      // Nothing must reference the evicted changes any longer
+      if (!m_entries[evicted].keyframe) {
+        rebuild(evicted);
+      }
+      for (std::size_t ii = 0; ii < evicted; ++ii) {
+        m_statistics.bytes -= m_entries.front().bytes;
+        m_entries.pop_front();
+        ++m_statistics.evictions;
+      }
+    }
+  }
+
+private:
+  /// A checkpoint
+  struct Entry {
+    /// Sequence number of the checkpoint
+    sequence_type sequence;
+    /// Memento of the checkpoint
+    memento_type memento;
+    /// Memory used by the mementos between the previous checkpoint and this one
+    std::size_t bytes;
+    /// Whether the memento hangs directly off the initial state
+    bool keyframe;
+  };
+
+  using iterator = typename std::deque<Entry>::const_iterator;
+
+  /**
+   * @brief Finds a checkpoint by binary search
+   *
+   * @param[in] sequence sequence number of the checkpoint
+   *
+   * @return iterator to the checkpoint, end of the history if it is not there
+   */
+  iterator position(sequence_type sequence) const {
+    auto it = std::lower_bound(
+        m_entries.begin(), m_entries.end(), sequence,
+        [](const Entry &x, sequence_type value) { return x.sequence < value; });
+    return (it != m_entries.end() && it->sequence == sequence) ? it : m_entries.end();
+  }
+
+  /**
+   * @brief Returns the number of checkpoints after the last keyframe
+   *
+   * @return number of checkpoints after the last keyframe
+   */
+  std::size_t since_keyframe() const {
+    std::size_t count = 0;
+    for (auto it = m_entries.rbegin(); it != m_entries.rend() && !it->keyframe; ++it) {
+      ++count;
+    }
+    return count;
+  }
+
+  /**
+   * @brief Returns the memory used by a memento, its ancestors excluded
+   *
+   * @param[in] node memento
+   *
+   * @return memory used by the memento
+   */
+  std::size_t node_bytes(const DeltaMemento<Delta> &node) const {
+    std::size_t bytes = sizeof(DeltaMemento<Delta>);
+    for (const auto &x : node.deltas()) {
+      bytes += m_options.delta_size ? m_options.delta_size(x) : sizeof(Delta);
+    }
+    return bytes;
+  }
+
+  /**
+   * @brief Collects the changes that lead from a memento to one of its descendants
+   *
+   * @param[in] from ancestor
+   * @param[in] to descendant
+   * @param[in,out] deltas changes appended in the order they were made
+   *
+   * @throw inconsistent_history if `to` doesn't descend from `from`
+   */
+  void collect(const DeltaMemento<Delta> *from, const DeltaMemento<Delta> *to,
+               std::vector<Delta> &deltas) const {
+    std::vector<const DeltaMemento<Delta> *> path;
+    for (auto node = to; node != from; node = node->parent().get()) {
+      if (!node || node->depth() <= from->depth()) {
+        std::stringstream estream;
+        estream << "ERROR : the checkpoints of the history are not in a single line" << std::endl;
+        estream << "\tthe originator was moved to a state outside the history" << std::endl;
+        throw inconsistent_history(estream.str());
+      }
+      path.push_back(node);
+    }
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+      deltas.insert(deltas.end(), (*it)->deltas().begin(), (*it)->deltas().end());
+    }
+  }
+
+  /**
+   * @brief Turns a checkpoint into a keyframe, and re-creates the checkpoints
+   * up to the next keyframe on top of it
+   *
+   * @param[in] first index of the checkpoint
+   */
+  void rebuild(std::size_t first) {
+    auto last = first + 1;
+    while (last < m_entries.size() && !m_entries[last].keyframe) {
+      ++last;
+    }
+    // Collect every change from the old mementos before replacing any of them
+    std::vector<std::vector<Delta>> segments(last - first);
+    auto base = first;
+    while (base > 0 && !m_entries[base - 1].keyframe) {
+      --base;
+    }
+    const DeltaMemento<Delta> *from = m_root.get();
+    if (base > 0) {
+      from = m_entries[base - 1].memento.get();
+      segments[0] = from->deltas();
+    }
+    collect(from, m_entries[first].memento.get(), segments[0]);
+    for (auto ii = first + 1; ii < last; ++ii) {
+      collect(m_entries[ii - 1].memento.get(), m_entries[ii].memento.get(),
+              segments[ii - first]);
+    }
+    auto parent = m_root;
+    for (auto ii = first; ii < last; ++ii) {
+      auto &deltas = segments[ii - first];
+      m_originator.coalesce(deltas);
+      auto node = m_pool.make(typename DeltaMemento<Delta>::Key(), std::move(parent),
+                              std::move(deltas));
+      auto bytes = node_bytes(*node);
+      ++m_statistics.allocations;
+      m_statistics.allocated_bytes += bytes;
+      auto &entry = m_entries[ii];
+      m_originator.replace_memento(entry.memento, node);
+      m_statistics.bytes = m_statistics.bytes - entry.bytes + bytes;
+      entry.bytes = bytes;
+      entry.memento = node;
+      parent = std::move(node);
+    }
+    m_entries[first].keyframe = true;
+  }
+
+  /// Object whose states are recorded
+  originator_type &m_originator;
+  /// Memory budget and keyframe interval
+  Options m_options;
+  /// Whether the originator merges changes into keyframes
+  bool m_coalesces;
+  /// Memento of the initial state of the originator
+  memento_type m_root;
+  /// Recycles the memory of the keyframes and of the compacted mementos
+  MementoPool<DeltaMemento<Delta>> m_pool;
+  /// Checkpoints, by increasing sequence number
+  std::deque<Entry> m_entries;
+  /// Sequence number of the next checkpoint
+  sequence_type m_next_sequence;
+  /// Sequence number of the state of the originator
+  sequence_type m_current;
+  /// Memory and time accounted so far
+  Statistics m_statistics;
+};
+}
+
+#endif /* MEMENTO_HISTORY_H_20261018 */
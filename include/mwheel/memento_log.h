@@ -0,0 +1,183 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file memento_log.h
+ *
+ * @brief Append-only binary log of serializable mementos
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 6:10 PM
+ */
+
+#ifndef MEMENTO_LOG_H_20261018
+#define MEMENTO_LOG_H_20261018
+
+#include <mwheel/serializable_object.h>
+#include <mwheel/utility.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace mwheel {
+
+/**
+ * @brief Appends mementos that are SerializableObject to a single file,
+ * and reads them back
+ *
+ * The file starts with an 8 bytes magic string, followed by one record
+ * per memento: the size of the state and the CRC-32 of the size and the
+ * state (both 32 bits little-endian), then the state as written by
+ * `SerializableObject::serialize(ByteSink&)`. Records are buffered
+ * and written in large chunks; reading streams the file sequentially in
+ * large chunks too, and hands each state to the memento straight from the
+ * read buffer (a MemorySource).
+ *
+ * When the log is opened again, the records are checked and the first one
+ * that was cut short or corrupted by a crash is dropped, together with
+ * everything after it.
+ *
+ * @warning The log is not thread-safe
+ */
+class MementoLog {
+public:
+  /// @brief Exception thrown if the log can't be read or written
+  MWHEEL_RUNTIME_EXCEPTION(log_error);
+
+  /// Default size of the buffers used to write and read the log
+  static constexpr std::size_t default_buffer_size = 1 << 22;
+
+  /// Receives the state of each memento in the log, and its size
+  using visitor_type = std::function<void(ByteSource &, std::size_t)>;
+
+  /**
+   * @brief Opens a log to append mementos, creating it if it doesn't exist
+   *
+   * @param[in] path path of the log
+   * @param[in] buffer_size bytes accumulated before writing to the file
+   *
+   * @throw log_error if the file can't be opened or is not a log
+   */
+  explicit MementoLog(const boost::filesystem::path &path,
+                      std::size_t buffer_size = default_buffer_size);
+
+  MementoLog(const MementoLog &) = delete;
+  MementoLog &operator=(const MementoLog &) = delete;
+
+  /**
+   * @brief Appends the state of a memento to the log
+   *
+   * @param[in] memento memento to be appended
+   *
+   * @throw log_error if the buffer can't be written to the file
+   */
+  void append(const SerializableObject &memento);
+
+  /**
+   * @brief Writes the buffered mementos to the file
+   *
+   * @param[in] sync if true waits until the data reached the disk
+   *
+   * @throw log_error if the file can't be written
+   */
+  void flush(bool sync = false);
+
+  /**
+   * @brief Returns the number of mementos in the log
+   *
+   * @return number of mementos in the log, buffered ones included
+   */
+  std::uint64_t size() const { return m_size; }
+
+  /**
+   * @brief Writes the buffered mementos, ignoring errors (call flush to check them)
+   */
+  ~MementoLog();
+
+  /**
+   * @brief Reads the states of the mementos in a log, in the order they were appended
+   *
+   * @param[in] path path of the log
+   * @param[in] visitor function called on the state of each memento
+   * @param[in] buffer_size size of the chunks read from the file
+   *
+   * @throw log_error if the file is not a log, or a state is corrupted
+   *
+   * @return number of mementos read
+   */
+  static std::uint64_t replay(const boost::filesystem::path &path, const visitor_type &visitor,
+                              std::size_t buffer_size = default_buffer_size);
+
+  /**
+   * @brief Reads all the mementos in a log
+   *
+   * @tparam T type of the mementos (default constructible SerializableObject)
+   *
+   * @param[in] path path of the log
+   *
+   * @throw log_error if the file is not a log, or a state is corrupted
+   *
+   * @return mementos, in the order they were appended
+   */
+  template <class T>
+  static std::vector<std::shared_ptr<T>> load(const boost::filesystem::path &path) {
+    std::vector<std::shared_ptr<T>> mementos;
+    replay(path, [&mementos](ByteSource &state, std::size_t) {
+      auto memento = std::make_shared<T>();
+      memento->deserialize(state);
+      mementos.push_back(std::move(memento));
+    });
+    return mementos;
+  }
+
+private:
+  /**
+   * @brief Writes the buffer to the file and empties it
+   */
+  void write_buffer();
+
+  /// Path of the log
+  boost::filesystem::path m_path;
+  /// File descriptor of the log
+  int m_fd;
+  /// Records not yet written
+  std::vector<char> m_buffer;
+  /// Bytes accumulated before writing to the file
+  std::size_t m_buffer_size;
+  /// Number of mementos in the log
+  std::uint64_t m_size;
+};
+}
+
+#endif /* MEMENTO_LOG_H_20261018 */
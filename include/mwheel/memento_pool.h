@@ -0,0 +1,437 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file memento_pool.h
+ *
+ * @brief Recycles the memory of the mementos created by an originator
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 5:30 PM
+ */
+
+#ifndef MEMENTO_POOL_H_20261018
+#define MEMENTO_POOL_H_20261018
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace mwheel {
+
+namespace implementation {
+
+/**
+ * @brief Free lists of memory blocks, one per block size
+ *
+ * Thread-safe: mementos may be released on any thread. The thread that
+ * created the free lists (the one of the originator) allocates and
+ * releases through a private list, without any synchronization. Blocks
+ * released by other threads are pushed on a shared lock-free list, which
+ * the owner takes over as a whole once its private list is empty.
+ */
+class MementoFreeList {
+public:
+  /// @brief Counters of the free list
+  struct Statistics {
+    /// Number of blocks requested to the heap
+    std::size_t allocations;
+    /// Number of blocks taken from a free list
+    std::size_t reuses;
+    /// Number of blocks currently in the free lists
+    std::size_t free_blocks;
+  };
+
+  MementoFreeList()
+      : m_owner(std::this_thread::get_id()), m_nbuckets(0), m_allocations(0), m_reuses(0),
+        m_free_blocks(0) {
+    for (auto &x : m_buckets) {
+      x.size = 0;
+      x.local = nullptr;
+      x.shared = nullptr;
+    }
+  }
+
+  MementoFreeList(const MementoFreeList &) = delete;
+  MementoFreeList &operator=(const MementoFreeList &) = delete;
+
+  /**
+   * @brief Returns a block of memory
+   *
+   * @param[in] size size of the block
+   *
+   * @return block, suitably aligned for any fundamental type
+   */
+  void *allocate(std::size_t size) {
+    auto bucket = find_bucket(size);
+    auto block = bucket ? pop(*bucket) : nullptr;
+    if (block) {
+      m_reuses.fetch_add(1, std::memory_order_relaxed);
+      m_free_blocks.fetch_sub(1, std::memory_order_relaxed);
+      return block;
+    }
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(std::max(size, sizeof(Block)));
+  }
+
+  /**
+   * @brief Puts a block back in the free list of its size
+   *
+   * @param[in] memory block returned by allocate
+   * @param[in] size size of the block
+   */
+  void deallocate(void *memory, std::size_t size) {
+    auto bucket = find_bucket(size);
+    if (!bucket) {
+      ::operator delete(memory);
+      return;
+    }
+    push(*bucket, static_cast<Block *>(memory));
+    m_free_blocks.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Gives the blocks in the free lists back to the heap
+   *
+   * Only the thread that owns the free lists releases its private lists.
+   */
+  void shrink() {
+    auto owner = std::this_thread::get_id() == m_owner;
+    for (auto ii = std::size_t(0), n = m_nbuckets.load(); ii < n; ++ii) {
+      auto &bucket = m_buckets[ii];
+      auto released = release(bucket.shared.exchange(nullptr, std::memory_order_acquire));
+      if (owner) {
+        released += release(bucket.local);
+        bucket.local = nullptr;
+      }
+      m_free_blocks.fetch_sub(released, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Returns the counters of the free list
+   *
+   * @return counters of the free list
+   */
+  Statistics statistics() const {
+    return Statistics{m_allocations.load(std::memory_order_relaxed),
+                      m_reuses.load(std::memory_order_relaxed),
+                      m_free_blocks.load(std::memory_order_relaxed)};
+  }
+
+  ~MementoFreeList() {
+    for (auto ii = std::size_t(0), n = m_nbuckets.load(); ii < n; ++ii) {
+      release(m_buckets[ii].local);
+      release(m_buckets[ii].shared.load());
+    }
+  }
+
+private:
+  /// Free block, linked to the next free block of the same size
+  struct Block {
+    Block *next;
+  };
+
+  /// Free blocks of a given size
+  struct Bucket {
+    /// Size of the blocks (never changes once the bucket is published)
+    std::size_t size;
+    /// Blocks released by the owner, accessed only by the owner
+    Block *local;
+    /// Blocks released by the other threads
+    std::atomic<Block *> shared;
+  };
+
+  /// Maximum number of block sizes that are recycled
+  static const std::size_t max_buckets = 16;
+
+  /**
+   * @brief Returns the free list of blocks of a given size, creating it if needed
+   *
+   * Originators create mementos of very few different sizes: a linear
+   * search is faster than any associative container. Buckets are only
+   * appended, so that they can be searched without any lock.
+   *
+   * @param[in] size size of the blocks
+   *
+   * @return free list of blocks of the given size, nullptr if there are
+   * too many different sizes
+   */
+  Bucket *find_bucket(std::size_t size) {
+    auto n = m_nbuckets.load(std::memory_order_acquire);
+    for (std::size_t ii = 0; ii < n; ++ii) {
+      if (m_buckets[ii].size == size) {
+        return &m_buckets[ii];
+      }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    n = m_nbuckets.load(std::memory_order_relaxed);
+    for (std::size_t ii = 0; ii < n; ++ii) {
+      if (m_buckets[ii].size == size) {
+        return &m_buckets[ii];
+      }
+    }
+    if (n == max_buckets) {
+      return nullptr;
+    }
+    m_buckets[n].size = size;
+    m_nbuckets.store(n + 1, std::memory_order_release);
+    return &m_buckets[n];
+  }
+
+  /**
+   * @brief Takes a block from a free list
+   *
+   * The shared list is only ever emptied as a whole, which rules out ABA
+   * problems.
+   *
+   * @param[in,out] bucket free list
+   *
+   * @return a block, nullptr if the list is empty
+   */
+  Block *pop(Bucket &bucket) {
+    if (std::this_thread::get_id() == m_owner) {
+      if (!bucket.local) {
+        bucket.local = bucket.shared.exchange(nullptr, std::memory_order_acquire);
+      }
+      auto block = bucket.local;
+      if (block) {
+        bucket.local = block->next;
+      }
+      return block;
+    }
+    auto block = bucket.shared.exchange(nullptr, std::memory_order_acquire);
+    if (block) {
+      push_shared(bucket, block->next);
+    }
+    return block;
+  }
+
+  /**
+   * @brief Puts a block in a free list
+   *
+   * @param[in,out] bucket free list
+   * @param[in] block block to be recycled
+   */
+  void push(Bucket &bucket, Block *block) {
+    if (std::this_thread::get_id() == m_owner) {
+      block->next = bucket.local;
+      bucket.local = block;
+      return;
+    }
+    block->next = nullptr;
+    push_shared(bucket, block);
+  }
+
+  /**
+   * @brief Puts a chain of blocks in the shared free list
+   *
+   * @param[in,out] bucket free list
+   * @param[in] first first block of the chain (may be nullptr)
+   */
+  static void push_shared(Bucket &bucket, Block *first) {
+    if (!first) {
+      return;
+    }
+    auto last = first;
+    while (last->next) {
+      last = last->next;
+    }
+    last->next = bucket.shared.load(std::memory_order_relaxed);
+    while (!bucket.shared.compare_exchange_weak(last->next, first, std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+    }
+  }
+
+  /**
+   * @brief Gives a chain of blocks back to the heap
+   *
+   * @param[in] block first block of the chain (may be nullptr)
+   *
+   * @return number of blocks released
+   */
+  static std::size_t release(Block *block) {
+    std::size_t count = 0;
+    while (block) {
+      auto next = block->next;
+      ::operator delete(block);
+      block = next;
+      ++count;
+    }
+    return count;
+  }
+
+  /// Thread that allocates and releases without synchronization
+  const std::thread::id m_owner;
+  /// Free lists, one per block size
+  Bucket m_buckets[max_buckets];
+  /// Number of buckets in use
+  std::atomic<std::size_t> m_nbuckets;
+  /// Serializes the creation of the buckets
+  std::mutex m_mutex;
+  /// Number of blocks requested to the heap
+  std::atomic<std::size_t> m_allocations;
+  /// Number of blocks taken from a free list
+  std::atomic<std::size_t> m_reuses;
+  /// Number of blocks currently in the free lists
+  std::atomic<std::size_t> m_free_blocks;
+};
+}
+
+/**
+ * @brief Allocator that recycles its blocks through a MementoFreeList
+ *
+ * Meant for `std::allocate_shared`, which places the control block and the
+ * object in a single block. Copies (and rebound copies) share the same
+ * free lists, which live as long as the last block allocated from them.
+ *
+ * @tparam U type of the objects allocated
+ */
+template <class U> class PoolAllocator {
+public:
+  using value_type = U;
+
+  /**
+   * @brief Creates an allocator that uses the given free lists
+   *
+   * @param[in] free_list free lists shared among the copies of the allocator
+   */
+  explicit PoolAllocator(std::shared_ptr<implementation::MementoFreeList> free_list)
+      : m_free_list(std::move(free_list)) {}
+
+  /// @brief Rebinding constructor
+  template <class V>
+  PoolAllocator(const PoolAllocator<V> &other) : m_free_list(other.free_list()) {}
+
+  /**
+   * @brief Allocates memory for n objects of type U
+   *
+   * @param[in] n number of objects
+   *
+   * @return uninitialized memory for the objects
+   */
+  U *allocate(std::size_t n) {
+    static_assert(alignof(U) <= alignof(std::max_align_t),
+                  "PoolAllocator doesn't support over-aligned types");
+    return static_cast<U *>(m_free_list->allocate(n * sizeof(U)));
+  }
+
+  /**
+   * @brief Puts memory back in the free lists
+   *
+   * @param[in] memory memory returned by allocate
+   * @param[in] n number of objects
+   */
+  void deallocate(U *memory, std::size_t n) { m_free_list->deallocate(memory, n * sizeof(U)); }
+
+  /**
+   * @brief Returns the free lists used by the allocator
+   *
+   * @return free lists used by the allocator
+   */
+  const std::shared_ptr<implementation::MementoFreeList> &free_list() const { return m_free_list; }
+
+private:
+  /// Free lists shared among the copies of the allocator
+  std::shared_ptr<implementation::MementoFreeList> m_free_list;
+};
+
+template <class U, class V>
+bool operator==(const PoolAllocator<U> &lhs, const PoolAllocator<V> &rhs) {
+  return lhs.free_list() == rhs.free_list();
+}
+
+template <class U, class V>
+bool operator!=(const PoolAllocator<U> &lhs, const PoolAllocator<V> &rhs) {
+  return !(lhs == rhs);
+}
+
+/**
+ * @brief Creates the mementos of an originator, recycling the memory of
+ * those that were released
+ *
+ * An originator owns a pool and creates its mementos with make() instead
+ * of `std::make_shared`. Whenever the last reference to a memento is
+ * dropped (by set_state, by a history that evicts it, ...) its memory goes
+ * back to the pool, so that checkpointing at a steady rate doesn't
+ * allocate. Only the memory of the memento itself is recycled: mementos
+ * that own other memory (e.g. a std::vector) should reuse it on their own.
+ *
+ * @tparam T type of the memento (may be abstract)
+ */
+template <class T> class MementoPool {
+public:
+  /// Type of the memento associated with the originator
+  using memento_type = std::shared_ptr<T>;
+  /// Counters of the pool
+  using Statistics = implementation::MementoFreeList::Statistics;
+
+  MementoPool() : m_free_list(std::make_shared<implementation::MementoFreeList>()) {}
+
+  MementoPool(const MementoPool &) = delete;
+  MementoPool &operator=(const MementoPool &) = delete;
+
+  /**
+   * @brief Creates a memento with memory taken from the pool
+   *
+   * @tparam U concrete type of the memento (T or a type derived from T)
+   *
+   * @param[in] args arguments forwarded to the constructor of U
+   *
+   * @return new memento
+   */
+  template <class U = T, class... Args> std::shared_ptr<U> make(Args &&... args) {
+    return std::allocate_shared<U>(PoolAllocator<U>(m_free_list), std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief Gives the memory recycled so far back to the heap
+   */
+  void shrink() { m_free_list->shrink(); }
+
+  /**
+   * @brief Returns the counters of the pool
+   *
+   * @return number of blocks allocated, reused and available
+   */
+  Statistics statistics() const { return m_free_list->statistics(); }
+
+private:
+  /// Free lists, shared with the mementos still alive
+  std::shared_ptr<implementation::MementoFreeList> m_free_list;
+};
+}
+
+#endif /* MEMENTO_POOL_H_20261018 */
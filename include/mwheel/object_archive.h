@@ -0,0 +1,264 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file object_archive.h
+ *
+ * @brief Single indexed file that stores the states of many serializable objects
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 8:30 PM
+ */
+
+#ifndef OBJECT_ARCHIVE_H_20261018
+#define OBJECT_ARCHIVE_H_20261018
+
+#include <mwheel/mapped_file.h>
+#include <mwheel/serializable_object.h>
+#include <mwheel/singleton.h>
+#include <mwheel/thread_pool.h>
+#include <mwheel/utility.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mwheel {
+
+namespace implementation {
+
+/// @brief Position of a state in an archive
+struct ArchiveEntry {
+  /// Offset of the first byte of the state
+  std::uint64_t offset;
+  /// Number of bytes of the state
+  std::uint64_t size;
+  /// CRC-32 of the state
+  std::uint32_t checksum;
+};
+
+/**
+ * @brief Returns an object of a range passed to ArchiveWriter::write
+ */
+inline const SerializableObject &as_serializable(const SerializableObject &object) {
+  return object;
+}
+
+/**
+ * @brief Returns the object a (smart) pointer of a range points to
+ */
+template <class Pointer>
+auto as_serializable(const Pointer &pointer) -> decltype(as_serializable(*pointer)) {
+  return as_serializable(*pointer);
+}
+}
+
+/**
+ * @brief Serializes many objects into a single archive
+ *
+ * Each batch of objects is serialized in parallel, into one buffer per
+ * task, and the buffers are appended to the file with a single gather
+ * write. The index of the states is written by commit(), which is also
+ * the only point where the file is synchronized with the disk.
+ *
+ * The archive starts with an 8 bytes magic string, followed by the
+ * states, the index (offset, size and CRC-32 of each state) and a footer
+ * with the offset of the index, the number of states and the magic string
+ * again. All the integers are little-endian.
+ *
+ * @warning The writer is not thread-safe, and must not be used from a
+ * task of its own thread pool
+ */
+class ArchiveWriter {
+public:
+  /// @brief Exception thrown if the archive can't be written
+  MWHEEL_RUNTIME_EXCEPTION(archive_error);
+
+  /**
+   * @brief Creates an archive, replacing any file at the same path
+   *
+   * @param[in] path path of the archive
+   * @param[in] pool threads that serialize the objects
+   *
+   * @throw archive_error if the file can't be created
+   */
+  explicit ArchiveWriter(const boost::filesystem::path &path,
+                         ThreadPool &pool = Singleton<ThreadPool>::get_instance());
+
+  ArchiveWriter(const ArchiveWriter &) = delete;
+  ArchiveWriter &operator=(const ArchiveWriter &) = delete;
+
+  /**
+   * @brief Appends the states of a range of objects
+   *
+   * @tparam Iterator iterator to SerializableObject, or to (smart) pointers to them
+   *
+   * @param[in] first first object
+   * @param[in] last one past the last object
+   *
+   * @throw archive_error if the states can't be written
+   */
+  template <class Iterator> void write(Iterator first, Iterator last) {
+    std::vector<const SerializableObject *> objects;
+    for (; first != last; ++first) {
+      objects.push_back(&implementation::as_serializable(*first));
+    }
+    write(objects);
+  }
+
+  /**
+   * @brief Appends the states of a sequence of objects
+   *
+   * @param[in] objects objects to be serialized, in order
+   *
+   * @throw archive_error if the states can't be written (if the file
+   * can't be written, the archive can't be used anymore)
+   */
+  void write(const std::vector<const SerializableObject *> &objects);
+
+  /**
+   * @brief Writes the index and waits until the archive reached the disk
+   *
+   * Both the archive and the entry of its directory are synchronized, so
+   * that a newly created archive survives a crash. No state can be
+   * appended afterwards.
+   *
+   * @throw archive_error if the archive is already committed, failed, or can't be written
+   */
+  void commit();
+
+  /**
+   * @brief Returns the number of states in the archive
+   *
+   * @return number of states in the archive
+   */
+  std::size_t size() const { return m_index.size(); }
+
+  /**
+   * @brief Closes the file: an archive that was not committed can't be read
+   */
+  ~ArchiveWriter();
+
+private:
+  /**
+   * @brief Throws if the archive is already committed, or failed
+   */
+  void check_open() const;
+
+  /**
+   * @brief Closes the archive after an error left the file in an unknown state
+   *
+   * @param[in] reason why the archive can't be written
+   *
+   * @throw archive_error always
+   */
+  [[noreturn]] void fail(const std::string &reason);
+
+  /// Path of the archive
+  boost::filesystem::path m_path;
+  /// File descriptor of the archive, -1 after commit or failure
+  int m_fd;
+  /// True if writing the file failed
+  bool m_failed;
+  /// Threads that serialize the objects
+  ThreadPool &m_pool;
+  /// Bytes written so far
+  std::uint64_t m_offset;
+  /// Position of each state
+  std::vector<implementation::ArchiveEntry> m_index;
+};
+
+/**
+ * @brief Reads states from an archive written by ArchiveWriter
+ *
+ * The archive is mapped in memory, and only the index is read when it is
+ * opened: each state is read only when it is de-serialized, straight from
+ * the mapping.
+ */
+class ArchiveReader {
+public:
+  /// @brief Exception thrown if the archive can't be read
+  MWHEEL_RUNTIME_EXCEPTION(archive_error);
+
+  /**
+   * @brief Opens an archive
+   *
+   * @param[in] path path of the archive
+   *
+   * @throw archive_error if the file can't be mapped, or is not a committed archive
+   */
+  explicit ArchiveReader(const boost::filesystem::path &path);
+
+  /**
+   * @brief Returns the number of states in the archive
+   *
+   * @return number of states in the archive
+   */
+  std::size_t size() const { return m_index.size(); }
+
+  /**
+   * @brief Returns the size of a state
+   *
+   * @param[in] index position of the state in the archive
+   *
+   * @throw archive_error if the index is out of range
+   *
+   * @return number of bytes of the state
+   */
+  std::size_t state_size(std::size_t index) const;
+
+  /**
+   * @brief De-serializes a state into an object
+   *
+   * @param[in] index position of the state in the archive
+   * @param[in,out] object object that receives the state
+   *
+   * @throw archive_error if the index is out of range, or the state is corrupted
+   */
+  void read(std::size_t index, SerializableObject &object) const;
+
+private:
+  /**
+   * @brief Returns the entry of a state
+   *
+   * @throw archive_error if the index is out of range
+   */
+  const implementation::ArchiveEntry &entry(std::size_t index) const;
+
+  /// Mapping of the archive
+  MappedFile m_file;
+  /// Position of each state
+  std::vector<implementation::ArchiveEntry> m_index;
+};
+}
+
+#endif /* OBJECT_ARCHIVE_H_20261018 */
@@ -0,0 +1,175 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file object_arena.h
+ *
+ * @brief Monotonic arena that owns the objects constructed into it
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 9:12 AM
+ */
+
+#ifndef OBJECT_ARENA_H_20261018
+#define OBJECT_ARENA_H_20261018
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mwheel {
+
+/**
+ * @brief Constructs objects of arbitrary type in large memory blocks and
+ * destroys all of them at once when the arena goes out of scope
+ *
+ * Objects are destroyed in reverse order of construction. Nothing is
+ * ever freed individually: the arena is meant to back trees of objects
+ * that share the same lifetime (e.g. the children of a CompositeBase
+ * that stores raw pointers).
+ *
+ * @warning The arena is not thread-safe
+ */
+class ObjectArena {
+public:
+  /// Default size of the memory blocks allocated by the arena
+  static constexpr std::size_t default_block_size = 4096;
+
+  /**
+   * @brief Constructs an empty arena
+   *
+   * @param[in] block_size size in bytes of the memory blocks requested to the heap
+   */
+  explicit ObjectArena(std::size_t block_size = default_block_size)
+      : m_block_size(block_size), m_current(nullptr), m_available(0) {}
+
+  ObjectArena(const ObjectArena &) = delete;
+  ObjectArena &operator=(const ObjectArena &) = delete;
+
+  /**
+   * @brief Constructs an object of type T in the arena
+   *
+   * @param[in] args arguments forwarded to the constructor of T
+   *
+   * @return pointer to the newly constructed object, owned by the arena
+   */
+  template <class T, class... Args> T *create(Args &&... args) {
+    if (!std::is_trivially_destructible<T>::value &&
+        m_destructors.size() == m_destructors.capacity()) {
+      // Grow up-front, so that a throw can't leave an object without its destructor
+      m_destructors.reserve(2 * m_destructors.size() + 16);
+    }
+    auto memory = allocate(sizeof(T), alignof(T));
+    auto object = ::new (memory) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value) {
+      m_destructors.push_back(Destructor{object, &ObjectArena::destroy<T>});
+    }
+    ++m_size;
+    return object;
+  }
+
+  /**
+   * @brief Returns the number of objects constructed in the arena
+   *
+   * @return number of objects constructed in the arena
+   */
+  std::size_t size() const { return m_size; }
+
+  /**
+   * @brief Returns the number of bytes requested to the heap so far
+   *
+   * @return number of bytes requested to the heap so far
+   */
+  std::size_t capacity() const { return m_capacity; }
+
+  /**
+   * @brief Destroys all the objects in reverse order of construction
+   */
+  ~ObjectArena() {
+    for (auto it = m_destructors.rbegin(); it != m_destructors.rend(); ++it) {
+      it->destroy(it->object);
+    }
+  }
+
+private:
+  /**
+   * @brief Returns a chunk of raw memory with the requested size and alignment
+   *
+   * @param[in] size size of the chunk
+   * @param[in] alignment alignment of the chunk
+   *
+   * @return pointer to the chunk
+   */
+  void *allocate(std::size_t size, std::size_t alignment) {
+    void *memory = m_current;
+    if (!memory || !std::align(alignment, size, memory, m_available)) {
+      // Objects bigger than a block get a dedicated block
+      auto block_size = std::max(m_block_size, size + alignment);
+      m_blocks.emplace_back(new unsigned char[block_size]);
+      m_capacity += block_size;
+      memory = m_blocks.back().get();
+      m_available = block_size;
+      std::align(alignment, size, memory, m_available);
+    }
+    m_current = static_cast<unsigned char *>(memory) + size;
+    m_available -= size;
+    return memory;
+  }
+
+  /// Calls the destructor of an object of type T
+  template <class T> static void destroy(void *object) { static_cast<T *>(object)->~T(); }
+
+  /// Type-erased destructor of an object living in the arena
+  struct Destructor {
+    void *object;
+    void (*destroy)(void *);
+  };
+
+  /// Size of the blocks requested to the heap
+  std::size_t m_block_size;
+  /// First free byte in the current block
+  void *m_current;
+  /// Number of bytes available in the current block
+  std::size_t m_available;
+  /// Number of objects constructed so far
+  std::size_t m_size = 0;
+  /// Number of bytes requested to the heap
+  std::size_t m_capacity = 0;
+  /// Memory blocks
+  std::vector<std::unique_ptr<unsigned char[]>> m_blocks;
+  /// Destructors of the objects that are not trivially destructible
+  std::vector<Destructor> m_destructors;
+};
+}
+
+#endif /* OBJECT_ARENA_H_20261018 */
@@ -0,0 +1,141 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file on_demand_loader.h
+ *
+ * @brief Loads plug-ins the first time one of their products is requested
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 4:40 PM
+ */
+
+#ifndef ON_DEMAND_LOADER_H_20261018
+#define ON_DEMAND_LOADER_H_20261018
+
+#include <mwheel/dlmanager.h>
+#include <mwheel/plugin.h>
+#include <mwheel/plugin_catalog.h>
+
+#include <boost/filesystem.hpp>
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace mwheel {
+
+/**
+ * @brief Hooks into the tag resolver of one or more factories, and loads the
+ * plug-in that provides a missing tag according to a PluginCatalog
+ *
+ * The static registration of the plug-in then makes the tag available, and
+ * the factory retries the creation. Concurrent misses, on the same tag or
+ * on different ones, are served by a single load at a time: threads that miss
+ * a tag while its library is being loaded wait for that load to complete.
+ *
+ * The loader detaches itself from the factories it is still attached to when
+ * it is destroyed.
+ *
+ * @warning The loader must not be destroyed while the factories it is attached
+ * to are creating products, and neither the catalog nor the manager may be
+ * modified elsewhere while the loader is in use.
+ */
+class OnDemandLoader {
+public:
+  /**
+   * @brief Constructs a loader
+   *
+   * @param[in] manager manager used to load the plug-ins
+   * @param[in] catalog catalog that maps products to plug-ins
+   */
+  OnDemandLoader(DLManager &manager, const PluginCatalog &catalog)
+      : m_manager(manager), m_catalog(catalog) {}
+
+  OnDemandLoader(const OnDemandLoader &) = delete;
+  OnDemandLoader &operator=(const OnDemandLoader &) = delete;
+
+  /**
+   * @brief Detaches the loader from the factories it is still attached to
+   */
+  ~OnDemandLoader();
+
+  /**
+   * @brief Sets the loader as the tag resolver of a factory
+   *
+   * @param[in] factory factory that should load plug-ins on demand
+   */
+  template <class FactoryType> void attach(FactoryType &factory) {
+    factory.set_tag_resolver([this](const typename FactoryType::tag_type &tag) {
+      return load_provider(make_plugin_product<FactoryType>(tag));
+    });
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    m_attached[&factory] = [&factory]() { factory.set_tag_resolver(nullptr); };
+  }
+
+  /**
+   * @brief Removes the tag resolver of a factory
+   *
+   * @param[in] factory factory that should stop loading plug-ins on demand
+   */
+  template <class FactoryType> void detach(FactoryType &factory) {
+    factory.set_tag_resolver(nullptr);
+    std::lock_guard<std::recursive_mutex> lock(m_mutex);
+    m_attached.erase(&factory);
+  }
+
+  /**
+   * @brief Loads the plug-in that provides a product, if not loaded already
+   *
+   * @param[in] product product that was requested
+   *
+   * @throw DLManager::error_loading_dynamic_library if the plug-in can't be loaded
+   *
+   * @return true if the plug-in that provides the product is loaded, false if
+   * no plug-in provides the product or if the plug-in is still being loaded
+   * by the calling thread
+   */
+  bool load_provider(const PluginProduct &product);
+
+private:
+  /// Manager used to load the plug-ins
+  DLManager &m_manager;
+  /// Catalog that maps products to plug-ins
+  const PluginCatalog &m_catalog;
+  /// Serializes loads (recursive, as a plug-in may trigger a load while being loaded)
+  std::recursive_mutex m_mutex;
+  /// Libraries being loaded, used to detect recursive requests for the same library
+  std::set<boost::filesystem::path> m_in_flight;
+  /// Remove the resolver of each factory the loader is attached to
+  std::map<const void *, std::function<void()>> m_attached;
+};
+}
+
+#endif /* ON_DEMAND_LOADER_H_20261018 */
@@ -43,15 +43,65 @@
 #include <mwheel/singleton.h>
 #include <mwheel/prototype_factory.h>
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 #include <vector>
 
 /**
  * @brief Must be used inside the public part of an interface to
  * expose the type `factory_type`
+ *
+ * The interface is considered at version 1.0.0: see
+ * MWHEEL_EXPOSE_VERSIONED_INTERFACE_FACTORY
  */
 #define MWHEEL_EXPOSE_INTERFACE_FACTORY(InterfaceType, TagType)                                    \
+  MWHEEL_EXPOSE_VERSIONED_INTERFACE_FACTORY(InterfaceType, TagType, 1, 0, 0)
+
+/**
+ * @brief Must be used inside the public part of an interface to expose
+ * the type `factory_type` and the version of the interface
+ *
+ * The version follows semantic versioning: plug-ins built against the same
+ * major version and an older or equal minor version are compatible. The
+ * interface and the tag type are identified by their fully qualified names,
+ * as spelled by the compiler (aliases resolved).
+ */
+#define MWHEEL_EXPOSE_VERSIONED_INTERFACE_FACTORY(InterfaceType, TagType, major, minor, patch)     \
+  static constexpr ::mwheel::PluginDescriptor plugin_descriptor() {                                \
+    return ::mwheel::implementation::make_plugin_descriptor(                                       \
+        ::mwheel::implementation::type_hash<InterfaceType>(),                                      \
+        ::mwheel::implementation::type_hash<TagType>(), major, minor, patch);                      \
+  }                                                                                                \
   using factory_type = mwheel::Singleton<mwheel::PrototypeFactory<InterfaceType, TagType>>
 
+/**
+ * @brief Exports the descriptor of a plug-in, which DLManager checks
+ * before loading it
+ *
+ * Must be used once per plug-in library, at global scope, naming the
+ * interface its products implement. The descriptor is a constant
+ * expression: if the compiler can't evaluate it, the plug-in doesn't build,
+ * instead of getting a descriptor initialized at load time that DLManager
+ * couldn't read from the file.
+ */
+#define MWHEEL_PLUGIN_DESCRIPTOR(InterfaceType)                                                    \
+  extern "C" __attribute__((visibility("default"))) constexpr ::mwheel::PluginDescriptor           \
+      mwheel_plugin_descriptor = InterfaceType::plugin_descriptor()
+
+/**
+ * @brief Name of the symbol defined by MWHEEL_PLUGIN_DESCRIPTOR
+ */
+#define MWHEEL_PLUGIN_DESCRIPTOR_SYMBOL "mwheel_plugin_descriptor"
+
 /**
  * @brief Must be used in the private section of a concrete product to
  * make it registrable
@@ -93,8 +143,8 @@ bool ProductType::m_is_registered(
  * @brief Registers a tag/plugin-object pair into the factory
  */
 #define MWHEEL_REGISTER_TAG_PLUGIN_OBJECT_PAIR(tag_value, object)                                  \
-  MWHEEL_REGISTER_TAG_OBJECT_PAIR(tag_value, object)                                               \
-  &&unloader.on_unload([]() { factory_type::get_instance().unregister_prototype(tag_value); })
+  mwheel::implementation::register_plugin_prototype<factory_type>(tag_value, object, unloader,     \
+                                                                  []() {})
 
 /**
  * @brief Must be used in the implementation file of a concrete product that
@@ -114,26 +164,474 @@ bool ProductType::m_is_registered(
   MWHEEL_REGISTER_TAG_OBJECT_PAIR(tag_value, make_shared<ProductType>())                           \
   MWHEEL_REGISTER_PRODUCT_END()
 
+/**
+ * @brief Name of the ELF section that holds the table of products of a plug-in
+ */
+#define MWHEEL_PRODUCT_TABLE_SECTION "mwheel_products"
+
+/**
+ * @brief Name of the function exported by each shared object that includes
+ * this header, which returns the bounds of its table of products
+ */
+#define MWHEEL_PRODUCT_TABLE_SYMBOL "mwheel_product_table"
+
+/**
+ * @brief Adds a product to the table of products of a plug-in, as an
+ * alternative to MWHEEL_REGISTER_PLUGIN_PRODUCT
+ *
+ * The entry is a constant-initialized descriptor placed in a dedicated ELF
+ * section: nothing runs at static initialization time. DLManager imports the
+ * whole table in a single pass right after `dlopen`, so products listed here
+ * are available only in plug-ins loaded by a DLManager, and a tag that is
+ * already taken makes the load fail. The tag type of the factory must be
+ * constructible from a string literal.
+ *
+ * The table is found through the function named by MWHEEL_PRODUCT_TABLE_SYMBOL,
+ * whose reference to the bounds of the section also keeps the table when
+ * linking with `--gc-sections`.
+ */
+#define MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY(ProductType, tag_value)                                  \
+  MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY_NAMED(ProductType, tag_value, __COUNTER__)
+
+/// Helper of MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY (expands the counter)
+#define MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY_NAMED(ProductType, tag_value, counter)                   \
+  MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY_DEFINE(ProductType, tag_value,                                 \
+                                           MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY_NAME(counter))
+
+/// Helper of MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY (names the descriptor)
+#define MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY_NAME(counter) mwheel_product_entry_##counter
+
+/// Helper of MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY (defines the descriptor)
+#define MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY_DEFINE(ProductType, tag_value, name)                     \
+  namespace {                                                                                      \
+  __attribute__((section(MWHEEL_PRODUCT_TABLE_SECTION),                                            \
+                 used)) const ::mwheel::ProductDescriptor name = {                                 \
+      &::mwheel::implementation::import_product<ProductType>, tag_value};                         \
+  }
+
 namespace mwheel {
+
+/**
+ * @brief Version of an interface, following semantic versioning
+ */
+struct SemanticVersion {
+  /// Incremented on incompatible changes
+  std::uint32_t major_version;
+  /// Incremented on backward compatible additions
+  std::uint32_t minor_version;
+  /// Incremented on fixes that don't change the interface
+  std::uint32_t patch_version;
+};
+
+/**
+ * @brief Compatibility information exported by a plug-in
+ *
+ * Made only of integers, so that it can be read from the file before the
+ * plug-in is loaded (no relocation applies to it).
+ */
+struct PluginDescriptor {
+  /// Identifies the layout of this structure
+  std::uint64_t magic;
+  /// Identifies the C++ ABI the plug-in was compiled for
+  std::uint64_t abi;
+  /// Hash of the fully qualified name of the interface
+  std::uint64_t interface_hash;
+  /// Hash of the fully qualified name of the tag type of the factory
+  std::uint64_t tag_type_hash;
+  /// Version of the interface the plug-in was built against
+  SemanticVersion version;
+};
+
+/**
+ * @brief Entry of the table of products of a plug-in
+ *
+ * The alignment equals the size, so that the entries coming from different
+ * translation units are laid out as an array.
+ */
+struct alignas(2 * sizeof(void *)) ProductDescriptor {
+  /// Registers the product into its factory (nullptr in padding)
+  bool (*import)(const ProductDescriptor &);
+  /// Tag of the product
+  const char *tag;
+};
+
+static_assert(sizeof(ProductDescriptor) == alignof(ProductDescriptor),
+              "entries of the table of products must be contiguous");
+
+/**
+ * @brief Product registered by a plug-in
+ */
+struct PluginProduct {
+  /// Mangled name of the interface of the factory the product was registered into
+  std::string interface;
+  /// Tag of the product, as printed by `operator<<`
+  std::string tag;
+};
+
+/**
+ * @brief Returns the key that identifies a product of a given factory
+ *
+ * @tparam FactoryType type of the factory
+ *
+ * @param[in] tag tag of the product
+ *
+ * @return key that identifies the product
+ */
+template <class FactoryType>
+PluginProduct make_plugin_product(const typename FactoryType::tag_type &tag) {
+  std::stringstream tag_stream;
+  tag_stream << tag;
+  return PluginProduct{typeid(typename FactoryType::interface_type).name(), tag_stream.str()};
+}
+
 /**
  * @brief Implementation details that should be hidden to end-users
  */
 namespace implementation {
 
 /**
- * @brief Triggers a custom action in its destructor
+ * @brief Characters of a string known at compile-time
+ */
+struct StringRange {
+  /// First character
+  const char *text;
+  /// Number of characters
+  std::size_t size;
+};
+
+/**
+ * @brief FNV-1a hash of a range of characters, computed at compile-time
+ *
+ * The range is split in halves, so that the depth of the recursion grows
+ * with the logarithm of the size (the compiler bounds the depth of constant
+ * evaluations, 512 by default for GCC).
+ *
+ * @param[in] text first character
+ * @param[in] size number of characters
+ * @param[in] hash hash of the characters that precede `text`
+ *
+ * @return hash of the characters
+ */
+constexpr std::uint64_t fnv1a(const char *text, std::size_t size,
+                              std::uint64_t hash = 14695981039346656037ull) {
+  return size == 0   ? hash
+         : size == 1 ? (hash ^ static_cast<unsigned char>(*text)) * 1099511628211ull
+                     : fnv1a(text + size / 2, size - size / 2, fnv1a(text, size / 2, hash));
+}
+
+/**
+ * @brief Checks at compile-time whether a string starts with a prefix
+ *
+ * @param[in] text null terminated string
+ * @param[in] prefix null terminated prefix (a few characters)
+ *
+ * @return true if `text` starts with `prefix`
+ */
+constexpr bool starts_with(const char *text, const char *prefix) {
+  return !*prefix || (*text == *prefix && starts_with(text + 1, prefix + 1));
+}
+
+/**
+ * @brief Returns the first of two positions that is not `none`
+ */
+constexpr std::size_t first_found(std::size_t left, std::size_t right, std::size_t none) {
+  return left != none ? left : right;
+}
+
+/**
+ * @brief Finds the first occurrence of a marker in a range of a string, at compile-time
+ *
+ * The range is split in halves, to bound the depth of the recursion.
+ *
+ * @param[in] text null terminated string
+ * @param[in] begin first position to be checked
+ * @param[in] end one past the last position to be checked
+ * @param[in] marker null terminated string to look for
+ * @param[in] none value returned if the marker is missing
+ *
+ * @return position of the marker, or `none`
+ */
+constexpr std::size_t find_marker(const char *text, std::size_t begin, std::size_t end,
+                                  const char *marker, std::size_t none) {
+  return end - begin == 0 ? none
+         : end - begin == 1
+             ? (starts_with(text + begin, marker) ? begin : none)
+             : first_found(find_marker(text, begin, begin + (end - begin) / 2, marker, none),
+                           find_marker(text, begin + (end - begin) / 2, end, marker, none), none);
+}
+
+/**
+ * @brief Returns the signature of this very function, which contains the
+ * fully qualified name of the type as spelled by the compiler
+ */
+template <class T> constexpr StringRange type_signature() {
+  return StringRange{__PRETTY_FUNCTION__, sizeof(__PRETTY_FUNCTION__) - 1};
+}
+
+/**
+ * @brief Hashes the characters of a signature that follow a marker
+ *
+ * @param[in] signature signature of type_signature
+ * @param[in] position position of the marker, `signature.size` if missing
+ * @param[in] marker_size length of the marker
+ *
+ * @return hash of the characters after the marker (of an empty name if it is missing)
+ */
+constexpr std::uint64_t hash_after(StringRange signature, std::size_t position,
+                                   std::size_t marker_size) {
+  return position == signature.size
+             ? fnv1a(signature.text, 0)
+             : fnv1a(signature.text + position + marker_size,
+                     signature.size - position - marker_size);
+}
+
+/**
+ * @brief Hash of the fully qualified name of a type, computed at compile-time
+ *
+ * @tparam T type to be identified (aliases are resolved)
+ *
+ * @return hash of the name
+ */
+template <class T> constexpr std::uint64_t type_hash() {
+  return hash_after(type_signature<T>(),
+                    find_marker(type_signature<T>().text, 0, type_signature<T>().size, "T = ",
+                                type_signature<T>().size),
+                    4);
+}
+
+/// Value of PluginDescriptor::magic for the current layout
+constexpr std::uint64_t plugin_descriptor_magic = 0x6d776865656c0002ull;
+
+/**
+ * @brief Identifies the C++ ABI the code including this header is compiled for
+ *
+ * Only what makes code fail to link together is part of the tag: the
+ * Itanium ABI version (`__GXX_ABI_VERSION`) changes with every GCC release,
+ * while code built by different releases links just fine.
+ *
+ * @return pointer size, dual ABI of libstdc++ and ABI version of libc++
+ */
+constexpr std::uint64_t abi_tag() {
+  return (static_cast<std::uint64_t>(sizeof(void *)) << 56)
+#if defined(_GLIBCXX_USE_CXX11_ABI)
+         | (static_cast<std::uint64_t>(_GLIBCXX_USE_CXX11_ABI) << 8)
+#endif
+#if defined(_LIBCPP_ABI_VERSION)
+         | (static_cast<std::uint64_t>(_LIBCPP_ABI_VERSION) << 40)
+#endif
+      ;
+}
+
+/**
+ * @brief Creates the descriptor of plug-ins built against an interface
+ *
+ * @param[in] interface hash of the fully qualified name of the interface
+ * @param[in] tag_type hash of the fully qualified name of the tag type of the factory
+ * @param[in] major major version of the interface
+ * @param[in] minor minor version of the interface
+ * @param[in] patch patch version of the interface
+ *
+ * @return descriptor of the plug-ins
+ */
+constexpr PluginDescriptor make_plugin_descriptor(std::uint64_t interface, std::uint64_t tag_type,
+                                                  std::uint32_t major, std::uint32_t minor,
+                                                  std::uint32_t patch) {
+  return PluginDescriptor{plugin_descriptor_magic, abi_tag(), interface, tag_type,
+                          SemanticVersion{major, minor, patch}};
+}
+
+/**
+ * @brief Registers again a product of a plug-in that stayed resident after
+ * it was unloaded
+ *
+ * Plain data pointing into the static storage of the plug-in, so that it
+ * can be kept after the plug-in is unloaded: it is used only once the same
+ * instance of the plug-in was found resident.
+ */
+struct RestoreEntry {
+  /// Registers the product, recording it in the load context of the calling thread
+  bool (*restore)(const void *);
+  /// Static data of the plug-in that describes the product
+  const void *data;
+};
+
+/**
+ * @brief State shared between the DLManager that is loading a plug-in on the
+ * current thread and the static registration of the plug-in
+ */
+struct LoadContext {
+  /// Guard that the products of the plug-in must keep alive
+  std::shared_ptr<void> lifetime;
+  /// If true, registrations are staged in LoadContext::staged instead of being applied
+  bool stage_registrations = false;
+  /// Products registered by the plug-in
+  std::vector<PluginProduct> products;
+  /// Registrations staged while the plug-in is being reloaded
+  std::vector<std::function<void()>> staged;
+  /// Undo the registrations of the plug-in, unless they were replaced in the meanwhile
+  std::vector<std::function<void()>> retire;
+  /// Register the products of the plug-in again, if it stays resident after it is unloaded
+  std::vector<RestoreEntry> restore;
+  /// Updates of the factories the plug-in registers into, published when cleared
+  std::vector<std::pair<const void *, std::shared_ptr<void>>> batches;
+  /// True once the first static initializer of the plug-in started
+  bool initialization_started = false;
+  /// Time at which the first static initializer of the plug-in started
+  std::chrono::steady_clock::time_point initialization_start;
+};
+
+/**
+ * @brief Sets the load context of the calling thread
+ *
+ * @param[in] context load context, nullptr if no plug-in is being loaded
+ *
+ * @return the load context that was previously set
+ */
+LoadContext *set_load_context(LoadContext *context);
+}
+}
+
+extern "C" {
+/**
+ * @brief Returns the load context of the calling thread
+ *
+ * Defined by the mwheel library and referenced weakly, so that plug-ins
+ * need not link against it: in a process that doesn't load them with a
+ * DLManager the reference is simply left unresolved.
+ */
+__attribute__((weak)) mwheel::implementation::LoadContext *mwheel_load_context();
+}
+
+namespace mwheel {
+namespace implementation {
+
+/**
+ * @brief Returns the load context of the calling thread
+ *
+ * @return the load context of the calling thread, nullptr if no plug-in is being loaded
+ */
+inline LoadContext *load_context() { return mwheel_load_context ? mwheel_load_context() : nullptr; }
+
+/**
+ * @brief Records in the load context of the calling thread, if any, that
+ * static initialization of a plug-in started
+ */
+inline void mark_static_initialization() {
+  auto context = load_context();
+  if (context && !context->initialization_started) {
+    context->initialization_started = true;
+    context->initialization_start = std::chrono::steady_clock::now();
+  }
+}
+
+/**
+ * @brief Node of the intrusive list of actions of a PluginUnloader
+ *
+ * Nodes are trivial types meant to live in static storage: they are
+ * zero-initialized before any code runs and never destroyed, so neither
+ * linking them nor running them depends on initialization order.
+ */
+struct UnloadNode {
+  /// Next node in the list
+  UnloadNode *next;
+  /// Runs the action stored in the node, nullptr if the node is not armed
+  void (*run)(UnloadNode &);
+  /// Destroys the action stored in the node
+  void (*dispose)(UnloadNode &);
+};
+
+/**
+ * @brief Static storage for an action of a PluginUnloader
+ *
+ * @tparam Action type of the action, callable with signature `void (void)`
+ */
+template <class Action> struct UnloadSlot {
+  /// Node linked into the unloader (must be the first member)
+  UnloadNode node;
+  /// Raw storage for the action
+  typename std::aligned_storage<sizeof(Action), std::alignment_of<Action>::value>::type storage;
+
+  /**
+   * @brief Stores an action in the slot
+   *
+   * @param[in] action action to be stored
+   *
+   * @return false if the slot already holds an action, true otherwise
+   */
+  bool arm(const Action &action) {
+    if (node.run) {
+      return false;
+    }
+    new (&storage) Action(action);
+    node.run = &UnloadSlot::run_action;
+    node.dispose = &UnloadSlot::dispose_action;
+    return true;
+  }
+
+  /// Returns the action stored in the slot (must be armed)
+  Action &action() { return *static_cast<Action *>(static_cast<void *>(&storage)); }
+
+private:
+  /// Returns the slot a node belongs to
+  static UnloadSlot &slot_of(UnloadNode &node) {
+    return *static_cast<UnloadSlot *>(static_cast<void *>(&node));
+  }
+
+  /// Implementation of UnloadNode::run
+  static void run_action(UnloadNode &node) { slot_of(node).action()(); }
+
+  /// Implementation of UnloadNode::dispose
+  static void dispose_action(UnloadNode &node) {
+    auto &slot = slot_of(node);
+    slot.action().~Action();
+    node.run = nullptr;
+    node.dispose = nullptr;
+  }
+};
+
+/**
+ * @brief Returns the slot reserved for an action
+ *
+ * @tparam Key type unique to the call site that reserves the slot
+ * @tparam Action type of the action
+ *
+ * @return the slot, zero-initialized on first use
+ */
+template <class Key, class Action> UnloadSlot<Action> &unload_slot() {
+  static UnloadSlot<Action> slot;
+  return slot;
+}
+
+/**
+ * @brief Triggers custom actions in its destructor
+ *
+ * Actions are kept in an intrusive list of nodes in static storage, so
+ * linking one into the list can't fail and doesn't depend on the order of
+ * static initialization. This is not an allocation-free path: the actions
+ * themselves may own heap memory (e.g. a PrototypeRegistration copies its
+ * tag and holds its prototype), and a DLManager that is loading the
+ * plug-in records each registration in its load context. Actions run in
+ * reverse registration order, and an action that throws doesn't prevent
+ * the others from running.
  */
 class PluginUnloader {
 public:
+  /// @brief Constant initialization: the unloader is usable before any static initializer runs
+  constexpr PluginUnloader() noexcept : m_head(nullptr) {}
+
+  PluginUnloader(const PluginUnloader &) = delete;
+  PluginUnloader &operator=(const PluginUnloader &) = delete;
+
   /**
-   * @brief Sets an action to be performed at destruction time
+   * @brief Adds an action to be performed at destruction time
    *
-   * @param[in] action custom action with signature compatible with `void (void)`
+   * @param[in] node armed node that holds the action
    *
    * @return always true
    */
-  template <class T> bool on_unload(T action) {
-    m_callback.push_back(action);
+  bool on_unload(UnloadNode &node) noexcept {
+    node.next = m_head;
+    m_head = &node;
     return true;
   }
 
@@ -141,18 +639,281 @@ public:
    * @brief The infamous destructor
    */
   ~PluginUnloader() {
-    for (const auto &x : m_callback) {
-      x();
+    while (m_head) {
+      auto node = m_head;
+      m_head = node->next;
+      try {
+        node->run(*node);
+      } catch (...) {
+        // Unloading must go on
+      }
+      node->dispose(*node);
     }
   }
 
 private:
-  /// Type of the custom callback
-  using callback_type = std::function<void(void)>;
-  /// Custom callback
-  std::vector<callback_type> m_callback;
+  /// Most recently added node
+  UnloadNode *m_head;
+};
+
+/**
+ * @brief Returns a prototype that can be stored in a factory
+ *
+ * @param[in] object shared pointer to the prototype
+ *
+ * @return the shared pointer itself
+ */
+template <class T> std::shared_ptr<T> make_prototype(std::shared_ptr<T> object) { return object; }
+
+/**
+ * @brief Returns a prototype that can be stored in a factory
+ *
+ * @param[in] object prototype
+ *
+ * @return a shared copy of the object
+ */
+template <class T> std::shared_ptr<T> make_prototype(const T &object) {
+  return std::make_shared<T>(object);
+}
+
+/**
+ * @brief Batches the updates of a factory in a load context, unless they already are
+ *
+ * @param[in,out] context load context of the calling thread
+ * @param[in] factory factory that is about to be updated
+ */
+template <class FactoryType> void batch_updates(LoadContext &context, FactoryType &factory) {
+  for (const auto &x : context.batches) {
+    if (x.first == &factory) {
+      return;
+    }
+  }
+  context.batches.emplace_back(&factory,
+                               std::make_shared<typename FactoryType::UpdateBatch>(factory));
+}
+
+/**
+ * @brief Publishes a prototype provided by a plug-in into its factory
+ *
+ * If a DLManager is loading the plug-in, the registration is recorded in its
+ * load context and, during a reload, staged so that the manager can switch
+ * all the products at once. In both cases the updates of the factory are
+ * batched, and published once the plug-in is loaded.
+ *
+ * @tparam SingletonType singleton that holds the factory
+ *
+ * @param[in] tag tag of the product
+ * @param[in] prototype prototype of the product
+ * @param[in] context load context of the calling thread (may be nullptr)
+ *
+ * @return true if the registration was successful, false otherwise
+ */
+template <class SingletonType, class TagType, class InterfaceType>
+bool publish_prototype(const TagType &tag, const std::shared_ptr<InterfaceType> &prototype,
+                       LoadContext *context) {
+  if (context && context->stage_registrations) {
+    auto lifetime = context->lifetime;
+    context->staged.push_back([tag, prototype, lifetime]() {
+      auto &factory = SingletonType::get_instance();
+      auto context = load_context();
+      if (context) {
+        batch_updates(*context, factory);
+      }
+      factory.replace_prototype(tag, prototype, lifetime);
+    });
+    return true;
+  }
+  auto &factory = SingletonType::get_instance();
+  if (!context) {
+    return factory.register_prototype(tag, prototype, nullptr);
+  }
+  batch_updates(*context, factory);
+  return factory.register_prototype(tag, prototype, context->lifetime);
+}
+
+/**
+ * @brief Records in a load context a product published by a plug-in
+ *
+ * @tparam FactoryType type of the factory
+ *
+ * @param[in,out] context load context of the plug-in
+ * @param[in] tag tag of the product
+ * @param[in] retire undoes the registration
+ * @param[in] restore registers the product again
+ */
+template <class FactoryType>
+void record_registration(LoadContext &context, const typename FactoryType::tag_type &tag,
+                         std::function<void()> retire, RestoreEntry restore) {
+  context.products.push_back(make_plugin_product<FactoryType>(tag));
+  context.retire.push_back(std::move(retire));
+  context.restore.push_back(restore);
+}
+
+/**
+ * @brief Prototype registered by a plug-in, kept in static storage until the
+ * plug-in is unmapped
+ *
+ * @tparam SingletonType singleton that holds the factory
+ */
+template <class SingletonType> struct PrototypeRegistration {
+  /// Type of the factory
+  using factory_type = typename std::decay<decltype(SingletonType::get_instance())>::type;
+
+  /// Tag of the product
+  typename factory_type::tag_type tag;
+  /// Prototype of the product
+  std::shared_ptr<typename factory_type::interface_type> prototype;
+
+  /// Unregisters only this very prototype: a newer version may have replaced it
+  void operator()() const {
+    using InterfaceType = typename factory_type::interface_type;
+    SingletonType::get_instance().unregister_prototype_if(tag,
+                                                          std::weak_ptr<InterfaceType>(prototype));
+  }
 };
+
+/**
+ * @brief Publishes again a prototype registered by a plug-in, and records it
+ * in the load context of the calling thread
+ *
+ * @tparam SingletonType singleton that holds the factory
+ *
+ * @param[in] data slot of the registration
+ *
+ * @return true if the registration was successful, false otherwise
+ */
+template <class SingletonType> bool restore_prototype(const void *data) {
+  using Registration = PrototypeRegistration<SingletonType>;
+  auto &slot = *static_cast<UnloadSlot<Registration> *>(const_cast<void *>(data));
+  const auto &registration = slot.action();
+  auto context = load_context();
+  if (!publish_prototype<SingletonType>(registration.tag, registration.prototype, context)) {
+    return false;
+  }
+  if (context) {
+    auto node = &slot.node;
+    record_registration<typename Registration::factory_type>(
+        *context, registration.tag, [node]() { node->run(*node); },
+        RestoreEntry{&restore_prototype<SingletonType>, data});
+  }
+  return true;
+}
+
+/**
+ * @brief Registers a prototype provided by a plug-in
+ *
+ * @tparam SingletonType singleton that holds the factory
+ *
+ * @param[in] tag_value tag of the product
+ * @param[in] object prototype of the product
+ * @param[in] unloader unloader of the plug-in, which will unregister the prototype
+ * @param[in] key object of a type unique to the call site (the storage of the
+ * unregistration is reserved per call site)
+ *
+ * @return true if the registration was successful, false otherwise (also if
+ * the same call site is executed twice)
+ */
+template <class SingletonType, class TagType, class ObjectType, class Key>
+bool register_plugin_prototype(const TagType &tag_value, const ObjectType &object,
+                               PluginUnloader &unloader, Key key) {
+  (void)key;
+  using Registration = PrototypeRegistration<SingletonType>;
+  using FactoryType = typename Registration::factory_type;
+  auto &slot = unload_slot<Key, Registration>();
+  if (!slot.arm(Registration{typename FactoryType::tag_type(tag_value), make_prototype(object)})) {
+    return false;
+  }
+  if (!restore_prototype<SingletonType>(&slot)) {
+    slot.node.dispose(slot.node);
+    return false;
+  }
+  return unloader.on_unload(slot.node);
+}
+
+template <class ProductType> bool restore_product(const void *data);
+
+/**
+ * @brief Imports an entry of the table of products of a plug-in
+ *
+ * Called by DLManager, with the load context of the plug-in set, for each
+ * entry added with MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY.
+ *
+ * @tparam ProductType type of the product
+ *
+ * @param[in] descriptor entry of the table
+ *
+ * @return true if the registration was successful, false otherwise
+ */
+template <class ProductType> bool import_product(const ProductDescriptor &descriptor) {
+  using SingletonType = typename ProductType::factory_type;
+  using FactoryType = typename std::decay<decltype(SingletonType::get_instance())>::type;
+  using InterfaceType = typename FactoryType::interface_type;
+  auto tag = typename FactoryType::tag_type(descriptor.tag);
+  std::shared_ptr<InterfaceType> prototype = std::make_shared<ProductType>();
+  auto context = load_context();
+  if (!publish_prototype<SingletonType>(tag, prototype, context)) {
+    return false;
+  }
+  if (context) {
+    auto registered = std::weak_ptr<InterfaceType>(prototype);
+    record_registration<FactoryType>(
+        *context, tag,
+        [tag, registered]() {
+          SingletonType::get_instance().unregister_prototype_if(tag, registered);
+        },
+        RestoreEntry{&restore_product<ProductType>, &descriptor});
+  }
+  return true;
+}
+
+/**
+ * @brief Imports again an entry of the table of products of a plug-in
+ *
+ * @tparam ProductType type of the product
+ *
+ * @param[in] data entry of the table
+ *
+ * @return true if the registration was successful, false otherwise
+ */
+template <class ProductType> bool restore_product(const void *data) {
+  return import_product<ProductType>(*static_cast<const ProductDescriptor *>(data));
+}
+}
+}
+
+#if defined(__GNUC__)
+extern "C" {
+/// First entry of the table of products, defined by the linker if the object has one
+extern const mwheel::ProductDescriptor __start_mwheel_products[]
+    __attribute__((weak, visibility("hidden")));
+/// One past the last entry of the table of products
+extern const mwheel::ProductDescriptor __stop_mwheel_products[]
+    __attribute__((weak, visibility("hidden")));
+
+/**
+ * @brief Returns the bounds of the table of products of the shared object,
+ * which DLManager looks up with MWHEEL_PRODUCT_TABLE_SYMBOL
+ *
+ * @param[out] end one past the last entry (nullptr if the object has no table)
+ *
+ * @return first entry (nullptr if the object has no table)
+ */
+__attribute__((used, visibility("default"))) inline const mwheel::ProductDescriptor *
+mwheel_product_table(const mwheel::ProductDescriptor **end) {
+  *end = __stop_mwheel_products;
+  return __start_mwheel_products;
+}
+}
+
+namespace {
+/**
+ * @brief Runs before the other static initializers of each shared object that
+ * includes this header, to let DLManager time them
+ */
+__attribute__((constructor(101))) void mwheel_mark_static_initialization() {
+  mwheel::implementation::mark_static_initialization();
 }
 }
+#endif
 
 #endif /* PLUGIN_H_20150322 */
@@ -0,0 +1,178 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file plugin_catalog.h
+ *
+ * @brief Discovery of plug-ins in a directory, backed by a persistent manifest
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 2:10 PM
+ */
+
+#ifndef PLUGIN_CATALOG_H_20261018
+#define PLUGIN_CATALOG_H_20261018
+
+#include <mwheel/dlmanager.h>
+#include <mwheel/plugin.h>
+#include <mwheel/utility.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mwheel {
+
+/**
+ * @brief Keeps track of the plug-ins found in one or more directories,
+ * and of the products each of them registers
+ *
+ * The catalog is persisted in a manifest file. When a directory is scanned
+ * again, libraries whose size and modification time (or, failing that,
+ * content hash) match the manifest are not loaded: their products are known
+ * already, so they can be loaded only when one of them is needed.
+ *
+ * @warning The catalog is not thread-safe
+ */
+class PluginCatalog {
+public:
+  /// @brief Exception thrown if the manifest can't be parsed
+  MWHEEL_RUNTIME_EXCEPTION(invalid_manifest);
+  /// @brief Exception thrown if the manifest can't be written
+  MWHEEL_RUNTIME_EXCEPTION(error_writing_manifest);
+
+  /// @brief Information stored for each plug-in
+  struct Entry {
+    /// Path of the library
+    boost::filesystem::path library;
+    /// Size of the library in bytes
+    std::uintmax_t size;
+    /// Last modification time of the library
+    std::time_t last_write_time;
+    /// Hash of the content of the library
+    std::uint64_t hash;
+    /// Products registered by the library
+    std::vector<PluginProduct> products;
+  };
+
+  /// @brief Outcome of the scan of a directory
+  struct ScanReport {
+    /// Libraries that did not change since they were recorded (not loaded)
+    std::vector<boost::filesystem::path> unchanged;
+    /// Libraries that were new or modified, and have been loaded to learn their products
+    DLManager::batch_report_type loaded;
+    /// Libraries that were recorded, but are not in the directory anymore
+    std::vector<boost::filesystem::path> removed;
+  };
+
+  /**
+   * @brief Constructs a catalog, reading the manifest if it exists
+   *
+   * @param[in] manifest_path path of the manifest
+   *
+   * @throw invalid_manifest if the manifest exists but can't be parsed
+   */
+  explicit PluginCatalog(boost::filesystem::path manifest_path);
+
+  /**
+   * @brief Scans a directory for plug-ins, updating the catalog
+   *
+   * Libraries are recognized by their extension (`.so`, possibly followed by
+   * a version). New or modified libraries are loaded through the manager to
+   * learn which products they register, and they stay loaded.
+   *
+   * @param[in] directory directory to be scanned
+   * @param[in] manager manager used to load new or modified libraries
+   * @param[in] recursive if true scans sub-directories too
+   *
+   * @return what changed with respect to the catalog
+   */
+  ScanReport scan(const boost::filesystem::path &directory, DLManager &manager,
+                  bool recursive = false);
+
+  /**
+   * @brief Writes the catalog to the manifest
+   *
+   * The manifest is replaced atomically and synchronized to disk, together
+   * with its directory, so that a crash leaves either the old or the new
+   * manifest behind, never a truncated one.
+   *
+   * @throw error_writing_manifest if the manifest can't be written
+   */
+  void save() const;
+
+  /**
+   * @brief Returns the library that registers a product
+   *
+   * @param[in] product product to be searched
+   *
+   * @return the catalog entry of the library, nullptr if no known library registers the product
+   */
+  const Entry *find_provider(const PluginProduct &product) const;
+
+  /**
+   * @brief Returns the library that registers a product in a given factory
+   *
+   * @tparam FactoryType type of the factory
+   *
+   * @param[in] tag tag of the product
+   *
+   * @return the catalog entry of the library, nullptr if no known library registers the product
+   */
+  template <class FactoryType>
+  const Entry *find_provider(const typename FactoryType::tag_type &tag) const {
+    return find_provider(make_plugin_product<FactoryType>(tag));
+  }
+
+  /**
+   * @brief Returns all the entries in the catalog
+   *
+   * @return entries in the catalog, indexed by library path
+   */
+  const std::map<boost::filesystem::path, Entry> &entries() const { return m_entries; }
+
+private:
+  /// Rebuilds the index from products to libraries
+  void rebuild_index();
+
+  /// Path of the manifest
+  boost::filesystem::path m_manifest_path;
+  /// Entries of the catalog
+  std::map<boost::filesystem::path, Entry> m_entries;
+  /// Index from (interface, tag) to library
+  std::map<std::pair<std::string, std::string>, boost::filesystem::path> m_providers;
+};
+}
+
+#endif /* PLUGIN_CATALOG_H_20261018 */
@@ -39,14 +39,19 @@
 #ifndef PROTOTYPE_FACTORY_H_20150313
 #define PROTOTYPE_FACTORY_H_20150313
 
+#include <mwheel/read_copy_update.h>
 #include <mwheel/utility.h>
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <typeinfo>
+#include <utility>
 #include <vector>
 
 namespace mwheel {
@@ -65,7 +70,25 @@ namespace mwheel {
  *
  * The action that will be taken in case the creation of a non registered type
  * is queried can be customized. The default is to throw an exception of type
- * PrototypeFactory::tag_not_registered.
+ * PrototypeFactory::tag_not_registered. Before taking that action, an optional
+ * resolver is given the chance to register the missing tag (e.g. loading the
+ * plug-in that provides it), in which case the creation is retried.
+ *
+ * All the methods are thread-safe. Lookups take no lock: the prototypes are
+ * kept in an immutable map, which registrations copy and replace (see
+ * ReadCopyUpdate). Callbacks are called without holding the internal lock.
+ * Many updates in a row (e.g. the registrations of a plug-in) can be grouped
+ * into a single copy with an UpdateBatch.
+ *
+ * @warning Prototypes are cloned within a read-side critical section: `clone`
+ * may create products from the factory, but must not register or unregister
+ * prototypes in it, not even indirectly (e.g. through a resolver that loads a
+ * plug-in)
+ *
+ * A prototype may be registered together with a lifetime guard (e.g. the
+ * handle of the shared library that contains its code). The factory only
+ * keeps a weak reference to the guard, while products returned as
+ * `std::shared_ptr` keep it alive until they are destroyed.
  *
  * @tparam InterfaceType interface type common to all the registered objects
  * @tparam TagType type of the values that will be associated with each registered object
@@ -76,11 +99,36 @@ template <class InterfaceType, class TagType,
 class PrototypeFactory {
 private:
   using StoredType = std::shared_ptr<InterfaceType>;
-  using PrototypeMap = std::map<TagType, StoredType>;
+  using LifetimeType = std::shared_ptr<void>;
+
+  /// Prototype registered under a tag
+  struct Entry {
+    /// Object that is cloned
+    StoredType prototype;
+    /// Guard that must be alive while the prototype or its clones are in use
+    std::weak_ptr<void> lifetime;
+    /// True if the prototype was registered with a lifetime guard
+    bool guarded;
+  };
+
+  using PrototypeMap = std::map<TagType, Entry>;
+  using Update = std::function<bool(PrototypeMap &)>;
+
+  /// Updates made within an UpdateBatch, not yet published
+  struct PendingUpdates {
+    /// Copy of the prototypes with the updates applied, nullptr until the first update
+    std::unique_ptr<PrototypeMap> prototypes;
+    /// Number of publications when the copy was taken
+    std::size_t generation;
+    /// Updates, in the order they were made
+    std::vector<Update> updates;
+  };
 
 public:
   /// Exception thrown by default when trying to create a type that was not registered
   MWHEEL_RUNTIME_EXCEPTION(tag_not_registered);
+  /// Type of the interface common to all the registered objects
+  using interface_type = InterfaceType;
   /// Type of the tag
   using tag_type = TagType;
   /// Type of the product
@@ -89,7 +137,57 @@ public:
   /**
    * @brief Default constructor
    */
-  PrototypeFactory() { m_on_tag_not_registered = PrototypeFactory::throw_if_tag_not_registered; }
+  PrototypeFactory()
+      : m_batch_thread(std::thread::id()), m_generation(0), m_prototype_map(new PrototypeMap()) {
+    m_on_tag_not_registered = PrototypeFactory::throw_if_tag_not_registered;
+  }
+
+  PrototypeFactory(const PrototypeFactory &) = delete;
+  PrototypeFactory &operator=(const PrototypeFactory &) = delete;
+
+  /**
+   * @brief Releases the prototypes
+   */
+  ~PrototypeFactory() { delete m_prototype_map.load(); }
+
+  /**
+   * @brief Groups the updates made by the calling thread into a single publication
+   *
+   * While the batch is open the updates of the calling thread are applied to
+   * a private copy of the prototypes, which only that thread sees. They are
+   * published together when the batch is destroyed, on top of the updates that
+   * other threads made in the meanwhile (those are not delayed). A single
+   * thread at a time can batch the updates of a factory: any other batch,
+   * including a nested one, has no effect.
+   */
+  class UpdateBatch {
+  public:
+    /**
+     * @brief Opens the batch
+     *
+     * @param[in] factory factory whose updates are batched (must outlive the batch)
+     */
+    explicit UpdateBatch(PrototypeFactory &factory)
+        : m_factory(factory), m_open(factory.open_batch()) {}
+
+    UpdateBatch(const UpdateBatch &) = delete;
+    UpdateBatch &operator=(const UpdateBatch &) = delete;
+
+    /**
+     * @brief Publishes the updates made within the batch
+     */
+    ~UpdateBatch() {
+      if (m_open) {
+        m_factory.close_batch();
+      }
+    }
+
+  private:
+    /// Factory whose updates are batched
+    PrototypeFactory &m_factory;
+    /// True if this batch is the one collecting the updates
+    bool m_open;
+  };
 
   /**
    * @brief Registers an object in the factory
@@ -115,7 +213,52 @@ public:
    */
   template <class ObjectType>
   bool register_prototype(const TagType &tag, std::shared_ptr<ObjectType> sobj) {
-    return m_prototype_map.insert(typename PrototypeMap::value_type(tag, sobj)).second;
+    return register_prototype(tag, std::move(sobj), nullptr);
+  }
+
+  /**
+   * @brief Registers an object in the factory, together with a lifetime guard
+   *
+   * @param[in] tag tag associated with the object
+   * @param[in] sobj shared pointer to the object to be registered
+   * @param[in] lifetime guard that will be kept alive by all the products cloned from the object
+   *
+   * @return true if the registration was successful, false otherwise
+   */
+  template <class ObjectType>
+  bool register_prototype(const TagType &tag, std::shared_ptr<ObjectType> sobj,
+                          const LifetimeType &lifetime) {
+    auto entry = Entry{std::move(sobj), lifetime, lifetime != nullptr};
+    return update_prototypes([tag, entry](PrototypeMap &prototypes) {
+      return prototypes.insert(typename PrototypeMap::value_type(tag, entry)).second;
+    });
+  }
+
+  /**
+   * @brief Registers an object in the factory, replacing the one previously
+   * associated with the same tag in a single step
+   *
+   * There is no window during which the tag is not registered.
+   *
+   * @param[in] tag tag associated with the object
+   * @param[in] sobj shared pointer to the object to be registered
+   * @param[in] lifetime guard that will be kept alive by all the products cloned from the object
+   *
+   * @return true if an object was replaced, false if the tag was not registered
+   */
+  template <class ObjectType>
+  bool replace_prototype(const TagType &tag, std::shared_ptr<ObjectType> sobj,
+                         const LifetimeType &lifetime = nullptr) {
+    auto entry = Entry{std::move(sobj), lifetime, lifetime != nullptr};
+    return update_prototypes([tag, entry](PrototypeMap &prototypes) {
+      auto it = prototypes.find(tag);
+      if (it == prototypes.end()) {
+        prototypes.insert(typename PrototypeMap::value_type(tag, entry));
+        return false;
+      }
+      it->second = entry;
+      return true;
+    });
   }
 
   /**
@@ -126,8 +269,10 @@ public:
    * @return true if the tag was registered in the factory, false otherwise
    */
   bool has_tag(const TagType &tag) const {
-    auto it = m_prototype_map.find(tag);
-    if (it != m_prototype_map.end()) {
+    ReadCopyUpdate::ReadGuard guard(m_rcu);
+    const auto &prototypes = visible_prototypes();
+    auto it = prototypes.find(tag);
+    if (it != prototypes.end()) {
       // If found return true
       return true;
     }
@@ -142,8 +287,11 @@ public:
    */
   std::vector<TagType> product_list() const {
     std::vector<TagType> products;
-    for (const auto &x : m_prototype_map) {
-      products.push_back(x.first);
+    {
+      ReadCopyUpdate::ReadGuard guard(m_rcu);
+      for (const auto &x : visible_prototypes()) {
+        products.push_back(x.first);
+      }
     }
     sort(products.begin(), products.end());
     return products;
@@ -157,18 +305,38 @@ public:
    * @return true if one object is removed, false otherwise
    */
   bool unregister_prototype(const TagType &tag) {
-    auto nremoved = m_prototype_map.erase(tag);
-    if (nremoved == 1) {
+    return update_prototypes(
+        [tag](PrototypeMap &prototypes) { return prototypes.erase(tag) == 1; });
+  }
+
+  /**
+   * @brief Unregister an object from the factory, only if it is still the one
+   * associated with the tag
+   *
+   * @param[in] tag tag associated with the object to be unregistered
+   * @param[in] prototype object to be unregistered
+   *
+   * @return true if one object is removed, false otherwise
+   */
+  bool unregister_prototype_if(const TagType &tag, const std::weak_ptr<InterfaceType> &prototype) {
+    return update_prototypes([tag, prototype](PrototypeMap &prototypes) {
+      auto it = prototypes.find(tag);
+      if (it == prototypes.end() || it->second.prototype.owner_before(prototype) ||
+          prototype.owner_before(it->second.prototype)) {
+        return false;
+      }
+      prototypes.erase(it);
       return true;
-    }
-    return false;
+    });
   }
 
   /**
    * @brief Creates an object based on a requested tag
    *
-   * If the tag was not registered a call to a customizable function is made.
-   * The default behavior is to throw an exception of type PrototypeFactory::tag_not_registered.
+   * If the tag was not registered the resolver, if any, is called and the lookup
+   * is retried once if it succeeds. If the tag is still missing a call to a
+   * customizable function is made. The default behavior is to throw an exception
+   * of type PrototypeFactory::tag_not_registered.
    *
    * @param[in] tag tag associated with the object to be created
    * @param[in] parameters parameters needed for the creation
@@ -177,11 +345,41 @@ public:
    */
   template <class... ParameterTypes>
   product_type create(const TagType &tag, ParameterTypes... parameters) {
-    auto iterator = m_prototype_map.find(tag);
-    if (iterator == m_prototype_map.end()) {
-      return m_on_tag_not_registered(tag);
+    LifetimeType lifetime;
+    {
+      ReadCopyUpdate::ReadGuard guard(m_rcu);
+      auto prototype = find_prototype(tag, lifetime);
+      if (prototype) {
+        return attach_lifetime(prototype->clone(parameters...), std::move(lifetime));
+      }
+    }
+    // Only a miss takes the lock
+    auto resolver = get_locked(m_tag_resolver);
+    if (resolver && resolver(tag)) {
+      ReadCopyUpdate::ReadGuard guard(m_rcu);
+      auto prototype = find_prototype(tag, lifetime);
+      if (prototype) {
+        return attach_lifetime(prototype->clone(parameters...), std::move(lifetime));
+      }
     }
-    return iterator->second->clone(parameters...);
+    return get_locked(m_on_tag_not_registered)(tag);
+  }
+
+  /**
+   * @brief Sets the resolver that is called when a tag was not found during creation
+   *
+   * The resolver must be a callable object of whatever type which:
+   * - takes as the only parameter the tag that was not found
+   * - returns true if the tag may have been registered in the meanwhile, false otherwise
+   *
+   * If the resolver returns true the creation is retried. Setting an empty
+   * resolver disables this step.
+   *
+   * @param[in] resolver generic function to be called
+   */
+  template <class U> void set_tag_resolver(U resolver) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tag_resolver = resolver;
   }
 
   /**
@@ -194,7 +392,10 @@ public:
    *
    * @param[in] action generic function to be called
    */
-  template <class U> void on_tag_not_registered(U action) { m_on_tag_not_registered = action; }
+  template <class U> void on_tag_not_registered(U action) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_on_tag_not_registered = action;
+  }
 
   /**
    * @brief Default behavior for the action to be performed when a tag
@@ -216,10 +417,185 @@ public:
   }
 
 private:
+  /**
+   * @brief Returns the prototype registered under a tag
+   *
+   * Must be called within a read-side critical section of m_rcu, which keeps
+   * the prototype alive.
+   *
+   * @param[in] tag tag to be searched
+   * @param[out] lifetime lifetime guard of the prototype, if any
+   *
+   * @return the prototype, or nullptr if the tag was not registered or its guard expired
+   */
+  InterfaceType *find_prototype(const TagType &tag, LifetimeType &lifetime) const {
+    const auto &prototypes = visible_prototypes();
+    auto iterator = prototypes.find(tag);
+    if (iterator == prototypes.end()) {
+      return nullptr;
+    }
+    if (iterator->second.guarded) {
+      // Lock the guard before cloning, so that it can't expire meanwhile
+      lifetime = iterator->second.lifetime.lock();
+      if (!lifetime) {
+        return nullptr;
+      }
+    }
+    return iterator->second.prototype.get();
+  }
+
+  /**
+   * @brief Returns the prototypes seen by the calling thread
+   *
+   * Must be called within a read-side critical section of m_rcu.
+   *
+   * @return the updates batched by the calling thread if any, the published
+   * prototypes otherwise
+   */
+  const PrototypeMap &visible_prototypes() const {
+    // Only the thread that opened the batch can close it
+    if (m_batch_thread.load() == std::this_thread::get_id() && m_batch->prototypes) {
+      return *m_batch->prototypes;
+    }
+    return *m_prototype_map.load();
+  }
+
+  /**
+   * @brief Replaces the prototypes with an updated copy
+   *
+   * The replaced prototypes are released once no reader can access them
+   * anymore, without holding the internal lock. Within an UpdateBatch the
+   * copy is taken once, and published when the batch is closed.
+   *
+   * @param[in] update function that modifies the copy, and returns the outcome
+   *
+   * @return the value returned by `update`
+   */
+  bool update_prototypes(Update update) {
+    if (m_batch_thread.load() == std::this_thread::get_id()) {
+      auto &batch = *m_batch;
+      if (!batch.prototypes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        batch.prototypes.reset(new PrototypeMap(*m_prototype_map.load()));
+        batch.generation = m_generation;
+      }
+      batch.updates.push_back(update);
+      return update(*batch.prototypes);
+    }
+    std::unique_ptr<const PrototypeMap> replaced;
+    bool outcome;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      std::unique_ptr<PrototypeMap> prototypes(new PrototypeMap(*m_prototype_map.load()));
+      outcome = update(*prototypes);
+      replaced.reset(m_prototype_map.exchange(prototypes.release()));
+      ++m_generation;
+    }
+    m_rcu.synchronize();
+    return outcome;
+  }
+
+  /**
+   * @brief Starts batching the updates of the calling thread
+   *
+   * @return false if another batch is already open, true otherwise
+   */
+  bool open_batch() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_batch) {
+      return false;
+    }
+    m_batch.reset(new PendingUpdates());
+    m_batch_thread = std::this_thread::get_id();
+    return true;
+  }
+
+  /**
+   * @brief Publishes the updates batched by the calling thread
+   *
+   * If other threads published updates after the copy was taken, the batched
+   * updates are applied again on top of them.
+   */
+  void close_batch() {
+    std::unique_ptr<PendingUpdates> batch;
+    std::unique_ptr<const PrototypeMap> replaced;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      batch = std::move(m_batch);
+      m_batch_thread = std::thread::id();
+      if (!batch->prototypes) {
+        return;
+      }
+      if (batch->generation != m_generation) {
+        batch->prototypes.reset(new PrototypeMap(*m_prototype_map.load()));
+        for (const auto &x : batch->updates) {
+          x(*batch->prototypes);
+        }
+      }
+      replaced.reset(m_prototype_map.exchange(batch->prototypes.release()));
+      ++m_generation;
+    }
+    m_rcu.synchronize();
+  }
+
+  /**
+   * @brief Makes a product keep a lifetime guard alive
+   *
+   * The guard is released after the product is destroyed.
+   *
+   * @param[in] product product returned by `clone`
+   * @param[in] lifetime lifetime guard (may be nullptr)
+   *
+   * @return a pointer that shares the ownership of both the product and the guard
+   */
+  template <class T>
+  static std::shared_ptr<T> attach_lifetime(std::shared_ptr<T> product, LifetimeType lifetime) {
+    if (!product || !lifetime) {
+      return product;
+    }
+    // Members of std::pair are destroyed in reverse order: the product goes first
+    auto holder = std::make_shared<std::pair<LifetimeType, std::shared_ptr<T>>>(
+        std::move(lifetime), std::move(product));
+    return std::shared_ptr<T>(holder, holder->second.get());
+  }
+
+  /**
+   * @brief Products that are not shared pointers can't keep a lifetime guard alive
+   *
+   * @param[in] product product returned by `clone`
+   *
+   * @return the product
+   */
+  template <class T> static T attach_lifetime(T product, const LifetimeType &) { return product; }
+
+  /**
+   * @brief Returns a copy of a member, taken under the lock
+   *
+   * @param[in] member member to be copied
+   *
+   * @return copy of the member
+   */
+  template <class T> T get_locked(const T &member) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return member;
+  }
+
+  /// Serializes the updates of the prototypes, protects the callbacks
+  mutable std::mutex m_mutex;
+  /// Lets lookups run while the prototypes are replaced
+  mutable ReadCopyUpdate m_rcu;
   /// Generalized function to be called when a tag is not found during creation
   std::function<product_type(const TagType &)> m_on_tag_not_registered;
-  /// Map that stores tag,object pairs
-  PrototypeMap m_prototype_map;
+  /// Generalized function that may register a tag not found during creation
+  std::function<bool(const TagType &)> m_tag_resolver;
+  /// Updates batched by m_batch_thread (opened and closed under m_mutex)
+  std::unique_ptr<PendingUpdates> m_batch;
+  /// Thread whose updates are batched, if any
+  std::atomic<std::thread::id> m_batch_thread;
+  /// Number of publications of the prototypes (protected by m_mutex)
+  std::size_t m_generation;
+  /// Map that stores tag,object pairs (copy-on-write, read within m_rcu)
+  std::atomic<const PrototypeMap *> m_prototype_map;
 };
 }
 
@@ -0,0 +1,118 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file read_copy_update.h
+ *
+ * @brief Lets readers access data replaced by writers without taking any lock
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 9:10 PM
+ */
+
+#ifndef READ_COPY_UPDATE_H_20261018
+#define READ_COPY_UPDATE_H_20261018
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+namespace mwheel {
+
+/**
+ * @brief Minimal read-copy-update scheme, which lets readers access data
+ * replaced by writers without taking any lock
+ *
+ * Readers announce themselves by incrementing the counter of the current
+ * epoch, which is wait-free. A writer publishes the new version of the
+ * data, then calls synchronize() before destroying the old one: the epoch
+ * is flipped twice, each time waiting for the readers of the previous one
+ * to leave.
+ *
+ * @warning A reader must not call synchronize() on the same domain, which
+ * would wait for the reader itself
+ */
+class ReadCopyUpdate {
+public:
+  /// @brief Read-side critical section, during which published data can't be destroyed
+  class ReadGuard {
+  public:
+    explicit ReadGuard(ReadCopyUpdate &domain)
+        : m_readers(domain.m_readers[domain.m_epoch.load() & 1]) {
+      ++m_readers;
+    }
+
+    ReadGuard(const ReadGuard &) = delete;
+    ReadGuard &operator=(const ReadGuard &) = delete;
+
+    ~ReadGuard() { --m_readers; }
+
+  private:
+    /// Counter incremented when the critical section was entered
+    std::atomic<std::size_t> &m_readers;
+  };
+
+  /**
+   * @brief Creates a domain with no reader
+   */
+  ReadCopyUpdate() : m_epoch(0) {
+    m_readers[0] = 0;
+    m_readers[1] = 0;
+  }
+
+  ReadCopyUpdate(const ReadCopyUpdate &) = delete;
+  ReadCopyUpdate &operator=(const ReadCopyUpdate &) = delete;
+
+  /**
+   * @brief Waits until no reader can still access data unpublished before the call
+   */
+  void synchronize() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Readers that entered before the first flip may have read the old data,
+    // and may have entered in either epoch
+    for (auto ii = 0; ii < 2; ++ii) {
+      auto previous = m_epoch++;
+      while (m_readers[previous & 1].load() != 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+private:
+  /// Current epoch
+  std::atomic<unsigned> m_epoch;
+  /// Readers in a critical section, by parity of the epoch they entered in
+  std::atomic<std::size_t> m_readers[2];
+  /// Serializes the writers
+  std::mutex m_mutex;
+};
+}
+
+#endif /* READ_COPY_UPDATE_H_20261018 */
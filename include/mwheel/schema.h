@@ -0,0 +1,598 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file schema.h
+ *
+ * @brief Declares the fields of a SerializableObject once, and derives
+ * from them a binary layout that can be read in place
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 11:20 PM
+ */
+
+#ifndef SCHEMA_H_20261018
+#define SCHEMA_H_20261018
+
+#include <mwheel/byte_stream.h>
+#include <mwheel/serializable_object.h>
+#include <mwheel/utility.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief Must be used in the public part of a class derived from
+ * SerializableObject, after the fields it lists
+ *
+ * Generates:
+ * - the overrides of `do_serialize(ByteSink&)` and `do_deserialize(ByteSource&)`,
+ *   which write and read the layout described in mwheel::schema::View
+ * - a nested class `view_type`, with one accessor per field that reads it
+ *   straight from a buffer (e.g. a MappedFile), without parsing or copying
+ * - `static view_type view(const char *data, std::size_t size)`
+ *
+ * Fields may be arithmetic types, enumerations, `std::string` and
+ * `std::vector` of arithmetic types (except `bool`) or enumerations. At
+ * most 16 fields can be listed, and they can't be named like the members
+ * of the view (`data`, `size`, `read`, `get`).
+ *
+ * @code
+ * class Particle : public mwheel::SerializableObject {
+ * public:
+ *   std::int32_t id;
+ *   double mass;
+ *   std::vector<double> trajectory;
+ *   MWHEEL_SCHEMA(Particle, id, mass, trajectory);
+ * };
+ *
+ * auto particle = Particle::view(file.data(), file.size());
+ * auto mass = particle.mass();
+ * auto last = particle.trajectory()[particle.trajectory().size() - 1];
+ * @endcode
+ */
+#define MWHEEL_SCHEMA(Type, ...)                                                                   \
+  using schema_fields = ::mwheel::schema::Fields<void MWHEEL_SCHEMA_FOR_EACH(                      \
+      MWHEEL_SCHEMA_FIELD_TYPE, Type, __VA_ARGS__)>::type;                                         \
+  class view_type : public ::mwheel::schema::View<schema_fields> {                                 \
+  public:                                                                                          \
+    view_type(const char *data, std::size_t size)                                                  \
+        : ::mwheel::schema::View<schema_fields>(data, size) {}                                     \
+    MWHEEL_SCHEMA_FOR_EACH(MWHEEL_SCHEMA_ACCESSOR, Type, __VA_ARGS__)                              \
+  };                                                                                               \
+  static view_type view(const char *data, std::size_t size) { return view_type(data, size); }      \
+protected:                                                                                         \
+  void do_serialize(::mwheel::ByteSink &sink) const override {                                     \
+    ::mwheel::schema::Writer<schema_fields> writer;                                                \
+    MWHEEL_SCHEMA_FOR_EACH(MWHEEL_SCHEMA_WRITE, Type, __VA_ARGS__)                                 \
+    writer.flush(sink);                                                                            \
+  }                                                                                                \
+  void do_deserialize(::mwheel::ByteSource &source) override {                                     \
+    auto buffer = ::mwheel::schema::read_all(source);                                              \
+    view_type view(buffer.data(), buffer.size());                                                  \
+    MWHEEL_SCHEMA_FOR_EACH(MWHEEL_SCHEMA_READ, Type, __VA_ARGS__)                                  \
+  }                                                                                                \
+public:                                                                                            \
+  static_assert(std::tuple_size<schema_fields>::value > 0, "a schema needs at least a field")
+
+/// Helper of MWHEEL_SCHEMA (type of a field, preceded by a comma)
+#define MWHEEL_SCHEMA_FIELD_TYPE(T, I, x) , decltype(T::x)
+
+/// Helper of MWHEEL_SCHEMA (accessor of a field in the view)
+#define MWHEEL_SCHEMA_ACCESSOR(T, I, x)                                                            \
+  ::mwheel::schema::Field<decltype(T::x)>::view_type x() const { return get<(I)>(); }
+
+/// Helper of MWHEEL_SCHEMA (writes a field)
+#define MWHEEL_SCHEMA_WRITE(T, I, x) writer.write<(I)>(x);
+
+/// Helper of MWHEEL_SCHEMA (reads a field back from the view)
+#define MWHEEL_SCHEMA_READ(T, I, x) view.read<(I)>(x);
+
+/// Helper of MWHEEL_SCHEMA (calls a macro on each field, with its index)
+#define MWHEEL_SCHEMA_FOR_EACH(M, T, ...)                                                          \
+  MWHEEL_SCHEMA_CONCAT(MWHEEL_SCHEMA_FOR_EACH_, MWHEEL_SCHEMA_NARGS(__VA_ARGS__))                  \
+  (M, T, 0, __VA_ARGS__)
+
+/// Helper of MWHEEL_SCHEMA (concatenates after expansion)
+#define MWHEEL_SCHEMA_CONCAT(a, b) MWHEEL_SCHEMA_CONCAT_EXPANDED(a, b)
+/// Helper of MWHEEL_SCHEMA (concatenates)
+#define MWHEEL_SCHEMA_CONCAT_EXPANDED(a, b) a##b
+
+/// Helper of MWHEEL_SCHEMA (counts the fields)
+#define MWHEEL_SCHEMA_NARGS(...)                                                                   \
+  MWHEEL_SCHEMA_NARGS_SELECT(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+/// Helper of MWHEEL_SCHEMA (selects the count)
+#define MWHEEL_SCHEMA_NARGS_SELECT(_1, _2, _3, _4, _5, _6, _7, _8,                                 \
+                                   _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+
+/// @cond
+#define MWHEEL_SCHEMA_FOR_EACH_1(M, T, I, x) M(T, I, x)
+#define MWHEEL_SCHEMA_FOR_EACH_2(M, T, I, x, ...)                                                  \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_1(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_3(M, T, I, x, ...)                                                  \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_2(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_4(M, T, I, x, ...)                                                  \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_3(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_5(M, T, I, x, ...)                                                  \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_4(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_6(M, T, I, x, ...)                                                  \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_5(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_7(M, T, I, x, ...)                                                  \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_6(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_8(M, T, I, x, ...)                                                  \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_7(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_9(M, T, I, x, ...)                                                  \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_8(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_10(M, T, I, x, ...)                                                 \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_9(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_11(M, T, I, x, ...)                                                 \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_10(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_12(M, T, I, x, ...)                                                 \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_11(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_13(M, T, I, x, ...)                                                 \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_12(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_14(M, T, I, x, ...)                                                 \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_13(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_15(M, T, I, x, ...)                                                 \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_14(M, T, I + 1, __VA_ARGS__)
+#define MWHEEL_SCHEMA_FOR_EACH_16(M, T, I, x, ...)                                                 \
+  M(T, I, x) MWHEEL_SCHEMA_FOR_EACH_15(M, T, I + 1, __VA_ARGS__)
+/// @endcond
+
+namespace mwheel {
+
+namespace schema {
+
+/// @brief Exception thrown if a buffer doesn't hold the layout of a schema
+MWHEEL_RUNTIME_EXCEPTION(invalid_layout);
+
+/// Size of the header of a layout
+constexpr std::size_t header_size() { return 8; }
+
+/// Rounds a value up to a multiple of an alignment
+constexpr std::size_t align_up(std::size_t value, std::size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @brief Stores a value in little-endian order
+ */
+template <class T> void store(char *destination, T value) {
+  static_assert(std::is_arithmetic<T>::value, "only arithmetic values can be stored");
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  std::reverse_copy(bytes, bytes + sizeof(T), destination);
+#else
+  std::memcpy(destination, &value, sizeof(T));
+#endif
+}
+
+/**
+ * @brief Loads a value stored in little-endian order
+ */
+template <class T> T load(const char *source) {
+  static_assert(std::is_arithmetic<T>::value, "only arithmetic values can be loaded");
+  T value;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  char bytes[sizeof(T)];
+  std::reverse_copy(source, source + sizeof(T), bytes);
+  std::memcpy(&value, bytes, sizeof(T));
+#else
+  std::memcpy(&value, source, sizeof(T));
+#endif
+  return value;
+}
+
+/**
+ * @brief Type used to store a scalar (bool as a byte, enumerations as their underlying type)
+ */
+template <class T, class Enable = void> struct Storage { using type = T; };
+
+template <class T> struct Storage<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+  using type = typename std::underlying_type<T>::type;
+};
+
+template <> struct Storage<bool> { using type = std::uint8_t; };
+
+/**
+ * @brief Read-only view of an array of scalars stored in a buffer
+ */
+template <class T> class ArrayView {
+public:
+  ArrayView(const char *data, std::size_t size) : m_data(data), m_size(size) {}
+
+  /**
+   * @brief Returns the number of elements
+   */
+  std::size_t size() const { return m_size; }
+
+  /**
+   * @brief Returns an element
+   */
+  T operator[](std::size_t index) const {
+    return static_cast<T>(load<typename Storage<T>::type>(m_data + index * sizeof(T)));
+  }
+
+  /**
+   * @brief Returns the elements in place
+   *
+   * @warning Valid on little-endian machines only, and aligned only if
+   * the buffer of the view is aligned to 8 bytes
+   */
+  const T *data() const { return reinterpret_cast<const T *>(m_data); }
+
+  /**
+   * @brief Copies the elements
+   */
+  std::vector<T> to_vector() const {
+    std::vector<T> values(m_size);
+    for (std::size_t ii = 0; ii < m_size; ++ii) {
+      values[ii] = (*this)[ii];
+    }
+    return values;
+  }
+
+private:
+  /// First byte of the elements
+  const char *m_data;
+  /// Number of elements
+  std::size_t m_size;
+};
+
+/**
+ * @brief Read-only view of a string stored in a buffer
+ */
+class StringView {
+public:
+  StringView(const char *data, std::size_t size) : m_data(data), m_size(size) {}
+
+  /**
+   * @brief Returns the characters in place (not null-terminated)
+   */
+  const char *data() const { return m_data; }
+
+  /**
+   * @brief Returns the number of characters
+   */
+  std::size_t size() const { return m_size; }
+
+  /**
+   * @brief Copies the characters
+   */
+  std::string str() const { return std::string(m_data, m_size); }
+
+  bool operator==(const std::string &other) const {
+    return other.size() == m_size && std::memcmp(other.data(), m_data, m_size) == 0;
+  }
+
+  bool operator!=(const std::string &other) const { return !(*this == other); }
+
+private:
+  /// First character
+  const char *m_data;
+  /// Number of characters
+  std::size_t m_size;
+};
+
+/**
+ * @brief How a field is laid out, written and read
+ *
+ * Scalars are stored in their slot; strings and vectors store in their
+ * slot the offset and the number of elements of an array that follows
+ * the slots, aligned to 8 bytes.
+ */
+template <class T, class Enable = void> struct Field;
+
+/// @brief Layout of a scalar
+template <class T>
+struct Field<T, typename std::enable_if<std::is_arithmetic<T>::value ||
+                                        std::is_enum<T>::value>::type> {
+  using view_type = T;
+  using storage_type = typename Storage<T>::type;
+
+  static constexpr std::size_t size() { return sizeof(storage_type); }
+  static constexpr std::size_t alignment() { return sizeof(storage_type); }
+
+  static void write(const T &value, char *slot, std::vector<char> &, std::size_t) {
+    store<storage_type>(slot, static_cast<storage_type>(value));
+  }
+
+  static bool valid(const char *, std::size_t, const char *) { return true; }
+
+  static view_type view(const char *, const char *slot) {
+    return static_cast<T>(load<storage_type>(slot));
+  }
+
+  static void read(T &value, const char *data, const char *slot) { value = view(data, slot); }
+};
+
+/**
+ * @brief Layout of a contiguous sequence of scalars
+ *
+ * @tparam T type of the elements
+ * @tparam View type of the view of the sequence
+ */
+template <class T, class View> struct SequenceField {
+  using view_type = View;
+  using storage_type = typename Storage<T>::type;
+
+  static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                "sequences of non-scalar types are not supported");
+
+  static constexpr std::size_t size() { return 16; }
+  static constexpr std::size_t alignment() { return 8; }
+
+  template <class Sequence>
+  static void write(const Sequence &value, char *slot, std::vector<char> &tail, std::size_t base) {
+    tail.resize(align_up(tail.size(), 8));
+    store<std::uint64_t>(slot, base + tail.size());
+    store<std::uint64_t>(slot + 8, value.size());
+    auto position = tail.size();
+    tail.resize(position + value.size() * sizeof(storage_type));
+    for (const auto &x : value) {
+      store<storage_type>(&tail[position], static_cast<storage_type>(x));
+      position += sizeof(storage_type);
+    }
+  }
+
+  static bool valid(const char *, std::size_t size, const char *slot) {
+    auto offset = load<std::uint64_t>(slot);
+    auto count = load<std::uint64_t>(slot + 8);
+    return offset % 8 == 0 && offset <= size && count <= (size - offset) / sizeof(storage_type);
+  }
+
+  static view_type view(const char *data, const char *slot) {
+    return view_type(data + load<std::uint64_t>(slot),
+                     static_cast<std::size_t>(load<std::uint64_t>(slot + 8)));
+  }
+};
+
+/// @brief Layout of a string
+template <> struct Field<std::string> : SequenceField<char, StringView> {
+  static void read(std::string &value, const char *data, const char *slot) {
+    value = view(data, slot).str();
+  }
+};
+
+/// @brief Layout of a vector of scalars
+template <class T, class Allocator>
+struct Field<std::vector<T, Allocator>> : SequenceField<T, ArrayView<T>> {
+  static_assert(!std::is_same<T, bool>::value, "std::vector<bool> is not supported");
+
+  static void read(std::vector<T, Allocator> &value, const char *data, const char *slot) {
+    auto array = SequenceField<T, ArrayView<T>>::view(data, slot);
+    value.resize(array.size());
+    for (std::size_t ii = 0; ii < array.size(); ++ii) {
+      value[ii] = array[ii];
+    }
+  }
+};
+
+/**
+ * @brief Turns `void, T1, T2, ...` into `std::tuple<T1, T2, ...>`
+ */
+template <class... T> struct Fields;
+
+template <class... T> struct Fields<void, T...> {
+  using type = std::tuple<typename std::remove_cv<T>::type...>;
+};
+
+/**
+ * @brief Offset of the slot of a field
+ */
+template <std::size_t I, class Tuple> struct Offset {
+  using previous = typename std::tuple_element<I - 1, Tuple>::type;
+  using current = typename std::tuple_element<I, Tuple>::type;
+
+  static constexpr std::size_t value() {
+    return align_up(Offset<I - 1, Tuple>::value() + Field<previous>::size(),
+                    Field<current>::alignment());
+  }
+};
+
+template <class Tuple> struct Offset<0, Tuple> {
+  using current = typename std::tuple_element<0, Tuple>::type;
+
+  static constexpr std::size_t value() {
+    return align_up(header_size(), Field<current>::alignment());
+  }
+};
+
+/**
+ * @brief Size of the slots, header included
+ */
+template <class Tuple> constexpr std::size_t fixed_size() {
+  return align_up(Offset<std::tuple_size<Tuple>::value - 1, Tuple>::value() +
+                      Field<typename std::tuple_element<std::tuple_size<Tuple>::value - 1,
+                                                        Tuple>::type>::size(),
+                  8);
+}
+
+/**
+ * @brief Checks the slots of the first I fields
+ */
+template <std::size_t I, class Tuple> struct Validate {
+  static bool valid(const char *data, std::size_t size) {
+    using field = Field<typename std::tuple_element<I - 1, Tuple>::type>;
+    return Validate<I - 1, Tuple>::valid(data, size) &&
+           field::valid(data, size, data + Offset<I - 1, Tuple>::value());
+  }
+};
+
+template <class Tuple> struct Validate<0, Tuple> {
+  static bool valid(const char *, std::size_t) { return true; }
+};
+
+/**
+ * @brief Read-only view of the layout of a schema, stored in a buffer
+ *
+ * The layout starts with a header (size of the slots and number of
+ * fields, 32 bits each), followed by one slot per field in the order
+ * they are declared, each aligned to its size, and then by the arrays of
+ * the strings and vectors, each aligned to 8 bytes. All the values are
+ * little-endian. Creating a view checks the header and the bounds of the
+ * arrays; fields are read only when they are accessed.
+ *
+ * @tparam Tuple types of the fields
+ */
+template <class Tuple> class View {
+public:
+  /**
+   * @brief Creates a view of a buffer (which is not copied)
+   *
+   * @param[in] data first byte of the layout (aligned to 8 bytes for ArrayView::data)
+   * @param[in] size number of bytes of the layout
+   *
+   * @throw invalid_layout if the buffer doesn't hold the layout of the schema
+   */
+  View(const char *data, std::size_t size) : m_data(data), m_size(size) {
+    if (size < fixed_size<Tuple>() || load<std::uint32_t>(data) != fixed_size<Tuple>() ||
+        load<std::uint32_t>(data + 4) != std::tuple_size<Tuple>::value ||
+        !Validate<std::tuple_size<Tuple>::value, Tuple>::valid(data, size)) {
+      throw invalid_layout("ERROR : the buffer doesn't hold the layout of the schema\n");
+    }
+  }
+
+  /**
+   * @brief Returns the first byte of the layout
+   */
+  const char *data() const { return m_data; }
+
+  /**
+   * @brief Returns the number of bytes of the layout
+   */
+  std::size_t size() const { return m_size; }
+
+  /**
+   * @brief Copies a field out of the buffer
+   *
+   * @tparam I index of the field
+   *
+   * @param[out] value where the field is copied
+   */
+  template <std::size_t I, class T> void read(T &value) const {
+    Field<typename std::tuple_element<I, Tuple>::type>::read(value, m_data, slot<I>());
+  }
+
+protected:
+  /**
+   * @brief Returns the view of a field
+   *
+   * @tparam I index of the field
+   */
+  template <std::size_t I>
+  typename Field<typename std::tuple_element<I, Tuple>::type>::view_type get() const {
+    return Field<typename std::tuple_element<I, Tuple>::type>::view(m_data, slot<I>());
+  }
+
+private:
+  /**
+   * @brief Returns the slot of a field
+   */
+  template <std::size_t I> const char *slot() const { return m_data + Offset<I, Tuple>::value(); }
+
+  /// First byte of the layout
+  const char *m_data;
+  /// Number of bytes of the layout
+  std::size_t m_size;
+};
+
+/**
+ * @brief Writes the layout of a schema
+ *
+ * @tparam Tuple types of the fields
+ */
+template <class Tuple> class Writer {
+public:
+  Writer() : m_slots(fixed_size<Tuple>(), 0) {
+    store<std::uint32_t>(m_slots.data(), fixed_size<Tuple>());
+    store<std::uint32_t>(m_slots.data() + 4, std::tuple_size<Tuple>::value);
+  }
+
+  /**
+   * @brief Writes a field
+   *
+   * @tparam I index of the field
+   *
+   * @param[in] value value of the field
+   */
+  template <std::size_t I, class T> void write(const T &value) {
+    Field<typename std::tuple_element<I, Tuple>::type>::write(
+        value, m_slots.data() + Offset<I, Tuple>::value(), m_tail, m_slots.size());
+  }
+
+  /**
+   * @brief Writes the layout to a sink
+   *
+   * @param[in,out] sink where the layout is appended
+   */
+  void flush(ByteSink &sink) const {
+    ConstBuffer buffers[] = {{m_slots.data(), m_slots.size()}, {m_tail.data(), m_tail.size()}};
+    sink.write(buffers, 2);
+  }
+
+private:
+  /// Header and slots
+  std::vector<char> m_slots;
+  /// Arrays of the strings and vectors
+  std::vector<char> m_tail;
+};
+
+/**
+ * @brief Reads a source until its end
+ *
+ * @param[in,out] source source to be read
+ *
+ * @return bytes of the source
+ */
+inline std::vector<char> read_all(ByteSource &source) {
+  std::vector<char> buffer;
+  for (std::size_t size = 0;;) {
+    if (size == buffer.size()) {
+      buffer.resize(std::max<std::size_t>(2 * size, 4096));
+    }
+    auto n = source.read_some(buffer.data() + size, buffer.size() - size);
+    if (n == 0) {
+      buffer.resize(size);
+      return buffer;
+    }
+    size += n;
+  }
+}
+}
+}
+
+#endif /* SCHEMA_H_20261018 */
@@ -39,12 +39,28 @@
 #ifndef SERIALIZABLE_OBJECT_H_20150402
 #define SERIALIZABLE_OBJECT_H_20150402
 
+#include <mwheel/utility.h>
+
 #include <boost/filesystem.hpp>
 
+#include <cstddef>
+#include <iosfwd>
+
 namespace mwheel {
 
+class ByteSink;
+class ByteSource;
+class MappedFile;
+
 /**
  * @brief Serializes object to disk and de-serializes from disk
+ *
+ * The public functions are not virtual: they forward to the protected
+ * `do_*` ones, so that implementations can override any of those without
+ * hiding the others. Implementations override the sink/source based
+ * versions, which don't need a file system and are used by all the others.
+ * Classes that can only work with files derive from PathSerializable
+ * instead.
  */
 class SerializableObject {
 public:
@@ -53,19 +69,148 @@ public:
    *
    * @param[in] path name of the file where to serialize object state
    */
-  virtual void serialize(const boost::filesystem::path &path) const = 0;
+  void serialize(const boost::filesystem::path &path) const;
 
   /**
    * @brief De-serializes the state of an object
    *
    * @param[in] path name of the file where the state is stored
    */
-  virtual void deserialize(const boost::filesystem::path &path) = 0;
+  void deserialize(const boost::filesystem::path &path);
+
+  /**
+   * @brief Serializes the state of an object into a sink of bytes
+   *
+   * @param[in,out] sink where the state is appended
+   */
+  void serialize(ByteSink &sink) const;
+
+  /**
+   * @brief De-serializes the state of an object from a source of bytes
+   *
+   * The state is everything until the end of the source.
+   *
+   * @param[in,out] source where the state is read
+   */
+  void deserialize(ByteSource &source);
+
+  /**
+   * @brief Serializes the state of an object into a binary stream
+   *
+   * @param[in,out] stream binary stream where the state is appended
+   */
+  void serialize(std::ostream &stream) const;
+
+  /**
+   * @brief De-serializes the state of an object from a binary stream
+   *
+   * @param[in,out] stream binary stream positioned at the beginning of the state
+   * @param[in] size number of bytes of the state
+   */
+  void deserialize(std::istream &stream, std::size_t size);
+
+  /**
+   * @brief Replaces a file with the state of an object, atomically
+   *
+   * The state is written through the sink-based version to a temporary
+   * file, which is synchronized with the disk and renamed over the
+   * target (see AtomicFileSink).
+   *
+   * @param[in] path name of the file where to serialize object state
+   */
+  void serialize_atomically(const boost::filesystem::path &path) const;
+
+  /**
+   * @brief De-serializes the state of an object from a file mapped in memory
+   *
+   * The mapping is read-only and starts at a page boundary: implementations
+   * may parse it in place, and keep references into it that stay valid as
+   * long as the caller keeps the mapping.
+   *
+   * @param[in] file file where the state is stored
+   */
+  void deserialize(const MappedFile &file);
 
   /**
    * @brief The infamous virtual destructor
    */
   virtual ~SerializableObject();
+
+protected:
+  /**
+   * @brief Serializes the state of an object into a sink of bytes
+   *
+   * @param[in,out] sink where the state is appended
+   */
+  virtual void do_serialize(ByteSink &sink) const = 0;
+
+  /**
+   * @brief De-serializes the state of an object from a source of bytes
+   *
+   * @param[in,out] source where the state is read, until its end
+   */
+  virtual void do_deserialize(ByteSource &source) = 0;
+
+  /**
+   * @brief Serializes the state of an object into a file
+   *
+   * The default writes the file through do_serialize(ByteSink&).
+   *
+   * @param[in] path name of the file where to serialize object state
+   */
+  virtual void do_serialize_file(const boost::filesystem::path &path) const;
+
+  /**
+   * @brief De-serializes the state of an object from a file
+   *
+   * The default reads the file through do_deserialize(ByteSource&).
+   *
+   * @param[in] path name of the file where the state is stored
+   */
+  virtual void do_deserialize_file(const boost::filesystem::path &path);
+
+  /**
+   * @brief De-serializes the state of an object from a file mapped in memory
+   *
+   * The default reads the mapping through do_deserialize(ByteSource&).
+   *
+   * @param[in] file file where the state is stored
+   */
+  virtual void do_deserialize_mapped(const MappedFile &file);
+};
+
+/**
+ * @brief Adapter for objects that serialize their state only to and from files
+ *
+ * Implementations override the path-based versions: sinks and sources go
+ * through a temporary file.
+ */
+class PathSerializable : public SerializableObject {
+protected:
+  void do_serialize_file(const boost::filesystem::path &path) const override = 0;
+
+  void do_deserialize_file(const boost::filesystem::path &path) override = 0;
+
+  /**
+   * @brief Serializes the state into a temporary file, then copies it into a sink
+   *
+   * @param[in,out] sink where the state is appended
+   */
+  void do_serialize(ByteSink &sink) const override;
+
+  /**
+   * @brief Copies a source into a temporary file, then de-serializes the state from it
+   *
+   * @param[in,out] source where the state is read
+   */
+  void do_deserialize(ByteSource &source) override;
+
+  /**
+   * @brief De-serializes the state from the file that was mapped, through the path-based version
+   *
+   * @param[in] file file where the state is stored
+   */
+  void do_deserialize_mapped(const MappedFile &file) override;
 };
 }
 
@@ -0,0 +1,164 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file thread_pool.h
+ *
+ * @brief Fixed set of worker threads running tasks from a queue
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 4:30 PM
+ */
+
+#ifndef THREAD_POOL_H_20261018
+#define THREAD_POOL_H_20261018
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mwheel {
+
+/**
+ * @brief Runs tasks on a fixed set of worker threads, in the order they
+ * were submitted
+ *
+ * A pool shared by the whole application is available as
+ * `Singleton<ThreadPool>::get_instance()`.
+ */
+class ThreadPool {
+public:
+  /**
+   * @brief Starts the worker threads
+   *
+   * @param[in] nthreads number of worker threads (0 means one per hardware thread)
+   */
+  explicit ThreadPool(std::size_t nthreads = 0);
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * @brief Queues a task
+   *
+   * @param[in] function task to be run, callable without arguments
+   *
+   * @return future that holds the result of the task, or what it threw
+   */
+  template <class F> std::future<typename std::result_of<F()>::type> submit(F function) {
+    using result_type = typename std::result_of<F()>::type;
+    auto task = std::make_shared<std::packaged_task<result_type()>>(std::move(function));
+    auto outcome = task->get_future();
+    enqueue([task]() { (*task)(); });
+    return outcome;
+  }
+
+  /**
+   * @brief Blocks until a task is over
+   *
+   * A worker of this pool that waits for another task keeps running the
+   * tasks in the queue meanwhile, so that tasks can submit work to the pool
+   * they run on and wait for it without deadlocking.
+   *
+   * @param[in] outcome future returned by submit()
+   */
+  template <class T> void wait(const std::future<T> &outcome) {
+    if (is_worker()) {
+      while (outcome.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        if (!run_pending_task()) {
+          // The remaining tasks are running on other workers
+          break;
+        }
+      }
+    }
+    outcome.wait();
+  }
+
+  /**
+   * @brief Checks if the calling thread is one of the workers of this pool
+   *
+   * @return true if the calling thread is a worker of this pool
+   */
+  bool is_worker() const;
+
+  /**
+   * @brief Returns the number of worker threads
+   *
+   * @return number of worker threads
+   */
+  std::size_t size() const { return m_workers.size(); }
+
+  /**
+   * @brief Runs the tasks still in the queue, then stops the worker threads
+   */
+  ~ThreadPool();
+
+private:
+  /**
+   * @brief Adds a task to the queue and wakes up a worker
+   *
+   * @param[in] task task to be run
+   */
+  void enqueue(std::function<void()> task);
+
+  /**
+   * @brief Runs the first task in the queue on the calling thread
+   *
+   * @return false if the queue was empty
+   */
+  bool run_pending_task();
+
+  /**
+   * @brief Loop of each worker thread
+   */
+  void work();
+
+  /// Guards the queue and the stop flag
+  std::mutex m_mutex;
+  /// Signals that a task was queued or that the pool is stopping
+  std::condition_variable m_ready;
+  /// Tasks waiting for a worker
+  std::deque<std::function<void()>> m_tasks;
+  /// Set when the pool is being destroyed
+  bool m_stopping;
+  /// Worker threads
+  std::vector<std::thread> m_workers;
+};
+}
+
+#endif /* THREAD_POOL_H_20261018 */
@@ -0,0 +1,501 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/async_serializer.h>
+#include <mwheel/byte_stream.h>
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef MWHEEL_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+namespace mwheel {
+
+namespace implementation {
+
+/**
+ * @brief State of an operation whose file is read or written through the ring
+ */
+struct IoRequest {
+  IoRequest(const boost::filesystem::path &path, SerializableObject *object)
+      : path(path), object(object), fd(-1), done(0) {}
+
+  IoRequest(const IoRequest &) = delete;
+  IoRequest &operator=(const IoRequest &) = delete;
+
+  ~IoRequest() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  /// Name of the file
+  boost::filesystem::path path;
+  /// Object that receives the state, null if the state is written
+  SerializableObject *object;
+  /// State of the object
+  vector<char> buffer;
+  /// File descriptor of the file
+  int fd;
+  /// Bytes already transferred
+  size_t done;
+  /// Bytes still to be transferred, as seen by the kernel
+  iovec iov;
+  /// Outcome of the operation
+  promise<void> outcome;
+  /// Keeps the request alive while the kernel owns it
+  shared_ptr<IoRequest> self;
+};
+
+#ifdef MWHEEL_HAVE_IO_URING
+
+/**
+ * @brief Minimal io_uring instance, driven through raw system calls
+ *
+ * Requests are submitted by any thread; a dedicated thread waits for the
+ * completions and hands them to a handler.
+ */
+class IoRing {
+public:
+  /// Receives each request whose I/O completed, and the result of the I/O
+  using handler_type = function<void(shared_ptr<IoRequest>, int)>;
+
+  /**
+   * @brief Creates a ring
+   *
+   * @param[in] entries number of requests that can be in flight
+   * @param[in] handler called on the completion thread for each request
+   *
+   * @return the ring, or null if the kernel doesn't support io_uring
+   */
+  static unique_ptr<IoRing> create(unsigned entries, handler_type handler) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+#ifdef IORING_SETUP_CLAMP
+    params.flags |= IORING_SETUP_CLAMP;
+#endif
+    auto fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+      return nullptr;
+    }
+    unique_ptr<IoRing> ring(new IoRing(fd, std::move(handler)));
+    if (!ring->map(params)) {
+      return nullptr;
+    }
+    ring->m_completion = thread(&IoRing::reap, ring.get());
+    return ring;
+  }
+
+  IoRing(const IoRing &) = delete;
+  IoRing &operator=(const IoRing &) = delete;
+
+  /**
+   * @brief Reads or writes the bytes of a request not transferred yet
+   *
+   * @param[in] request request to be submitted
+   */
+  void submit(shared_ptr<IoRequest> request) {
+    request->iov.iov_base = request->buffer.data() + request->done;
+    request->iov.iov_len = request->buffer.size() - request->done;
+    request->self = request;
+    auto opcode = request->object ? IORING_OP_READV : IORING_OP_WRITEV;
+    auto error = push(opcode, request->fd, &request->iov, request->done,
+                      reinterpret_cast<uint64_t>(request.get()));
+    if (error != 0) {
+      request->self.reset();
+      m_handler(std::move(request), -error);
+    }
+  }
+
+  /**
+   * @brief Stops the completion thread and releases the ring
+   *
+   * No request must be in flight.
+   */
+  ~IoRing() {
+    if (m_completion.joinable()) {
+      // A no-op without a request tells the completion thread to stop
+      while (push(IORING_OP_NOP, -1, nullptr, 0, 0) != 0) {
+        this_thread::yield();
+      }
+      m_completion.join();
+    }
+    if (m_sqes != MAP_FAILED) {
+      ::munmap(m_sqes, m_sqes_size);
+    }
+    if (m_cq_ring != MAP_FAILED && m_cq_ring != m_sq_ring) {
+      ::munmap(m_cq_ring, m_cq_ring_size);
+    }
+    if (m_sq_ring != MAP_FAILED) {
+      ::munmap(m_sq_ring, m_sq_ring_size);
+    }
+    ::close(m_fd);
+  }
+
+private:
+  IoRing(int fd, handler_type handler)
+      : m_fd(fd), m_handler(std::move(handler)), m_sq_ring(MAP_FAILED), m_cq_ring(MAP_FAILED),
+        m_sqes(MAP_FAILED) {}
+
+  /**
+   * @brief Maps the rings shared with the kernel
+   *
+   * @return false if they can't be mapped
+   */
+  bool map(const io_uring_params &params) {
+    m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      m_sq_ring_size = m_cq_ring_size = max(m_sq_ring_size, m_cq_ring_size);
+    }
+    m_sq_ring = ::mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       m_fd, IORING_OFF_SQ_RING);
+    if (m_sq_ring == MAP_FAILED) {
+      return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      m_cq_ring = m_sq_ring;
+    } else {
+      m_cq_ring = ::mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+      if (m_cq_ring == MAP_FAILED) {
+        return false;
+      }
+    }
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = ::mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd,
+                    IORING_OFF_SQES);
+    if (m_sqes == MAP_FAILED) {
+      return false;
+    }
+    auto sq = static_cast<char *>(m_sq_ring);
+    auto cq = static_cast<char *>(m_cq_ring);
+    m_sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    m_sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    m_sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    m_cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    m_cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    m_cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  /**
+   * @brief Queues a submission and passes it to the kernel
+   *
+   * @return 0 on success, the error code otherwise
+   */
+  int push(unsigned char opcode, int fd, iovec *iov, size_t offset, uint64_t user_data) {
+    lock_guard<mutex> lock(m_submission_mutex);
+    // Only this thread moves the tail, and the kernel consumes the entry
+    // within io_uring_enter: the queue can't be full here
+    auto tail = *m_sq_tail;
+    auto index = tail & m_sq_mask;
+    auto &sqe = static_cast<io_uring_sqe *>(m_sqes)[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(iov);
+    sqe.len = iov ? 1 : 0;
+    sqe.off = offset;
+    sqe.user_data = user_data;
+    m_sq_array[index] = index;
+    __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+    for (;;) {
+      auto n = ::syscall(__NR_io_uring_enter, m_fd, 1, 0, 0, nullptr, 0);
+      if (n >= 0) {
+        return 0;
+      }
+      if (errno != EINTR) {
+        // Take the entry back, the kernel didn't consume it
+        auto error = errno;
+        __atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+        return error;
+      }
+    }
+  }
+
+  /**
+   * @brief Loop of the completion thread
+   */
+  void reap() {
+    for (;;) {
+      auto head = *m_cq_head;
+      if (head == __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE)) {
+        ::syscall(__NR_io_uring_enter, m_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        continue;
+      }
+      auto cqe = m_cqes[head & m_cq_mask];
+      __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+      if (cqe.user_data == 0) {
+        return;
+      }
+      auto request = std::move(reinterpret_cast<IoRequest *>(cqe.user_data)->self);
+      m_handler(std::move(request), cqe.res);
+    }
+  }
+
+  /// File descriptor of the ring
+  int m_fd;
+  /// Called for each request whose I/O completed
+  handler_type m_handler;
+  /// Serializes the submissions
+  mutex m_submission_mutex;
+  /// Mapping of the submission ring
+  void *m_sq_ring;
+  /// Size of the mapping of the submission ring
+  size_t m_sq_ring_size;
+  /// Mapping of the completion ring (may be the same as the submission one)
+  void *m_cq_ring;
+  /// Size of the mapping of the completion ring
+  size_t m_cq_ring_size;
+  /// Mapping of the submission entries
+  void *m_sqes;
+  /// Size of the mapping of the submission entries
+  size_t m_sqes_size;
+  /// Tail of the submission ring
+  unsigned *m_sq_tail;
+  /// Mask of the indices of the submission ring
+  unsigned m_sq_mask;
+  /// Indices of the submission entries
+  unsigned *m_sq_array;
+  /// Head of the completion ring
+  unsigned *m_cq_head;
+  /// Tail of the completion ring
+  unsigned *m_cq_tail;
+  /// Mask of the indices of the completion ring
+  unsigned m_cq_mask;
+  /// Completion entries
+  io_uring_cqe *m_cqes;
+  /// Thread that waits for the completions
+  thread m_completion;
+};
+
+#else
+
+/**
+ * @brief Placeholder for systems without io_uring
+ */
+class IoRing {
+public:
+  using handler_type = function<void(shared_ptr<IoRequest>, int)>;
+
+  static unique_ptr<IoRing> create(unsigned, handler_type) { return nullptr; }
+
+  void submit(shared_ptr<IoRequest>) {}
+};
+
+#endif
+}
+
+namespace {
+
+/**
+ * @brief Returns an AsyncSerializer::io_error for a failed system call
+ *
+ * @param[in] path name of the file
+ * @param[in] operation what was being done
+ * @param[in] error error code
+ */
+exception_ptr system_error_for(const boost::filesystem::path &path, const char *operation,
+                               int error) {
+  stringstream estream;
+  estream << "ERROR : cannot " << operation << " " << path << endl;
+  estream << "\t" << strerror(error) << endl;
+  return make_exception_ptr(AsyncSerializer::io_error(estream.str()));
+}
+}
+
+AsyncSerializer::AsyncSerializer(ThreadPool &pool, Options options)
+    : m_pool(pool), m_queue_depth(max<size_t>(options.queue_depth, 1)), m_in_flight(0) {
+  if (options.use_io_uring) {
+    m_ring = implementation::IoRing::create(
+        static_cast<unsigned>(m_queue_depth),
+        [this](shared_ptr<implementation::IoRequest> request, int result) {
+          complete(std::move(request), result);
+        });
+  }
+}
+
+future<void> AsyncSerializer::serialize(const SerializableObject &object,
+                                        const boost::filesystem::path &path) {
+  acquire();
+  auto request = make_shared<implementation::IoRequest>(path, nullptr);
+  auto outcome = request->outcome.get_future();
+  auto target = &object;
+  m_pool.submit([this, target, request]() {
+    try {
+      if (!m_ring) {
+        target->serialize(request->path);
+        request->outcome.set_value();
+        release();
+        return;
+      }
+      VectorSink sink(request->buffer);
+      target->serialize(sink);
+      request->fd = ::open(request->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+      if (request->fd < 0) {
+        rethrow_exception(system_error_for(request->path, "create", errno));
+      }
+    } catch (...) {
+      request->outcome.set_exception(current_exception());
+      release();
+      return;
+    }
+    if (request->buffer.empty()) {
+      finish(request);
+    } else {
+      m_ring->submit(request);
+    }
+  });
+  return outcome;
+}
+
+future<void> AsyncSerializer::deserialize(SerializableObject &object,
+                                          const boost::filesystem::path &path) {
+  acquire();
+  auto request = make_shared<implementation::IoRequest>(path, &object);
+  auto outcome = request->outcome.get_future();
+  m_pool.submit([this, request]() {
+    try {
+      if (!m_ring) {
+        request->object->deserialize(request->path);
+        request->outcome.set_value();
+        release();
+        return;
+      }
+      request->fd = ::open(request->path.c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat status;
+      if (request->fd < 0 || ::fstat(request->fd, &status) != 0) {
+        rethrow_exception(system_error_for(request->path, "open", errno));
+      }
+      request->buffer.resize(static_cast<size_t>(status.st_size));
+    } catch (...) {
+      request->outcome.set_exception(current_exception());
+      release();
+      return;
+    }
+    if (request->buffer.empty()) {
+      finish(request);
+    } else {
+      m_ring->submit(request);
+    }
+  });
+  return outcome;
+}
+
+AsyncSerializer::Backend AsyncSerializer::backend() const {
+  return m_ring ? Backend::io_uring : Backend::thread_pool;
+}
+
+size_t AsyncSerializer::in_flight() const {
+  lock_guard<mutex> lock(m_mutex);
+  return m_in_flight;
+}
+
+void AsyncSerializer::wait() const {
+  unique_lock<mutex> lock(m_mutex);
+  m_completed.wait(lock, [this]() { return m_in_flight == 0; });
+}
+
+AsyncSerializer::~AsyncSerializer() {
+  wait();
+  m_ring.reset();
+}
+
+void AsyncSerializer::acquire() {
+  unique_lock<mutex> lock(m_mutex);
+  m_completed.wait(lock, [this]() { return m_in_flight < m_queue_depth; });
+  ++m_in_flight;
+}
+
+void AsyncSerializer::release() {
+  // Notifying under the lock keeps the serializer alive until the end of the call
+  lock_guard<mutex> lock(m_mutex);
+  --m_in_flight;
+  m_completed.notify_all();
+}
+
+void AsyncSerializer::complete(shared_ptr<implementation::IoRequest> request, int result) {
+  if (result < 0 || (result == 0 && request->object)) {
+    auto operation = request->object ? "read" : "write";
+    request->outcome.set_exception(
+        system_error_for(request->path, operation, result < 0 ? -result : EIO));
+    release();
+    return;
+  }
+  request->done += static_cast<size_t>(result);
+  if (request->done < request->buffer.size()) {
+    m_ring->submit(std::move(request));
+    return;
+  }
+  finish(std::move(request));
+}
+
+void AsyncSerializer::finish(shared_ptr<implementation::IoRequest> request) {
+  auto fd = request->fd;
+  request->fd = -1;
+  if (::close(fd) != 0 && !request->object) {
+    request->outcome.set_exception(system_error_for(request->path, "write", errno));
+    release();
+    return;
+  }
+  if (!request->object) {
+    request->outcome.set_value();
+    release();
+    return;
+  }
+  // The completion thread only waits for I/O: states are parsed on the pool
+  m_pool.submit([this, request]() {
+    try {
+      MemorySource source(request->buffer.data(), request->buffer.size());
+      request->object->deserialize(source);
+      request->outcome.set_value();
+    } catch (...) {
+      request->outcome.set_exception(current_exception());
+    }
+    release();
+  });
+}
+}
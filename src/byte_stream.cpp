@@ -0,0 +1,233 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/byte_stream.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <sstream>
+
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace mwheel {
+
+namespace {
+
+/**
+ * @brief Throws an exception that reports the last system error
+ *
+ * @tparam Error type of the exception
+ *
+ * @param[in] operation what was being done
+ */
+template <class Error>[[noreturn]] void throw_system_error(const char *operation) {
+  auto error = errno;
+  stringstream estream;
+  estream << "ERROR : cannot " << operation << " a file descriptor" << endl;
+  estream << "\t" << strerror(error) << endl;
+  throw Error(estream.str());
+}
+
+/**
+ * @brief Throws ByteSource::read_error because a source ended too early
+ *
+ * @param[in] missing number of bytes that could not be read
+ */
+[[noreturn]] void throw_end_of_source(size_t missing) {
+  stringstream estream;
+  estream << "ERROR : unexpected end of the serialized bytes" << endl;
+  estream << "\t" << missing << " more bytes were expected" << endl;
+  throw ByteSource::read_error(estream.str());
+}
+
+/**
+ * @brief Advances an array of system buffers past the bytes transferred
+ *
+ * @param[in,out] iov first buffer
+ * @param[in,out] count number of buffers
+ * @param[in] done number of bytes transferred
+ */
+void advance(iovec *&iov, int &count, size_t done) {
+  while (count > 0 && done >= iov->iov_len) {
+    done -= iov->iov_len;
+    ++iov;
+    --count;
+  }
+  if (count > 0) {
+    iov->iov_base = static_cast<char *>(iov->iov_base) + done;
+    iov->iov_len -= done;
+  }
+}
+}
+
+void ByteSink::write(const ConstBuffer *buffers, size_t count) {
+  for (size_t ii = 0; ii < count; ++ii) {
+    write(buffers[ii].data, buffers[ii].size);
+  }
+}
+
+ByteSink::~ByteSink() {}
+
+void ByteSource::read(const MutableBuffer *buffers, size_t count) {
+  for (size_t ii = 0; ii < count; ++ii) {
+    read(buffers[ii].data, buffers[ii].size);
+  }
+}
+
+void ByteSource::read(void *data, size_t size) {
+  auto destination = static_cast<char *>(data);
+  while (size > 0) {
+    auto n = read_some(destination, size);
+    if (n == 0) {
+      throw_end_of_source(size);
+    }
+    destination += n;
+    size -= n;
+  }
+}
+
+ByteSource::~ByteSource() {}
+
+void VectorSink::write(const void *data, size_t size) {
+  auto begin = static_cast<const char *>(data);
+  m_buffer.insert(m_buffer.end(), begin, begin + size);
+}
+
+size_t MemorySource::read_some(void *data, size_t size) {
+  auto n = min(size, remaining());
+  memcpy(data, m_position, n);
+  m_position += n;
+  return n;
+}
+
+void MemorySource::skip(size_t size) {
+  if (size > remaining()) {
+    throw_end_of_source(size - remaining());
+  }
+  m_position += size;
+}
+
+void FileDescriptorSink::write(const void *data, size_t size) {
+  ConstBuffer buffer{data, size};
+  write(&buffer, 1);
+}
+
+void FileDescriptorSink::write(const ConstBuffer *buffers, size_t count) {
+  // writev takes at most IOV_MAX buffers, and may write part of them
+  vector<iovec> iov(min<size_t>(count, IOV_MAX));
+  for (size_t first = 0; first < count; first += iov.size()) {
+    auto batch = static_cast<int>(min<size_t>(count - first, iov.size()));
+    for (auto ii = 0; ii < batch; ++ii) {
+      iov[ii].iov_base = const_cast<void *>(buffers[first + ii].data);
+      iov[ii].iov_len = buffers[first + ii].size;
+    }
+    auto pending = iov.data();
+    while (batch > 0) {
+      auto n = ::writev(m_fd, pending, batch);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw_system_error<write_error>("write to");
+      }
+      advance(pending, batch, static_cast<size_t>(n));
+    }
+  }
+}
+
+size_t FileDescriptorSource::read_some(void *data, size_t size) {
+  for (;;) {
+    auto n = ::read(m_fd, data, size);
+    if (n >= 0) {
+      return static_cast<size_t>(n);
+    }
+    if (errno != EINTR) {
+      throw_system_error<read_error>("read from");
+    }
+  }
+}
+
+void FileDescriptorSource::read(const MutableBuffer *buffers, size_t count) {
+  vector<iovec> iov(min<size_t>(count, IOV_MAX));
+  for (size_t first = 0; first < count; first += iov.size()) {
+    auto batch = static_cast<int>(min<size_t>(count - first, iov.size()));
+    size_t expected = 0;
+    for (auto ii = 0; ii < batch; ++ii) {
+      iov[ii].iov_base = buffers[first + ii].data;
+      iov[ii].iov_len = buffers[first + ii].size;
+      expected += buffers[first + ii].size;
+    }
+    auto pending = iov.data();
+    while (batch > 0 && expected > 0) {
+      auto n = ::readv(m_fd, pending, batch);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw_system_error<read_error>("read from");
+      }
+      if (n == 0) {
+        throw_end_of_source(expected);
+      }
+      expected -= static_cast<size_t>(n);
+      advance(pending, batch, static_cast<size_t>(n));
+    }
+  }
+}
+
+void StreamSink::write(const void *data, size_t size) {
+  if (!m_stream.write(static_cast<const char *>(data), static_cast<streamsize>(size))) {
+    stringstream estream;
+    estream << "ERROR : cannot write to a stream" << endl;
+    throw write_error(estream.str());
+  }
+}
+
+size_t StreamSource::read_some(void *data, size_t size) {
+  auto n = min(size, m_remaining);
+  if (n == 0) {
+    return 0;
+  }
+  m_stream.read(static_cast<char *>(data), static_cast<streamsize>(n));
+  auto done = static_cast<size_t>(m_stream.gcount());
+  if (done == 0) {
+    stringstream estream;
+    estream << "ERROR : cannot read from a stream" << endl;
+    throw read_error(estream.str());
+  }
+  m_remaining -= done;
+  return done;
+}
+}
@@ -0,0 +1,557 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/compression.h>
+
+#include "file_format.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <sstream>
+
+#ifdef MWHEEL_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+
+namespace mwheel {
+
+namespace {
+
+using implementation::checksum;
+using implementation::load_le;
+using implementation::store_le;
+
+/// First and last bytes of every compressed stream
+const char stream_magic[8] = {'M', 'W', 'C', 'O', 'M', 'P', 'R', 'S'};
+/// Size of the header of a block
+const size_t block_header_size = 16;
+/// Size of the trailer of a stream
+const size_t trailer_size = 32;
+/// Flag of the blocks stored as they are
+const uint32_t raw_block = 1;
+
+/**
+ * @brief Throws Codec::corrupted_data
+ *
+ * @param[in] reason what is wrong with the data
+ */
+[[noreturn]] void throw_corrupted(const string &reason) {
+  stringstream estream;
+  estream << "ERROR : cannot decompress the data" << endl;
+  estream << "\t" << reason << endl;
+  throw Codec::corrupted_data(estream.str());
+}
+
+/**
+ * @brief Waits for every task, then rethrows the first exception, if any
+ */
+void wait_all(ThreadPool &pool, vector<future<void>> &tasks) {
+  exception_ptr error;
+  for (auto &x : tasks) {
+    try {
+      pool.wait(x);
+      x.get();
+    } catch (...) {
+      if (!error) {
+        error = current_exception();
+      }
+    }
+  }
+  if (error) {
+    rethrow_exception(error);
+  }
+}
+
+/**
+ * @brief Stores blocks as they are
+ */
+class IdentityCodec : public Codec {
+public:
+  void compress(const char *data, size_t size, vector<char> &output) const override {
+    output.insert(output.end(), data, data + size);
+  }
+
+  void decompress(const char *data, size_t size, char *output,
+                  size_t original_size) const override {
+    if (size != original_size) {
+      throw_corrupted("the size of an identity block doesn't match");
+    }
+    memcpy(output, data, size);
+  }
+
+  clone_type clone() override { return make_shared<IdentityCodec>(); }
+
+private:
+  MWHEEL_REGISTRABLE_PRODUCT;
+};
+
+MWHEEL_REGISTER_PRODUCT(IdentityCodec, "identity");
+
+/**
+ * @brief Byte-oriented LZ77 codec, tuned for speed rather than ratio
+ *
+ * A block is a list of sequences: a token (literal length in the high
+ * nibble, match length minus 4 in the low one, 15 meaning that more
+ * length bytes follow), the literals, then the 16 bits offset of the
+ * match and the rest of its length. The last sequence has literals only.
+ */
+class LzCodec : public Codec {
+public:
+  void compress(const char *data, size_t size, vector<char> &output) const override {
+    const size_t hash_bits = 14;
+    const size_t max_offset = 65535;
+    vector<int64_t> table(size_t(1) << hash_bits, -1);
+    size_t anchor = 0;
+    size_t ii = 0;
+    while (ii + 4 <= size) {
+      auto sequence = load32(data + ii);
+      auto hash = (sequence * 2654435761u) >> (32 - hash_bits);
+      auto candidate = table[hash];
+      table[hash] = static_cast<int64_t>(ii);
+      if (candidate < 0 || ii - static_cast<size_t>(candidate) > max_offset ||
+          load32(data + candidate) != sequence) {
+        ++ii;
+        continue;
+      }
+      auto match = static_cast<size_t>(candidate);
+      size_t length = 4;
+      while (ii + length < size && data[match + length] == data[ii + length]) {
+        ++length;
+      }
+      emit(output, data + anchor, ii - anchor, ii - match, length);
+      ii += length;
+      anchor = ii;
+    }
+    emit(output, data + anchor, size - anchor, 0, 0);
+  }
+
+  void decompress(const char *data, size_t size, char *output,
+                  size_t original_size) const override {
+    auto input = data;
+    auto end = data + size;
+    size_t done = 0;
+    for (;;) {
+      if (input == end) {
+        throw_corrupted("an LZ block ends in the middle of a sequence");
+      }
+      auto token = static_cast<unsigned char>(*input++);
+      size_t literals = token >> 4;
+      if (literals == 15) {
+        literals += read_length(input, end);
+      }
+      if (literals > static_cast<size_t>(end - input) || literals > original_size - done) {
+        throw_corrupted("the literals of an LZ block are out of bounds");
+      }
+      memcpy(output + done, input, literals);
+      input += literals;
+      done += literals;
+      if (input == end) {
+        break;
+      }
+      if (end - input < 2) {
+        throw_corrupted("an LZ block ends in the middle of a sequence");
+      }
+      auto offset = static_cast<size_t>(load_le<uint16_t>(input));
+      input += 2;
+      size_t length = (token & 15) + 4;
+      if ((token & 15) == 15) {
+        length += read_length(input, end);
+      }
+      if (offset == 0 || offset > done || length > original_size - done) {
+        throw_corrupted("a match of an LZ block is out of bounds");
+      }
+      // Matches may overlap the bytes they produce
+      for (auto source = output + done - offset; length > 0; --length) {
+        output[done++] = *source++;
+      }
+    }
+    if (done != original_size) {
+      throw_corrupted("an LZ block decompressed to the wrong size");
+    }
+  }
+
+  clone_type clone() override { return make_shared<LzCodec>(); }
+
+private:
+  /**
+   * @brief Loads 4 bytes in native order
+   */
+  static uint32_t load32(const char *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+  }
+
+  /**
+   * @brief Appends the part of a length that doesn't fit in the token
+   */
+  static void emit_length(vector<char> &output, size_t length) {
+    for (; length >= 255; length -= 255) {
+      output.push_back(static_cast<char>(255));
+    }
+    output.push_back(static_cast<char>(length));
+  }
+
+  /**
+   * @brief Reads the part of a length that doesn't fit in the token
+   */
+  static size_t read_length(const char *&input, const char *end) {
+    size_t length = 0;
+    for (;;) {
+      if (input == end) {
+        throw_corrupted("an LZ block ends in the middle of a length");
+      }
+      auto byte = static_cast<unsigned char>(*input++);
+      length += byte;
+      if (byte != 255) {
+        return length;
+      }
+    }
+  }
+
+  /**
+   * @brief Appends a sequence (a match of length 0 ends the block)
+   */
+  static void emit(vector<char> &output, const char *literals, size_t nliterals, size_t offset,
+                   size_t length) {
+    auto extra = length > 0 ? length - 4 : 0;
+    output.push_back(static_cast<char>((min<size_t>(nliterals, 15) << 4) | min<size_t>(extra, 15)));
+    if (nliterals >= 15) {
+      emit_length(output, nliterals - 15);
+    }
+    output.insert(output.end(), literals, literals + nliterals);
+    if (length > 0) {
+      output.push_back(static_cast<char>(offset & 0xff));
+      output.push_back(static_cast<char>(offset >> 8));
+      if (extra >= 15) {
+        emit_length(output, extra - 15);
+      }
+    }
+  }
+
+  MWHEEL_REGISTRABLE_PRODUCT;
+};
+
+MWHEEL_REGISTER_PRODUCT(LzCodec, "lz");
+
+#ifdef MWHEEL_HAVE_ZLIB
+
+/**
+ * @brief Deflate codec provided by zlib
+ */
+class ZlibCodec : public Codec {
+public:
+  void compress(const char *data, size_t size, vector<char> &output) const override {
+    auto start = output.size();
+    auto bound = ::compressBound(static_cast<uLong>(size));
+    output.resize(start + bound);
+    auto length = static_cast<uLongf>(bound);
+    if (::compress2(reinterpret_cast<Bytef *>(output.data() + start), &length,
+                    reinterpret_cast<const Bytef *>(data), static_cast<uLong>(size),
+                    Z_DEFAULT_COMPRESSION) != Z_OK) {
+      output.resize(start);
+      stringstream estream;
+      estream << "ERROR : zlib failed to compress a block" << endl;
+      throw ByteSink::write_error(estream.str());
+    }
+    output.resize(start + length);
+  }
+
+  void decompress(const char *data, size_t size, char *output,
+                  size_t original_size) const override {
+    auto length = static_cast<uLongf>(original_size);
+    if (::uncompress(reinterpret_cast<Bytef *>(output), &length,
+                     reinterpret_cast<const Bytef *>(data), static_cast<uLong>(size)) != Z_OK ||
+        length != original_size) {
+      throw_corrupted("zlib failed to decompress a block");
+    }
+  }
+
+  clone_type clone() override { return make_shared<ZlibCodec>(); }
+
+private:
+  MWHEEL_REGISTRABLE_PRODUCT;
+};
+
+MWHEEL_REGISTER_PRODUCT(ZlibCodec, "zlib");
+
+#endif
+
+/**
+ * @brief Decodes a block whose header was validated
+ *
+ * @param[in] codec codec of the stream
+ * @param[in] header header of the block, followed by its stored bytes
+ * @param[out] output where the original bytes are stored
+ */
+void decode_block(const Codec &codec, const char *header, char *output) {
+  auto stored = load_le<uint32_t>(header);
+  auto original = load_le<uint32_t>(header + 4);
+  auto payload = header + block_header_size;
+  if (load_le<uint32_t>(header + 12) & raw_block) {
+    if (stored != original) {
+      throw_corrupted("the size of a stored block doesn't match");
+    }
+    memcpy(output, payload, original);
+  } else {
+    codec.decompress(payload, stored, output, original);
+  }
+  if (checksum(output, original) != load_le<uint32_t>(header + 8)) {
+    throw_corrupted("the checksum of a block doesn't match its content");
+  }
+}
+}
+
+Codec::~Codec() {}
+
+constexpr size_t CompressedSink::default_block_size;
+
+CompressedSink::CompressedSink(ByteSink &destination, const string &codec, size_t block_size,
+                               ThreadPool &pool)
+    : m_destination(destination), m_codec(Codec::factory_type::get_instance().create(codec)),
+      m_block_size(min<size_t>(max<size_t>(block_size, 1), UINT32_MAX)), m_pool(pool), m_offset(0),
+      m_size(0), m_finished(false) {
+  vector<char> header(16 + codec.size());
+  memcpy(header.data(), stream_magic, sizeof(stream_magic));
+  store_le<uint32_t>(header.data() + 8, static_cast<uint32_t>(m_block_size));
+  store_le<uint32_t>(header.data() + 12, static_cast<uint32_t>(codec.size()));
+  memcpy(header.data() + 16, codec.data(), codec.size());
+  m_destination.write(header.data(), header.size());
+  m_offset = header.size();
+  m_blocks.emplace_back();
+  m_blocks.back().reserve(m_block_size);
+}
+
+void CompressedSink::write(const void *data, size_t size) {
+  if (m_finished) {
+    stringstream estream;
+    estream << "ERROR : cannot write to a compressed stream" << endl;
+    estream << "\tthe stream was already finished" << endl;
+    throw write_error(estream.str());
+  }
+  auto input = static_cast<const char *>(data);
+  m_size += size;
+  while (size > 0) {
+    auto &block = m_blocks.back();
+    auto n = min(size, m_block_size - block.size());
+    block.insert(block.end(), input, input + n);
+    input += n;
+    size -= n;
+    if (block.size() == m_block_size) {
+      if (m_blocks.size() >= max<size_t>(m_pool.size(), 1)) {
+        write_blocks();
+      }
+      m_blocks.emplace_back();
+      m_blocks.back().reserve(m_block_size);
+    }
+  }
+}
+
+void CompressedSink::finish() {
+  if (m_finished) {
+    return;
+  }
+  if (m_blocks.back().empty()) {
+    m_blocks.pop_back();
+  }
+  write_blocks();
+  m_finished = true;
+  vector<char> tail(block_header_size + m_index.size() * sizeof(uint64_t) + trailer_size);
+  auto position = tail.data() + block_header_size;
+  for (auto x : m_index) {
+    store_le<uint64_t>(position, x);
+    position += sizeof(uint64_t);
+  }
+  store_le<uint64_t>(position, m_offset + block_header_size);
+  store_le<uint64_t>(position + 8, m_index.size());
+  store_le<uint64_t>(position + 16, m_size);
+  memcpy(position + 24, stream_magic, sizeof(stream_magic));
+  m_destination.write(tail.data(), tail.size());
+  m_offset += tail.size();
+}
+
+void CompressedSink::write_blocks() {
+  auto count = m_blocks.size();
+  vector<vector<char>> compressed(count);
+  auto compress = [this, &compressed](size_t ii) {
+    compressed[ii].reserve(m_blocks[ii].size());
+    m_codec->compress(m_blocks[ii].data(), m_blocks[ii].size(), compressed[ii]);
+  };
+  if (count == 1) {
+    compress(0);
+  } else {
+    vector<future<void>> tasks;
+    for (size_t ii = 0; ii < count; ++ii) {
+      tasks.push_back(m_pool.submit([&compress, ii]() { compress(ii); }));
+    }
+    wait_all(m_pool, tasks);
+  }
+  for (size_t ii = 0; ii < count; ++ii) {
+    const auto &original = m_blocks[ii];
+    auto raw = compressed[ii].size() >= original.size();
+    const auto &stored = raw ? original : compressed[ii];
+    char header[block_header_size];
+    store_le<uint32_t>(header, static_cast<uint32_t>(stored.size()));
+    store_le<uint32_t>(header + 4, static_cast<uint32_t>(original.size()));
+    store_le<uint32_t>(header + 8, checksum(original.data(), original.size()));
+    store_le<uint32_t>(header + 12, raw ? raw_block : 0);
+    ConstBuffer buffers[] = {{header, block_header_size}, {stored.data(), stored.size()}};
+    m_destination.write(buffers, 2);
+    m_index.push_back(m_offset);
+    m_offset += block_header_size + stored.size();
+  }
+  m_blocks.clear();
+}
+
+CompressedSource::CompressedSource(ByteSource &source)
+    : m_source(source), m_block_size(0), m_position(0), m_ended(false) {
+  char header[16];
+  m_source.read(header, sizeof(header));
+  if (memcmp(header, stream_magic, sizeof(stream_magic)) != 0) {
+    throw_corrupted("the data is not a compressed stream");
+  }
+  m_block_size = load_le<uint32_t>(header + 8);
+  auto name_size = load_le<uint32_t>(header + 12);
+  if (name_size > 255) {
+    throw_corrupted("the name of the codec is too long");
+  }
+  string codec(name_size, '\0');
+  m_source.read(&codec[0], codec.size());
+  m_codec = Codec::factory_type::get_instance().create(codec);
+}
+
+size_t CompressedSource::read_some(void *data, size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  while (m_position == m_block.size()) {
+    if (m_ended || !next_block()) {
+      return 0;
+    }
+  }
+  auto n = min(size, m_block.size() - m_position);
+  memcpy(data, m_block.data() + m_position, n);
+  m_position += n;
+  return n;
+}
+
+bool CompressedSource::next_block() {
+  char header[block_header_size];
+  m_source.read(header, block_header_size);
+  auto stored = load_le<uint32_t>(header);
+  auto original = load_le<uint32_t>(header + 4);
+  if (stored == 0 && original == 0) {
+    m_ended = true;
+    return false;
+  }
+  if (original > m_block_size || stored > max<size_t>(2 * m_block_size, 1 << 16)) {
+    throw_corrupted("the header of a block is corrupted");
+  }
+  m_compressed.resize(block_header_size + stored);
+  memcpy(m_compressed.data(), header, block_header_size);
+  m_source.read(m_compressed.data() + block_header_size, stored);
+  m_block.resize(original);
+  decode_block(*m_codec, m_compressed.data(), m_block.data());
+  m_position = 0;
+  return true;
+}
+
+CompressedReader::CompressedReader(const char *data, size_t size, ThreadPool &pool)
+    : m_data(data), m_stream_size(size), m_block_size(0), m_size(0), m_pool(pool) {
+  if (size < 16 + trailer_size || memcmp(data, stream_magic, sizeof(stream_magic)) != 0 ||
+      memcmp(data + size - sizeof(stream_magic), stream_magic, sizeof(stream_magic)) != 0) {
+    throw_corrupted("the data is not a finished compressed stream");
+  }
+  m_block_size = load_le<uint32_t>(data + 8);
+  auto name_size = load_le<uint32_t>(data + 12);
+  auto trailer = data + size - trailer_size;
+  auto index_offset = load_le<uint64_t>(trailer);
+  auto count = load_le<uint64_t>(trailer + 8);
+  m_size = static_cast<size_t>(load_le<uint64_t>(trailer + 16));
+  if (m_block_size == 0 || name_size > 255 || 16 + name_size > index_offset ||
+      index_offset > size - trailer_size ||
+      (size - trailer_size - index_offset) != count * sizeof(uint64_t) ||
+      count != (m_size + m_block_size - 1) / m_block_size) {
+    throw_corrupted("the index of the stream is corrupted");
+  }
+  m_codec = Codec::factory_type::get_instance().create(string(data + 16, name_size));
+  m_index.resize(count);
+  for (size_t ii = 0; ii < count; ++ii) {
+    m_index[ii] = load_le<uint64_t>(data + index_offset + ii * sizeof(uint64_t));
+    if (m_index[ii] > index_offset - block_header_size) {
+      throw_corrupted("the index of the stream is corrupted");
+    }
+  }
+}
+
+void CompressedReader::read(size_t offset, size_t size, char *output) const {
+  if (offset > m_size || size > m_size - offset) {
+    throw_corrupted("the range is out of bounds");
+  }
+  if (size == 0) {
+    return;
+  }
+  auto first = offset / m_block_size;
+  auto last = (offset + size - 1) / m_block_size;
+  auto piece = [this, offset, size, output](size_t block) {
+    auto begin = max(offset, block * m_block_size);
+    auto end = min(offset + size, (block + 1) * m_block_size);
+    read_block(block, begin - block * m_block_size, end - begin, output + (begin - offset));
+  };
+  if (first == last) {
+    piece(first);
+    return;
+  }
+  vector<future<void>> tasks;
+  for (auto ii = first; ii <= last; ++ii) {
+    tasks.push_back(m_pool.submit([&piece, ii]() { piece(ii); }));
+  }
+  wait_all(m_pool, tasks);
+}
+
+void CompressedReader::read_block(size_t block, size_t first, size_t size, char *output) const {
+  auto header = m_data + m_index[block];
+  auto stored = load_le<uint32_t>(header);
+  auto original = load_le<uint32_t>(header + 4);
+  auto expected = min(m_block_size, m_size - block * m_block_size);
+  if (original != expected || stored > m_stream_size - m_index[block] - block_header_size) {
+    throw_corrupted("the header of a block is corrupted");
+  }
+  if (first == 0 && size == original) {
+    decode_block(*m_codec, header, output);
+    return;
+  }
+  vector<char> buffer(original);
+  decode_block(*m_codec, header, buffer.data());
+  memcpy(output, buffer.data() + first, size);
+}
+}
@@ -28,15 +28,29 @@
 
 #include <mwheel/dlmanager.h>
 
+#include "elf_file.h"
+
 #include <boost/predef.h>
 
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <thread>
 #include <typeinfo>
 #include <utility>
 
 #ifdef BOOST_OS_UNIX
 #include <dlfcn.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #else
 #error "At present only Unix-like OS are supported"
 #endif
@@ -45,53 +59,1133 @@ using namespace std;
 
 namespace mwheel {
 
-void DLManager::load_library(const boost::filesystem::path &library_path) {
+namespace {
+
+/**
+ * @brief Sets the load context of the current thread during its lifetime
+ */
+class LoadContextGuard {
+public:
+  explicit LoadContextGuard(implementation::LoadContext &context)
+      : m_previous(implementation::set_load_context(&context)) {}
+
+  LoadContextGuard(const LoadContextGuard &) = delete;
+  LoadContextGuard &operator=(const LoadContextGuard &) = delete;
+
+  ~LoadContextGuard() { implementation::set_load_context(m_previous); }
+
+private:
+  implementation::LoadContext *m_previous;
+};
+
+/**
+ * @brief Publishes the updates of the factories batched while loading a library
+ *
+ * Must be called before the library is closed, since the batches may run its code.
+ *
+ * @param[in,out] context load context of the library
+ */
+void publish_batches(implementation::LoadContext &context) { context.batches.clear(); }
+
+/**
+ * @brief Translates load options into `dlopen` flags
+ *
+ * @param[in] options load options
+ *
+ * @throw DLManager::error_loading_dynamic_library if the options are not supported
+ *
+ * @return flags to be passed to `dlopen`
+ */
+int dlopen_flags(const DLManager::LoadOptions &options) {
+  using LoadOptions = DLManager::LoadOptions;
+  auto flags = (options.binding == LoadOptions::Binding::now) ? RTLD_NOW : RTLD_LAZY;
+  flags |= (options.visibility == LoadOptions::Visibility::global) ? RTLD_GLOBAL : RTLD_LOCAL;
+  if (options.no_delete) {
+    flags |= RTLD_NODELETE;
+  }
+  if (options.deep_bind) {
+#ifdef RTLD_DEEPBIND
+    flags |= RTLD_DEEPBIND;
+#else
+    throw DLManager::error_loading_dynamic_library(
+        "ERROR : RTLD_DEEPBIND is not supported on this platform\n");
+#endif
+  }
+  return flags;
+}
+
+/**
+ * @brief Reads the dynamic symbol table and the section headers of a library
+ *
+ * @param[in] library_path path of the library
+ *
+ * @return parsed file, nullptr if it is not an ELF file that can be parsed
+ * (`dlopen` will then report what is wrong)
+ */
+unique_ptr<implementation::ElfFile> scan_library(const boost::filesystem::path &library_path) {
+  try {
+    return unique_ptr<implementation::ElfFile>(new implementation::ElfFile(library_path));
+  } catch (const implementation::ElfFile::invalid_elf_file &) {
+    return nullptr;
+  }
+}
+
+/**
+ * @brief Reads the descriptor exported with MWHEEL_PLUGIN_DESCRIPTOR, without loading the library
+ *
+ * @param[in] library_path path of the library (for error messages)
+ * @param[in] elf parsed library, may be nullptr
+ * @param[out] descriptor copy of the descriptor
+ *
+ * @throw DLManager::incompatible_plugin if the descriptor is defined but its
+ * value is not in the file (e.g. it is initialized at load time)
+ *
+ * @return true if the library has a descriptor, false otherwise
+ */
+bool read_descriptor(const boost::filesystem::path &library_path,
+                     const implementation::ElfFile *elf, PluginDescriptor &descriptor) {
+  auto data = elf ? elf->find_symbol(MWHEEL_PLUGIN_DESCRIPTOR_SYMBOL, sizeof(PluginDescriptor))
+                  : nullptr;
+  if (!data) {
+    if (elf && elf->defines_symbol(MWHEEL_PLUGIN_DESCRIPTOR_SYMBOL)) {
+      stringstream estream;
+      estream << "ERROR : incompatible plug-in " << library_path << endl;
+      estream << "\t" << MWHEEL_PLUGIN_DESCRIPTOR_SYMBOL
+              << " has no constant value in the file, and can't be checked before loading" << endl;
+      throw DLManager::incompatible_plugin(estream.str());
+    }
+    return false;
+  }
+  // The file image needs not be suitably aligned
+  memcpy(&descriptor, data, sizeof(PluginDescriptor));
+  return true;
+}
+
+/**
+ * @brief Checks that a range of memory belongs to the image of a loaded object
+ */
+struct ImageRange {
+  /// Link map of the object
+  const link_map *object;
+  /// Start of the range
+  uintptr_t begin;
+  /// End of the range
+  uintptr_t end;
+  /// Outcome of the check
+  bool contained;
+
+  /**
+   * @brief Callback for `dl_iterate_phdr`
+   *
+   * @return 1 once the object was found (stops the iteration), 0 otherwise
+   */
+  static int visit(dl_phdr_info *info, size_t, void *data) {
+    auto self = static_cast<ImageRange *>(data);
+    if (info->dlpi_addr != self->object->l_addr ||
+        strcmp(info->dlpi_name, self->object->l_name) != 0) {
+      return 0;
+    }
+    for (auto ii = 0; ii < info->dlpi_phnum; ++ii) {
+      const auto &segment = info->dlpi_phdr[ii];
+      auto first = info->dlpi_addr + segment.p_vaddr;
+      if (segment.p_type == PT_LOAD && first <= self->begin &&
+          self->end <= first + segment.p_memsz) {
+        self->contained = true;
+      }
+    }
+    return 1;
+  }
+};
+
+/**
+ * @brief Imports the entries added with MWHEEL_PLUGIN_PRODUCT_TABLE_ENTRY to a loaded library
+ *
+ * The table is located through the function exported by plugin.h, and checked
+ * against the segments of the loaded image: a library that doesn't include
+ * plugin.h would otherwise expose the table of one of its dependencies.
+ *
+ * @param[in] handle handle of the library
+ *
+ * @throw DLManager::error_loading_dynamic_library if some of the entries can't
+ * be registered (e.g. their tags are already taken)
+ */
+void import_product_table(void *handle) {
+  using accessor_type = const ProductDescriptor *(const ProductDescriptor **);
+  link_map *object = nullptr;
+  auto accessor = reinterpret_cast<accessor_type *>(dlsym(handle, MWHEEL_PRODUCT_TABLE_SYMBOL));
+  if (!accessor || dlinfo(handle, RTLD_DI_LINKMAP, &object) != 0 || !object) {
+    return;
+  }
+  const ProductDescriptor *end = nullptr;
+  auto begin = accessor(&end);
+  if (!begin || end <= begin) {
+    return;
+  }
+  ImageRange range{object, reinterpret_cast<uintptr_t>(begin), reinterpret_cast<uintptr_t>(end),
+                   false};
+  dl_iterate_phdr(&ImageRange::visit, &range);
+  if (!range.contained) {
+    return;
+  }
+  vector<string> rejected;
+  for (auto it = begin; it != end; ++it) {
+    if (it->import && !it->import(*it)) {
+      rejected.push_back(it->tag);
+    }
+  }
+  if (!rejected.empty()) {
+    stringstream estream;
+    estream << "tags already registered:";
+    for (const auto &x : rejected) {
+      estream << " \"" << x << "\"";
+    }
+    throw DLManager::error_loading_dynamic_library(estream.str());
+  }
+}
+
+/**
+ * @brief Opens a shared library within a load context, timing the operation
+ *
+ * @param[in,out] context load context of the library
+ * @param[in] library_path path of the library to be opened
+ * @param[in] options how the library is opened
+ * @param[out] timings time spent in each phase of the loading
+ *
+ * @throw DLManager::error_loading_dynamic_library if `dlopen` fails
+ *
+ * @return handle of the library
+ */
+void *open_library(implementation::LoadContext &context,
+                   const boost::filesystem::path &library_path,
+                   const DLManager::LoadOptions &options, DLManager::LoadTimings &timings) {
+  using clock = chrono::steady_clock;
+  auto flags = dlopen_flags(options);
+  void *handle;
+  auto start = clock::now();
+  {
+    LoadContextGuard guard(context);
+    handle = dlopen(library_path.c_str(), flags);
+  }
+  auto end = clock::now();
+  if (!handle) {
+    publish_batches(context);
+    stringstream estream;
+    estream << "ERROR : cannot load shared library " << library_path << endl;
+    estream << "\t" << dlerror() << endl;
+    throw DLManager::error_loading_dynamic_library(estream.str());
+  }
+  // Static initialization begins with the hook added by plugin.h
+  auto initialization_start = context.initialization_started ? context.initialization_start : end;
+  timings.dlopen = chrono::duration_cast<chrono::nanoseconds>(end - start);
+  timings.relocation = chrono::duration_cast<chrono::nanoseconds>(initialization_start - start);
+  timings.static_initialization =
+      chrono::duration_cast<chrono::nanoseconds>(end - initialization_start);
+  try {
+    LoadContextGuard guard(context);
+    import_product_table(handle);
+  } catch (const exception &error) {
+    // Undo what was imported so far: the library is going away
+    for (const auto &x : context.retire) {
+      x();
+    }
+    context.retire.clear();
+    context.staged.clear();
+    publish_batches(context);
+    dlclose(handle);
+    stringstream estream;
+    estream << "ERROR : cannot import the table of products of shared library " << library_path
+            << endl;
+    estream << "\t" << error.what() << endl;
+    throw DLManager::error_loading_dynamic_library(estream.str());
+  }
+  publish_batches(context);
+  timings.table_import = chrono::duration_cast<chrono::nanoseconds>(clock::now() - end);
+  return handle;
+}
+
+/**
+ * @brief Returns the load address of a library
+ *
+ * @param[in] handle handle of the library
+ *
+ * @return load address of the library, 0 if it can't be determined
+ */
+uintptr_t load_address(void *handle) {
+  link_map *object = nullptr;
+  if (dlinfo(handle, RTLD_DI_LINKMAP, &object) != 0 || !object) {
+    return 0;
+  }
+  return object->l_addr;
+}
+
+/**
+ * @brief Opens again an instance of a library that stayed resident after it
+ * was unloaded, registering its products once more
+ *
+ * @param[in,out] context load context of the library
+ * @param[in] library_path path of the library
+ * @param[in] base load address of the instance that was unloaded
+ * @param[in] restore entries that register the products of the instance
+ * @param[in] options how the library is opened
+ * @param[out] timings time spent in each phase of the loading
+ *
+ * @throw DLManager::error_loading_dynamic_library if the products can't be registered
+ *
+ * @return handle of the library, nullptr if the instance is not resident anymore
+ */
+void *reopen_library(implementation::LoadContext &context,
+                     const boost::filesystem::path &library_path, uintptr_t base,
+                     const vector<implementation::RestoreEntry> &restore,
+                     const DLManager::LoadOptions &options, DLManager::LoadTimings &timings) {
+  using clock = chrono::steady_clock;
+  auto start = clock::now();
+  auto handle = dlopen(library_path.c_str(), dlopen_flags(options) | RTLD_NOLOAD);
+  if (!handle) {
+    return nullptr;
+  }
+  // The entries point into the static storage of that very instance
+  if (load_address(handle) != base) {
+    dlclose(handle);
+    return nullptr;
+  }
+  auto end = clock::now();
+  timings.dlopen = chrono::duration_cast<chrono::nanoseconds>(end - start);
+  timings.relocation = timings.dlopen;
+  timings.static_initialization = chrono::nanoseconds(0);
+  try {
+    LoadContextGuard guard(context);
+    for (const auto &x : restore) {
+      x.restore(x.data);
+    }
+  } catch (const exception &error) {
+    for (const auto &x : context.retire) {
+      x();
+    }
+    context.retire.clear();
+    publish_batches(context);
+    dlclose(handle);
+    stringstream estream;
+    estream << "ERROR : cannot register again the products of shared library " << library_path
+            << endl;
+    estream << "\t" << error.what() << endl;
+    throw DLManager::error_loading_dynamic_library(estream.str());
+  }
+  publish_batches(context);
+  timings.table_import = chrono::duration_cast<chrono::nanoseconds>(clock::now() - end);
+  return handle;
+}
+
+/**
+ * @brief Closes a library when the last reference to it is dropped
+ */
+struct LibraryLease {
+  /// Handle of the library, nullptr if it must not be closed
+  atomic<void *> handle{nullptr};
+
+  ~LibraryLease() {
+    auto library = handle.exchange(nullptr);
+    if (library) {
+      dlclose(library);
+    }
+  }
+};
+
+/**
+ * @brief Moves what was recorded in a load context to the record of a library
+ *
+ * @param[in,out] context load context
+ * @param[in] handle handle of the library
+ * @param[out] record record of the library
+ */
+template <class Record>
+void fill_record(implementation::LoadContext &context, void *handle, Record &record) {
+  static_cast<LibraryLease *>(context.lifetime.get())->handle = handle;
+  record.handle = handle;
+  record.lifetime = std::move(context.lifetime);
+  record.products = std::move(context.products);
+  record.retire = std::move(context.retire);
+  record.restore = std::move(context.restore);
+  record.base = load_address(handle);
+}
+
+/**
+ * @brief Warms up the segments of the object loaded at a given address
+ */
+struct SegmentWarmer {
+  /// Link map of the object to be warmed up
+  const link_map *object;
+  /// What is done with the pages
+  DLManager::WarmUpOptions options;
+  /// Outcome of the warm-up
+  DLManager::WarmUpReport report;
+
+  /**
+   * @brief Callback for `dl_iterate_phdr`
+   *
+   * @return 1 once the object was found and warmed up (stops the iteration), 0 otherwise
+   */
+  static int visit(dl_phdr_info *info, size_t, void *data) {
+    auto self = static_cast<SegmentWarmer *>(data);
+    if (info->dlpi_addr != self->object->l_addr ||
+        strcmp(info->dlpi_name, self->object->l_name) != 0) {
+      return 0;
+    }
+    for (auto ii = 0; ii < info->dlpi_phnum; ++ii) {
+      const auto &segment = info->dlpi_phdr[ii];
+      if (segment.p_type == PT_LOAD && (segment.p_flags & PF_R) && segment.p_memsz > 0) {
+        self->warm(info->dlpi_addr + segment.p_vaddr, segment.p_memsz, segment.p_flags & PF_X);
+      }
+    }
+    return 1;
+  }
+
+  /**
+   * @brief Warms up a range of memory
+   *
+   * @param[in] address start of the range
+   * @param[in] size size of the range
+   * @param[in] executable whether the range contains code
+   */
+  void warm(uintptr_t address, size_t size, bool executable) {
+    static const auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    auto first = address & ~(page_size - 1);
+    auto last = (address + size + page_size - 1) & ~(page_size - 1);
+    auto begin = reinterpret_cast<char *>(first);
+    auto length = static_cast<size_t>(last - first);
+    auto pages = length / page_size;
+    madvise(begin, length, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+    if (executable && options.huge_pages && madvise(begin, length, MADV_HUGEPAGE) == 0) {
+      report.huge_pages += pages;
+    }
+#endif
+    if (options.lock && mlock(begin, length) == 0) {
+      // mlock faults the pages in by itself
+      report.locked_pages += pages;
+      report.pages += pages;
+      return;
+    }
+    for (auto page = first; page < last; page += page_size) {
+      *reinterpret_cast<volatile const char *>(page);
+    }
+    report.pages += pages;
+  }
+};
+
+/**
+ * @brief Checks whether a shared library is resident in the process
+ *
+ * @param[in] library_path path of the library
+ *
+ * @return true if the library is mapped in the process
+ */
+bool is_resident(const boost::filesystem::path &library_path) {
+  auto handle = dlopen(library_path.c_str(), RTLD_LAZY | RTLD_NOLOAD);
+  if (handle) {
+    dlclose(handle);
+  }
+  return handle != nullptr;
+}
+
+/**
+ * @brief Private copy of a shared library, removed at destruction
+ *
+ * `dlopen` returns the object already resident if given the same file again:
+ * loading a copy is the only way to get a fresh instance of a library.
+ */
+class PrivateCopy {
+public:
+  /**
+   * @brief Copies a library to a unique temporary path
+   *
+   * @param[in] library_path path of the library
+   *
+   * @throw DLManager::error_loading_dynamic_library if the copy fails
+   */
+  explicit PrivateCopy(const boost::filesystem::path &library_path)
+      : m_path(boost::filesystem::temp_directory_path() /
+               boost::filesystem::unique_path("%%%%-%%%%-%%%%-%%%%-" +
+                                              library_path.filename().string())) {
+    boost::system::error_code error;
+    boost::filesystem::copy_file(library_path, m_path, error);
+    if (error) {
+      stringstream estream;
+      estream << "ERROR : cannot load a fresh instance of shared library " << library_path << endl;
+      estream << "\t" << error.message() << endl;
+      throw DLManager::error_loading_dynamic_library(estream.str());
+    }
+  }
+
+  PrivateCopy(const PrivateCopy &) = delete;
+  PrivateCopy &operator=(const PrivateCopy &) = delete;
+
+  /// The copy is not needed once it was opened
+  ~PrivateCopy() {
+    boost::system::error_code error;
+    boost::filesystem::remove(m_path, error);
+  }
+
+  /**
+   * @brief Returns the path of the copy
+   */
+  const boost::filesystem::path &path() const { return m_path; }
+
+private:
+  /// Path of the copy
+  boost::filesystem::path m_path;
+};
+
+/**
+ * @brief Calls a function for each index in [0, n) using a bounded number of threads
+ *
+ * @param[in] n number of indices
+ * @param[in] function function to be called (must not throw)
+ */
+template <class F> void parallel_for(size_t n, F function) {
+  auto nthreads = min<size_t>(n, max(1u, thread::hardware_concurrency()));
+  atomic<size_t> next(0);
+  vector<future<void>> workers;
+  for (size_t ii = 0; ii < nthreads; ++ii) {
+    workers.push_back(async(launch::async, [&]() {
+      for (auto jj = next++; jj < n; jj = next++) {
+        function(jj);
+      }
+    }));
+  }
+  for (auto &x : workers) {
+    x.get();
+  }
+}
+}
+
+DLManager::LoadTimings DLManager::load_library(const boost::filesystem::path &library_path,
+                                               const LoadOptions &options) {
 #ifdef BOOST_OS_UNIX
-  auto handle = dlopen(library_path.c_str(), RTLD_LAZY);
+  return load_single(library_path, {}, options);
+#else
+  return LoadTimings();
+#endif
+}
+
+DLManager::LoadTimings DLManager::load_single(const boost::filesystem::path &library_path,
+                                              vector<boost::filesystem::path> dependencies,
+                                              const LoadOptions &options) {
+  promise<LoadTimings> outcome;
+  bool retired;
+  unique_ptr<UnloadedInstance> unloaded;
+  {
+    unique_lock<mutex> lock(m_write_mutex);
+    if (find_record(library_path)) {
+      return LoadTimings();
+    }
+    auto in_flight = m_in_flight.find(library_path);
+    if (in_flight != m_in_flight.end()) {
+      if (in_flight->second.loader == this_thread::get_id()) {
+        stringstream estream;
+        estream << "ERROR : cannot load shared library " << library_path << endl;
+        estream << "\tit is already being loaded by the calling thread" << endl;
+        throw error_loading_dynamic_library(estream.str());
+      }
+      // Wait for the load in progress
+      auto pending = in_flight->second.outcome;
+      lock.unlock();
+      return pending.get();
+    }
+    m_in_flight[library_path] = InFlightLoad{this_thread::get_id(), outcome.get_future().share()};
+    retired = m_retired.count(library_path) != 0;
+    auto it = m_unloaded.find(library_path);
+    if (it != m_unloaded.end()) {
+      unloaded.reset(new UnloadedInstance(it->second));
+    }
+  }
+  try {
+    implementation::LoadContext context;
+    context.lifetime = make_shared<LibraryLease>();
+    LoadTimings timings;
+    auto record = make_shared<LibraryRecord>();
+    void *handle = nullptr;
+    if (unloaded) {
+      // An instance unloaded earlier may still be resident (never unmapped, or
+      // held by something else): its initializers wouldn't run again, so reuse it
+      auto elf = scan_library(library_path);
+      PluginDescriptor descriptor;
+      auto described = read_descriptor(library_path, elf.get(), descriptor);
+      check_compatibility(library_path, described ? &descriptor : nullptr, options);
+      handle = reopen_library(context, library_path, unloaded->base, unloaded->restore, options,
+                              timings);
+    }
+    if (!handle) {
+      // A resident instance that can't be reused needs a copy to get a fresh one
+      auto fresh_instance = retired && is_resident(library_path);
+      if (retired && !fresh_instance) {
+        lock_guard<mutex> lock(m_write_mutex);
+        m_retired.erase(library_path);
+      }
+      unique_ptr<PrivateCopy> copy(fresh_instance ? new PrivateCopy(library_path) : nullptr);
+      const auto &source = copy ? copy->path() : library_path;
+      auto elf = scan_library(source);
+      PluginDescriptor descriptor;
+      auto described = read_descriptor(library_path, elf.get(), descriptor);
+      check_compatibility(library_path, described ? &descriptor : nullptr, options);
+      handle = open_library(context, source, options, timings);
+      record->reusable = !copy;
+    } else {
+      record->reusable = true;
+    }
+    fill_record(context, handle, *record);
+    record->options = options;
+    record->dependencies = std::move(dependencies);
+    {
+      lock_guard<mutex> lock(m_write_mutex);
+      record->sequence = m_next_sequence++;
+      publish(library_path, std::move(record));
+      m_in_flight.erase(library_path);
+      m_unloaded.erase(library_path);
+    }
+    outcome.set_value(timings);
+    return timings;
+  } catch (...) {
+    {
+      lock_guard<mutex> lock(m_write_mutex);
+      m_in_flight.erase(library_path);
+    }
+    outcome.set_exception(current_exception());
+    throw;
+  }
+}
+
+void DLManager::reload_library(const boost::filesystem::path &library_path,
+                               const boost::filesystem::path &replacement_path) {
+#ifdef BOOST_OS_UNIX
+  lock_guard<mutex> update_lock(m_update_mutex);
+  auto old_record = find_record(library_path);
+  if (!old_record) {
+    stringstream estream;
+    estream << "ERROR : cannot reload a shared library that was not previously loaded "
+            << library_path << endl;
+    throw library_not_loaded(estream.str());
+  }
+  // dlopen returns the object already loaded if given the same file again, so
+  // in that case a private copy is loaded instead
+  auto source = replacement_path.empty() ? library_path : replacement_path;
+  boost::system::error_code error;
+  unique_ptr<PrivateCopy> copy;
+  if (boost::filesystem::equivalent(source, library_path, error) && !error) {
+    copy.reset(new PrivateCopy(source));
+    source = copy->path();
+  }
+  auto elf = scan_library(source);
+  PluginDescriptor descriptor;
+  auto described = read_descriptor(library_path, elf.get(), descriptor);
+  check_compatibility(library_path, described ? &descriptor : nullptr, old_record->options);
+  // Load the new version side by side with the old one, staging its registrations
+  implementation::LoadContext context;
+  context.lifetime = make_shared<LibraryLease>();
+  context.stage_registrations = true;
+  LoadTimings timings;
+  auto handle = open_library(context, source, old_record->options, timings);
+  copy.reset();
+  // Switch each product to the new version in a single step, then remove
+  // whatever the old version registered and the new one doesn't provide
+  {
+    LoadContextGuard guard(context);
+    for (const auto &x : context.staged) {
+      x();
+    }
+  }
+  context.staged.clear();
+  publish_batches(context);
+  auto record = make_shared<LibraryRecord>();
+  fill_record(context, handle, *record);
+  record->options = old_record->options;
+  record->dependencies = old_record->dependencies;
+  record->sequence = old_record->sequence;
+  {
+    lock_guard<mutex> lock(m_write_mutex);
+    publish(library_path, std::move(record));
+  }
+  retire_registrations(*old_record);
+  auto lifetime = old_record->lifetime;
+  old_record.reset();
+  release_library(library_path, std::move(lifetime));
+#endif
+}
+
+void DLManager::retire_registrations(const LibraryRecord &record) {
+  for (const auto &x : record.retire) {
+    x();
+  }
+}
+
+void DLManager::release_library(const boost::filesystem::path &library_path,
+                                shared_ptr<void> lifetime) {
+  // Once the registrations are retired and the record is unpublished nobody can
+  // acquire a new reference, so if this is the only one the library can be
+  // closed here, reporting errors
+  if (lifetime.use_count() == 1) {
+    auto handle = static_cast<LibraryLease *>(lifetime.get())->handle.exchange(nullptr);
+    lifetime.reset();
+    if (dlclose(handle)) {
+      stringstream estream;
+      estream << "ERROR : cannot unload shared library " << library_path << endl;
+      estream << "\t" << dlerror() << endl;
+      throw error_unloading_dynamic_library(estream.str());
+    }
+  }
+  // Otherwise the last product (or reader of an old snapshot) will close it
+}
+
+DLManager::record_pointer
+DLManager::find_record(const boost::filesystem::path &library_path) const {
+  ReadCopyUpdate::ReadGuard guard(m_rcu);
+  auto snapshot = m_snapshot.load();
+  auto it = snapshot->find(library_path);
+  return it != snapshot->end() ? it->second : nullptr;
+}
+
+void DLManager::publish(const boost::filesystem::path &library_path, record_pointer record) {
+  unique_ptr<DLMap> snapshot(new DLMap(*m_snapshot.load()));
+  if (record) {
+    (*snapshot)[library_path] = std::move(record);
+  } else {
+    snapshot->erase(library_path);
+  }
+  replace_snapshot(std::move(snapshot));
+}
+
+unique_ptr<const DLManager::DLMap>
+DLManager::replace_snapshot(unique_ptr<const DLMap> snapshot) {
+  unique_ptr<const DLMap> old_snapshot(m_snapshot.exchange(snapshot.release()));
+  m_rcu.synchronize();
+  return old_snapshot;
+}
+
+void DLManager::remember_unloaded(const boost::filesystem::path &library_path,
+                                  const LibraryRecord &record) {
+  lock_guard<mutex> lock(m_write_mutex);
+  if (record.reusable && record.base != 0) {
+    m_unloaded[library_path] = UnloadedInstance{record.base, record.restore};
+  } else {
+    m_unloaded.erase(library_path);
+  }
+}
+
+void DLManager::require_descriptor(const PluginDescriptor &descriptor) {
+  lock_guard<mutex> lock(m_required_mutex);
+  m_required[descriptor.interface_hash] = descriptor;
+}
+
+void DLManager::check_compatibility(const boost::filesystem::path &library_path,
+                                    const PluginDescriptor *descriptor,
+                                    const LoadOptions &options) const {
+  stringstream estream;
+  estream << "ERROR : incompatible plug-in " << library_path << endl;
+  if (!descriptor) {
+    if (options.require_descriptor) {
+      estream << "\tthe library doesn't define " << MWHEEL_PLUGIN_DESCRIPTOR_SYMBOL << endl;
+      throw incompatible_plugin(estream.str());
+    }
+    return;
+  }
+  if (descriptor->magic != implementation::plugin_descriptor_magic) {
+    estream << "\tthe layout of the plug-in descriptor is not supported" << endl;
+    throw incompatible_plugin(estream.str());
+  }
+  PluginDescriptor required;
+  {
+    lock_guard<mutex> lock(m_required_mutex);
+    auto it = m_required.find(descriptor->interface_hash);
+    if (it == m_required.end()) {
+      return;
+    }
+    required = it->second;
+  }
+  if (descriptor->abi != implementation::abi_tag()) {
+    estream << "\tthe library was compiled for a different C++ ABI" << endl;
+    throw incompatible_plugin(estream.str());
+  }
+  if (descriptor->tag_type_hash != required.tag_type_hash) {
+    estream << "\tthe factory of the interface uses a different tag type" << endl;
+    throw incompatible_plugin(estream.str());
+  }
+  const auto &version = descriptor->version;
+  if (version.major_version != required.version.major_version ||
+      version.minor_version > required.version.minor_version) {
+    estream << "\tversion " << version.major_version << "." << version.minor_version << "."
+            << version.patch_version << " of the interface can't be used by version "
+            << required.version.major_version << "." << required.version.minor_version << "."
+            << required.version.patch_version << endl;
+    throw incompatible_plugin(estream.str());
+  }
+}
+
+bool DLManager::is_loaded(const boost::filesystem::path &library_path) const {
+  return find_record(library_path) != nullptr;
+}
+
+void *DLManager::find_symbol(const boost::filesystem::path &library_path, const string &name) {
+  // Holding the record keeps the library loaded
+  auto record = find_record(library_path);
+  if (!record) {
+    stringstream estream;
+    estream << "ERROR : shared library " << library_path << " was not previously loaded" << endl;
+    throw library_not_loaded(estream.str());
+  }
+  {
+    ReadCopyUpdate::ReadGuard guard(m_rcu);
+    auto symbols = record->symbols.load();
+    if (symbols) {
+      auto cached = symbols->find(name);
+      if (cached != symbols->end()) {
+        return cached->second;
+      }
+    }
+  }
+  // A symbol may legitimately resolve to nullptr: only dlerror tells failures apart
+  dlerror();
+  auto address = dlsym(record->handle, name.c_str());
   auto error_message = dlerror();
   if (error_message) {
     stringstream estream;
-    estream << "ERROR : cannot load shared library " << library_path << endl;
+    estream << "ERROR : cannot find symbol \"" << name << "\" in shared library " << library_path
+            << endl;
     estream << "\t" << error_message << endl;
-    throw error_loading_dynamic_library(estream.str());
+    throw symbol_not_found(estream.str());
   }
-  m_dl_map.insert(make_pair(library_path, handle));
-#endif
+  lock_guard<mutex> lock(record->symbols_mutex);
+  unique_ptr<const LibraryRecord::symbol_map_type> symbols(record->symbols.load());
+  unique_ptr<LibraryRecord::symbol_map_type> updated(
+      symbols ? new LibraryRecord::symbol_map_type(*symbols)
+              : new LibraryRecord::symbol_map_type());
+  updated->insert(make_pair(name, address));
+  record->symbols = updated.release();
+  // The old cache goes once no reader can see it
+  m_rcu.synchronize();
+  return address;
+}
+
+void DLManager::bind(const boost::filesystem::path &library_path,
+                     const vector<SymbolBinding> &table) {
+  vector<void *> addresses;
+  vector<string> missing;
+  for (const auto &x : table) {
+    try {
+      addresses.push_back(find_symbol(library_path, x.name));
+    } catch (const symbol_not_found &) {
+      missing.push_back(x.name);
+    }
+  }
+  if (!missing.empty()) {
+    stringstream estream;
+    estream << "ERROR : cannot bind symbols of shared library " << library_path << endl;
+    for (const auto &x : missing) {
+      estream << "\tmissing symbol \"" << x << "\"" << endl;
+    }
+    throw symbol_not_found(estream.str());
+  }
+  for (size_t ii = 0; ii < table.size(); ++ii) {
+    table[ii].assign(addresses[ii]);
+  }
+}
+
+DLManager::WarmUpReport DLManager::warm_up(const boost::filesystem::path &library_path,
+                                           const WarmUpOptions &options) {
+  // Holding the record keeps the library loaded
+  auto record = find_record(library_path);
+  if (!record) {
+    stringstream estream;
+    estream << "ERROR : shared library " << library_path << " was not previously loaded" << endl;
+    throw library_not_loaded(estream.str());
+  }
+  link_map *object = nullptr;
+  SegmentWarmer warmer{nullptr, options, WarmUpReport{0, 0, 0}};
+  if (dlinfo(record->handle, RTLD_DI_LINKMAP, &object) == 0 && object) {
+    warmer.object = object;
+    dl_iterate_phdr(SegmentWarmer::visit, &warmer);
+  }
+  return warmer.report;
+}
+
+vector<PluginProduct>
+DLManager::registered_products(const boost::filesystem::path &library_path) const {
+  auto record = find_record(library_path);
+  if (!record) {
+    stringstream estream;
+    estream << "ERROR : shared library " << library_path << " was not previously loaded" << endl;
+    throw library_not_loaded(estream.str());
+  }
+  return record->products;
+}
+
+DLManager::batch_report_type
+DLManager::load_batch(const vector<boost::filesystem::path> &library_paths,
+                      const dependency_manifest_type &manifest,
+                      const LoadOptions &options) {
+  // Libraries in the batch, without duplicates
+  vector<boost::filesystem::path> libraries;
+  map<boost::filesystem::path, size_t> index;
+  for (const auto &x : library_paths) {
+    if (index.insert(make_pair(x, libraries.size())).second) {
+      libraries.push_back(x);
+    }
+  }
+  auto nlibraries = libraries.size();
+  // Scan the dynamic sections and warm the page cache concurrently. A file that
+  // can't be scanned is still handed to dlopen, which will report the error.
+  vector<vector<string>> needed(nlibraries);
+  vector<string> soname(nlibraries);
+  parallel_for(nlibraries, [&](size_t ii) {
+    if (is_loaded(libraries[ii])) {
+      return;
+    }
+    try {
+      implementation::ElfFile::prefetch(libraries[ii]);
+      implementation::ElfFile elf(libraries[ii]);
+      needed[ii] = elf.needed();
+      soname[ii] = elf.soname();
+    } catch (const implementation::ElfFile::invalid_elf_file &) {
+    }
+  });
+  // Build the dependency graph among the libraries in the batch
+  map<string, size_t> by_name;
+  for (size_t ii = 0; ii < nlibraries; ++ii) {
+    by_name.insert(make_pair(libraries[ii].filename().string(), ii));
+    if (!soname[ii].empty()) {
+      by_name.insert(make_pair(soname[ii], ii));
+    }
+  }
+  auto lookup = [&](const boost::filesystem::path &name, size_t &position) {
+    auto it = index.find(name);
+    if (it != index.end()) {
+      position = it->second;
+      return true;
+    }
+    auto jt = by_name.find(name.filename().string());
+    if (jt != by_name.end()) {
+      position = jt->second;
+      return true;
+    }
+    return false;
+  };
+  vector<set<size_t>> dependencies(nlibraries);
+  for (size_t ii = 0; ii < nlibraries; ++ii) {
+    size_t position;
+    for (const auto &x : needed[ii]) {
+      if (lookup(x, position) && position != ii) {
+        dependencies[ii].insert(position);
+      }
+    }
+  }
+  for (const auto &x : manifest) {
+    size_t library;
+    if (!lookup(x.first, library)) {
+      continue;
+    }
+    for (const auto &y : x.second) {
+      size_t position;
+      if (lookup(y, position) && position != library) {
+        dependencies[library].insert(position);
+      }
+    }
+  }
+  // Topological sort (Kahn's algorithm, stable with respect to the request order)
+  vector<size_t> missing(nlibraries);
+  vector<vector<size_t>> dependents(nlibraries);
+  deque<size_t> ready;
+  for (size_t ii = 0; ii < nlibraries; ++ii) {
+    missing[ii] = dependencies[ii].size();
+    for (auto x : dependencies[ii]) {
+      dependents[x].push_back(ii);
+    }
+    if (missing[ii] == 0) {
+      ready.push_back(ii);
+    }
+  }
+  vector<unique_ptr<Expected<LoadTimings>>> outcome(nlibraries);
+  while (!ready.empty()) {
+    auto ii = ready.front();
+    ready.pop_front();
+    for (auto x : dependents[ii]) {
+      if (--missing[x] == 0) {
+        ready.push_back(x);
+      }
+    }
+    // Skip libraries that were already loaded
+    if (is_loaded(libraries[ii])) {
+      outcome[ii].reset(new Expected<LoadTimings>(LoadTimings()));
+      continue;
+    }
+    // Don't even try if a dependency failed
+    auto failed = find_if(dependencies[ii].begin(), dependencies[ii].end(),
+                          [&](size_t x) { return !outcome[x]->valid(); });
+    if (failed != dependencies[ii].end()) {
+      stringstream estream;
+      estream << "ERROR : cannot load shared library " << libraries[ii] << endl;
+      estream << "\tits dependency " << libraries[*failed] << " failed to load" << endl;
+      outcome[ii].reset(new Expected<LoadTimings>(
+          Expected<LoadTimings>::from_exception(error_loading_dynamic_library(estream.str()))));
+      continue;
+    }
+    outcome[ii].reset(new Expected<LoadTimings>(Expected<LoadTimings>::from_code([&]() {
+      vector<boost::filesystem::path> record_dependencies;
+      for (auto x : dependencies[ii]) {
+        record_dependencies.push_back(libraries[x]);
+      }
+      return load_single(libraries[ii], std::move(record_dependencies), options);
+    })));
+  }
+  // Whatever is left is part of a cycle
+  for (size_t ii = 0; ii < nlibraries; ++ii) {
+    if (!outcome[ii]) {
+      stringstream estream;
+      estream << "ERROR : cannot load shared library " << libraries[ii] << endl;
+      estream << "\tit is part of a circular dependency" << endl;
+      outcome[ii].reset(new Expected<LoadTimings>(
+          Expected<LoadTimings>::from_exception(error_loading_dynamic_library(estream.str()))));
+    }
+  }
+  batch_report_type report;
+  for (const auto &x : library_paths) {
+    report.emplace_back(x, *outcome[index[x]]);
+  }
+  return report;
 }
 
 void DLManager::unload_library(const boost::filesystem::path &library_path) {
 #ifdef BOOST_OS_UNIX
-  auto it = DLMap::iterator(m_dl_map.find(library_path));
+  lock_guard<mutex> update_lock(m_update_mutex);
+  auto record = find_record(library_path);
   // The library was not found
-  if (it == m_dl_map.end()) {
+  if (!record) {
     stringstream estream;
     estream << "ERROR : cannot trying to unload a shared library that was not previously loaded "
             << library_path << endl;
     estream << "\tDid you use a wrong name for the library to be unloaded?" << endl;
     throw library_not_loaded(estream.str());
   }
-  // Close the library
-  if (dlclose(it->second)) {
-    auto error_message = dlerror();
-    stringstream estream;
-    estream << "ERROR : cannot unload shared library " << library_path << endl;
-    estream << "\t" << error_message << endl;
-    throw error_unloading_dynamic_library(estream.str());
+  {
+    lock_guard<mutex> lock(m_write_mutex);
+    publish(library_path, nullptr);
+    m_retired.insert(library_path);
   }
-  m_dl_map.erase(it);
+  // Close the library
+  retire_registrations(*record);
+  remember_unloaded(library_path, *record);
+  auto lifetime = record->lifetime;
+  record.reset();
+  release_library(library_path, std::move(lifetime));
 #endif
 }
 
-DLManager::~DLManager() {
+vector<DLManager::UnloadError> DLManager::unload_all(const TeardownOptions &options) {
+  vector<UnloadError> errors;
 #ifdef BOOST_OS_UNIX
-  for (auto &x : m_dl_map) {
-    dlclose(x.second);
-    auto error_message = dlerror();
-    if (error_message) {
-      cerr << "ERROR : cannot unload shared library " << x.first << endl;
-      cerr << "\t" << error_message << endl;
+  lock_guard<mutex> update_lock(m_update_mutex);
+  // Unpublish everything at once
+  vector<pair<boost::filesystem::path, record_pointer>> records;
+  {
+    lock_guard<mutex> lock(m_write_mutex);
+    auto snapshot = replace_snapshot(unique_ptr<const DLMap>(new DLMap()));
+    for (const auto &x : *snapshot) {
+      records.push_back(x);
+      m_retired.insert(x.first);
+    }
+  }
+  // Most recent loads first
+  sort(records.begin(), records.end(),
+       [](const pair<boost::filesystem::path, record_pointer> &x,
+          const pair<boost::filesystem::path, record_pointer> &y) {
+         return x.second->sequence > y.second->sequence;
+       });
+  // A library can go once all the libraries that depend on it are gone. Only
+  // explicit dependencies matter: those expressed by DT_NEEDED entries are
+  // enforced by the reference counts of the dynamic linker.
+  auto nrecords = records.size();
+  map<boost::filesystem::path, size_t> index;
+  for (size_t ii = 0; ii < nrecords; ++ii) {
+    index[records[ii].first] = ii;
+  }
+  vector<vector<size_t>> dependencies(nrecords);
+  vector<size_t> dependents(nrecords, 0);
+  for (size_t ii = 0; ii < nrecords; ++ii) {
+    for (const auto &x : records[ii].second->dependencies) {
+      auto it = index.find(x);
+      if (it != index.end()) {
+        dependencies[ii].push_back(it->second);
+        ++dependents[it->second];
+      }
+    }
+  }
+  vector<unique_ptr<UnloadError>> failures(nrecords);
+  auto teardown = [&](size_t ii) {
+    auto &record = records[ii].second;
+    try {
+      retire_registrations(*record);
+      remember_unloaded(records[ii].first, *record);
+      if (options.skip_dlclose) {
+        // The library stays mapped until the process exits
+        static_cast<LibraryLease *>(record->lifetime.get())->handle.exchange(nullptr);
+        record.reset();
+        return;
+      }
+      auto lifetime = record->lifetime;
+      record.reset();
+      release_library(records[ii].first, std::move(lifetime));
+    } catch (const exception &error) {
+      failures[ii].reset(new UnloadError{records[ii].first, error.what()});
+    }
+  };
+  // Tear down in waves of libraries that don't depend on each other
+  vector<bool> done(nrecords, false);
+  for (size_t ndone = 0; ndone < nrecords;) {
+    vector<size_t> wave;
+    for (size_t ii = 0; ii < nrecords; ++ii) {
+      if (!done[ii] && dependents[ii] == 0) {
+        wave.push_back(ii);
+      }
+    }
+    if (wave.empty()) {
+      // Dependencies are acyclic by construction: fall back to load order if not
+      for (size_t ii = 0; ii < nrecords; ++ii) {
+        if (!done[ii]) {
+          wave.push_back(ii);
+        }
+      }
+    }
+    if (options.parallel && wave.size() > 1) {
+      parallel_for(wave.size(), [&](size_t ii) { teardown(wave[ii]); });
+    } else {
+      for (auto ii : wave) {
+        teardown(ii);
+      }
+    }
+    for (auto ii : wave) {
+      done[ii] = true;
+      for (auto x : dependencies[ii]) {
+        --dependents[x];
+      }
+    }
+    ndone += wave.size();
+  }
+  for (auto &x : failures) {
+    if (x) {
+      errors.push_back(std::move(*x));
     }
   }
 #endif
+  return errors;
+}
+
+DLManager::DLManager() : m_snapshot(new DLMap()), m_next_sequence(0) {}
+
+DLManager::~DLManager() {
+  // No thread is spawned from a destructor, which must not throw
+  TeardownOptions options;
+  options.parallel = false;
+  try {
+    unload_all(options);
+  } catch (...) {
+  }
+  delete m_snapshot.load();
 }
 }
@@ -0,0 +1,372 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/durable_file.h>
+
+#include "file_format.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace mwheel {
+
+namespace {
+
+using implementation::checksum;
+using implementation::directory_of;
+using implementation::load_le;
+using implementation::store_le;
+using implementation::sync_directory;
+
+/// First bytes of every incremental file
+const char incremental_magic[8] = {'M', 'W', 'I', 'N', 'C', 'R', 'M', 'T'};
+/// Size of the header of an incremental file
+const size_t header_size = 32;
+/// Offset of the first block, aligned to a page
+const uint64_t data_offset = 4096;
+/// Directory that names the open file descriptors of the process
+const char proc_fd_directory[] = "/proc/self/fd";
+/// Largest block size accepted from the header of a file (blocks are buffered in memory)
+const uint64_t max_block_size = uint64_t(1) << 30;
+
+/**
+ * @brief Throws an exception that reports the last system error
+ *
+ * @tparam Error type of the exception
+ *
+ * @param[in] path path of the file
+ * @param[in] operation what was being done
+ */
+template <class Error>
+[[noreturn]] void throw_system_error(const boost::filesystem::path &path, const char *operation) {
+  auto error = errno;
+  stringstream estream;
+  estream << "ERROR : cannot " << operation << " " << path << endl;
+  estream << "\t" << strerror(error) << endl;
+  throw Error(estream.str());
+}
+
+/**
+ * @brief Returns a name for a hidden temporary file next to a file
+ */
+boost::filesystem::path temporary_name(const boost::filesystem::path &path) {
+  return directory_of(path) /
+         boost::filesystem::unique_path("." + path.filename().string() + ".%%%%-%%%%-%%%%");
+}
+
+/**
+ * @brief Writes a whole buffer at an offset
+ *
+ * @return false if the buffer can't be written
+ */
+bool pwrite_fully(int fd, const char *data, size_t size, uint64_t offset) {
+  while (size > 0) {
+    auto n = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+  return true;
+}
+
+/**
+ * @brief Reads a whole buffer at an offset
+ *
+ * @return false if the buffer can't be read, or the file ends first
+ */
+bool pread_fully(int fd, char *data, size_t size, uint64_t offset) {
+  while (size > 0) {
+    auto n = ::pread(fd, data, size, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (n == 0) {
+      errno = EIO;
+      return false;
+    }
+    data += n;
+    size -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+  return true;
+}
+}
+
+AtomicFileSink::AtomicFileSink(const boost::filesystem::path &path) : m_path(path), m_fd(-1) {
+#ifdef O_TMPFILE
+  // An anonymous file is named through /proc at commit time, which may not be mounted
+  if (::access(proc_fd_directory, X_OK) == 0) {
+    m_fd = ::open(directory_of(path).c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0644);
+  }
+#endif
+  // Not every file system supports anonymous files
+  if (m_fd < 0) {
+    m_temporary = temporary_name(path);
+    m_fd = ::open(m_temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+      throw_system_error<commit_error>(m_temporary, "create");
+    }
+  }
+}
+
+void AtomicFileSink::write(const void *data, size_t size) {
+  ConstBuffer buffer{data, size};
+  write(&buffer, 1);
+}
+
+void AtomicFileSink::write(const ConstBuffer *buffers, size_t count) {
+  if (m_fd < 0) {
+    stringstream estream;
+    estream << "ERROR : cannot write " << m_path << endl;
+    estream << "\tthe file was already committed" << endl;
+    throw write_error(estream.str());
+  }
+  FileDescriptorSink(m_fd).write(buffers, count);
+}
+
+void AtomicFileSink::commit() {
+  if (m_fd < 0) {
+    stringstream estream;
+    estream << "ERROR : cannot commit " << m_path << endl;
+    estream << "\tthe file was already committed" << endl;
+    throw commit_error(estream.str());
+  }
+  if (::fdatasync(m_fd) != 0) {
+    throw_system_error<commit_error>(m_path, "synchronize");
+  }
+  if (m_temporary.empty()) {
+    // An anonymous file gets a name first, then replaces the target as usual
+    auto name = temporary_name(m_path);
+    char descriptor[64];
+    snprintf(descriptor, sizeof(descriptor), "%s/%d", proc_fd_directory, m_fd);
+    if (::linkat(AT_FDCWD, descriptor, AT_FDCWD, name.c_str(), AT_SYMLINK_FOLLOW) != 0) {
+      throw_system_error<commit_error>(m_path, "link the new content of");
+    }
+    m_temporary = name;
+  }
+  if (::rename(m_temporary.c_str(), m_path.c_str()) != 0) {
+    throw_system_error<commit_error>(m_path, "replace");
+  }
+  m_temporary.clear();
+  auto fd = m_fd;
+  m_fd = -1;
+  if (::close(fd) != 0) {
+    throw_system_error<commit_error>(m_path, "close");
+  }
+  if (!sync_directory(directory_of(m_path))) {
+    throw_system_error<commit_error>(directory_of(m_path), "synchronize");
+  }
+}
+
+AtomicFileSink::~AtomicFileSink() {
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+  if (!m_temporary.empty()) {
+    ::unlink(m_temporary.c_str());
+  }
+}
+
+void IncrementalSerializableObject::do_serialize(ByteSink &sink) const {
+  auto size = state_size();
+  vector<char> buffer(min<size_t>(size, IncrementalFile::default_block_size));
+  for (size_t offset = 0; offset < size; offset += buffer.size()) {
+    auto n = min(buffer.size(), size - offset);
+    do_serialize_region(offset, n, buffer.data());
+    sink.write(buffer.data(), n);
+  }
+}
+
+constexpr size_t IncrementalFile::default_block_size;
+
+IncrementalFile::IncrementalFile(const boost::filesystem::path &path, size_t block_size)
+    : m_path(path), m_fd(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)),
+      m_block_size(max<size_t>(block_size, 1)), m_size(0), m_valid(false) {
+  if (m_fd < 0) {
+    throw_system_error<file_error>(path, "open");
+  }
+  struct stat status;
+  if (::fstat(m_fd, &status) != 0) {
+    auto error = errno;
+    ::close(m_fd);
+    errno = error;
+    throw_system_error<file_error>(path, "open");
+  }
+  if (status.st_size == 0) {
+    return;
+  }
+  char header[header_size];
+  auto block_size_field = uint64_t(0);
+  if (pread_fully(m_fd, header, header_size, 0) &&
+      memcmp(header, incremental_magic, sizeof(incremental_magic)) == 0) {
+    block_size_field = load_le<uint64_t>(header + 8);
+  }
+  if (block_size_field == 0 || block_size_field > max_block_size) {
+    ::close(m_fd);
+    stringstream estream;
+    estream << "ERROR : " << path << " is not an incremental file" << endl;
+    throw file_error(estream.str());
+  }
+  m_block_size = static_cast<size_t>(block_size_field);
+  // The blocks and the table must lie within the file. They may not after a
+  // write that shrank the file was interrupted: the next write repairs it
+  auto size = load_le<uint64_t>(header + 16);
+  auto file_size = static_cast<uint64_t>(status.st_size);
+  auto blocks = size / m_block_size + (size % m_block_size != 0 ? 1 : 0);
+  if (file_size < data_offset ||
+      blocks > (file_size - data_offset) / (m_block_size + sizeof(uint32_t))) {
+    return;
+  }
+  m_size = size;
+  auto nblocks = static_cast<size_t>(blocks);
+  vector<char> table(nblocks * sizeof(uint32_t));
+  // A torn table is repaired by the next write, which rewrites every block
+  if (pread_fully(m_fd, table.data(), table.size(), block_offset(nblocks)) &&
+      checksum(table.data(), table.size()) == load_le<uint32_t>(header + 24)) {
+    m_checksums.resize(nblocks);
+    for (size_t ii = 0; ii < nblocks; ++ii) {
+      m_checksums[ii] = load_le<uint32_t>(table.data() + ii * sizeof(uint32_t));
+    }
+    m_valid = true;
+  }
+}
+
+size_t IncrementalFile::write(IncrementalSerializableObject &object) {
+  auto size = object.state_size();
+  auto nblocks = (size + m_block_size - 1) / m_block_size;
+  auto old_nblocks = m_checksums.size();
+  vector<bool> dirty(nblocks, !m_valid);
+  for (const auto &x : object.dirty_regions()) {
+    if (x.size == 0 || x.offset >= size) {
+      continue;
+    }
+    auto last = min(x.offset + x.size, size) - 1;
+    fill(dirty.begin() + static_cast<ptrdiff_t>(x.offset / m_block_size),
+         dirty.begin() + static_cast<ptrdiff_t>(last / m_block_size) + 1, true);
+  }
+  // Blocks past the old end, and the last blocks if the size changed
+  for (auto ii = old_nblocks; ii < nblocks; ++ii) {
+    dirty[ii] = true;
+  }
+  if (size != m_size) {
+    if (old_nblocks > 0 && old_nblocks <= nblocks) {
+      dirty[old_nblocks - 1] = true;
+    }
+    if (nblocks > 0) {
+      dirty[nblocks - 1] = true;
+    }
+  }
+  m_checksums.resize(nblocks);
+  // Invalid until the header is written again
+  m_valid = false;
+  vector<char> buffer(m_block_size);
+  size_t written = 0;
+  for (size_t ii = 0; ii < nblocks; ++ii) {
+    if (!dirty[ii]) {
+      continue;
+    }
+    auto n = min(m_block_size, size - ii * m_block_size);
+    object.serialize(ii * m_block_size, n, buffer.data());
+    if (!pwrite_fully(m_fd, buffer.data(), n, block_offset(ii))) {
+      throw_system_error<file_error>(m_path, "write");
+    }
+    m_checksums[ii] = checksum(buffer.data(), n);
+    ++written;
+  }
+  if (::fdatasync(m_fd) != 0) {
+    throw_system_error<file_error>(m_path, "synchronize");
+  }
+  vector<char> table(nblocks * sizeof(uint32_t));
+  for (size_t ii = 0; ii < nblocks; ++ii) {
+    store_le<uint32_t>(table.data() + ii * sizeof(uint32_t), m_checksums[ii]);
+  }
+  char header[header_size] = {};
+  memcpy(header, incremental_magic, sizeof(incremental_magic));
+  store_le<uint64_t>(header + 8, m_block_size);
+  store_le<uint64_t>(header + 16, size);
+  store_le<uint32_t>(header + 24, checksum(table.data(), table.size()));
+  auto end = block_offset(nblocks) + table.size();
+  if (!pwrite_fully(m_fd, table.data(), table.size(), block_offset(nblocks)) ||
+      ::ftruncate(m_fd, static_cast<off_t>(end)) != 0 ||
+      !pwrite_fully(m_fd, header, header_size, 0) || ::fdatasync(m_fd) != 0) {
+    throw_system_error<file_error>(m_path, "write");
+  }
+  m_size = size;
+  m_valid = true;
+  object.clear_dirty_regions();
+  return written;
+}
+
+void IncrementalFile::read(SerializableObject &object) const {
+  if (!m_valid) {
+    stringstream estream;
+    estream << "ERROR : cannot read " << m_path << endl;
+    estream << "\tthe file is empty, or a write was interrupted" << endl;
+    throw file_error(estream.str());
+  }
+  vector<char> state(static_cast<size_t>(m_size));
+  if (!pread_fully(m_fd, state.data(), state.size(), data_offset)) {
+    throw_system_error<file_error>(m_path, "read");
+  }
+  for (size_t ii = 0; ii < m_checksums.size(); ++ii) {
+    auto n = min<size_t>(m_block_size, state.size() - ii * m_block_size);
+    if (checksum(state.data() + ii * m_block_size, n) != m_checksums[ii]) {
+      stringstream estream;
+      estream << "ERROR : cannot read " << m_path << endl;
+      estream << "\tthe checksum of block " << ii << " doesn't match its content" << endl;
+      throw file_error(estream.str());
+    }
+  }
+  MemorySource source(state.data(), state.size());
+  object.deserialize(source);
+}
+
+IncrementalFile::~IncrementalFile() { ::close(m_fd); }
+
+uint64_t IncrementalFile::block_offset(size_t block) const {
+  return data_offset + static_cast<uint64_t>(block) * m_block_size;
+}
+}
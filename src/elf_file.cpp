@@ -0,0 +1,309 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "elf_file.h"
+
+#include <mwheel/mapped_file.h>
+
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include <fcntl.h>
+#include <link.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace mwheel {
+namespace implementation {
+
+/**
+ * @brief Bounds-checked access to an ELF file mapped in memory
+ */
+class ElfFile::Mapping {
+public:
+  explicit Mapping(const boost::filesystem::path &path) : m_file(map(path)) {
+    if (m_file.size() == 0) {
+      fail(path, "cannot determine file size");
+    }
+  }
+
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+
+  /// Returns a pointer to an object of type T at a given offset, or nullptr if out of bounds
+  template <class T> const T *at(size_t offset, size_t count = 1) const {
+    if (offset > m_file.size() || count > (m_file.size() - offset) / sizeof(T)) {
+      return nullptr;
+    }
+    return reinterpret_cast<const T *>(m_file.data() + offset);
+  }
+
+  /// Returns the null terminated string at a given offset, or nullptr if out of bounds
+  const char *string_at(size_t offset) const {
+    if (offset >= m_file.size()) {
+      return nullptr;
+    }
+    auto begin = m_file.data() + offset;
+    return memchr(begin, '\0', m_file.size() - offset) ? begin : nullptr;
+  }
+
+  [[noreturn]] static void fail(const boost::filesystem::path &path, const string &reason) {
+    stringstream estream;
+    estream << "ERROR : cannot read ELF file " << path << endl;
+    estream << "\t" << reason << endl;
+    throw ElfFile::invalid_elf_file(estream.str());
+  }
+
+private:
+  /// Maps a file, reporting errors as invalid_elf_file
+  static MappedFile map(const boost::filesystem::path &path) {
+    try {
+      return MappedFile(path, MappedFile::Access::random);
+    } catch (const MappedFile::mapping_error &error) {
+      fail(path, error.what());
+    }
+  }
+
+  MappedFile m_file;
+};
+
+namespace {
+
+/// Hash function of the GNU hash table
+uint32_t gnu_hash(const char *name) {
+  uint32_t hash = 5381;
+  for (auto c = reinterpret_cast<const unsigned char *>(name); *c; ++c) {
+    hash = hash * 33 + *c;
+  }
+  return hash;
+}
+
+/// Hash function of the SysV hash table
+uint32_t sysv_hash(const char *name) {
+  uint32_t hash = 0;
+  for (auto c = reinterpret_cast<const unsigned char *>(name); *c; ++c) {
+    hash = (hash << 4) + *c;
+    auto high = hash & 0xf0000000;
+    hash ^= high >> 24;
+    hash &= ~high;
+  }
+  return hash;
+}
+}
+
+ElfFile::ElfFile(const boost::filesystem::path &path)
+    : m_file(new Mapping(path)), m_strtab(0), m_symtab(0), m_gnu_hash(0), m_hash(0) {
+  const auto &file = *m_file;
+  // Check the identification bytes
+  auto header = file.at<ElfW(Ehdr)>(0);
+  if (!header || memcmp(header->e_ident, ELFMAG, SELFMAG) != 0) {
+    Mapping::fail(path, "not an ELF file");
+  }
+  auto native_class = sizeof(void *) == 8 ? ELFCLASS64 : ELFCLASS32;
+  if (header->e_ident[EI_CLASS] != native_class) {
+    Mapping::fail(path, "ELF class differs from the one of the running process");
+  }
+  auto program_headers = file.at<ElfW(Phdr)>(header->e_phoff, header->e_phnum);
+  if (!program_headers) {
+    Mapping::fail(path, "truncated program header table");
+  }
+  // Scan the program headers
+  const ElfW(Dyn) *dynamic = nullptr;
+  size_t ndynamic = 0;
+  for (auto ii = 0u; ii < header->e_phnum; ++ii) {
+    const auto &segment = program_headers[ii];
+    if (segment.p_type == PT_LOAD) {
+      m_segments.push_back(Segment{segment.p_vaddr, segment.p_filesz, segment.p_offset});
+    } else if (segment.p_type == PT_DYNAMIC) {
+      ndynamic = segment.p_filesz / sizeof(ElfW(Dyn));
+      dynamic = file.at<ElfW(Dyn)>(segment.p_offset, ndynamic);
+    }
+  }
+  if (!dynamic) {
+    Mapping::fail(path, "missing or truncated dynamic section");
+  }
+  // Scan the dynamic section
+  bool has_strtab = false;
+  vector<size_t> needed;
+  auto soname = numeric_limits<size_t>::max();
+  for (size_t ii = 0; ii < ndynamic && dynamic[ii].d_tag != DT_NULL; ++ii) {
+    switch (dynamic[ii].d_tag) {
+    case DT_STRTAB:
+      has_strtab = to_offset(dynamic[ii].d_un.d_ptr, m_strtab);
+      break;
+    case DT_SYMTAB:
+      to_offset(dynamic[ii].d_un.d_ptr, m_symtab);
+      break;
+    case DT_GNU_HASH:
+      to_offset(dynamic[ii].d_un.d_ptr, m_gnu_hash);
+      break;
+    case DT_HASH:
+      to_offset(dynamic[ii].d_un.d_ptr, m_hash);
+      break;
+    case DT_NEEDED:
+      needed.push_back(dynamic[ii].d_un.d_val);
+      break;
+    case DT_SONAME:
+      soname = dynamic[ii].d_un.d_val;
+      break;
+    }
+  }
+  if (!has_strtab) {
+    Mapping::fail(path, "missing dynamic string table");
+  }
+  auto string_at = [&](size_t offset) {
+    auto value = file.string_at(m_strtab + offset);
+    if (!value) {
+      Mapping::fail(path, "string out of the bounds of the file");
+    }
+    return string(value);
+  };
+  for (auto offset : needed) {
+    m_needed.push_back(string_at(offset));
+  }
+  if (soname != numeric_limits<size_t>::max()) {
+    m_soname = string_at(soname);
+  }
+}
+
+ElfFile::~ElfFile() = default;
+
+bool ElfFile::to_offset(uint64_t address, size_t &offset) const {
+  for (const auto &segment : m_segments) {
+    if (address >= segment.address && address < segment.address + segment.file_size) {
+      offset = address - segment.address + segment.offset;
+      return true;
+    }
+  }
+  return false;
+}
+
+const void *ElfFile::find_symbol(const string &name, size_t size) const {
+  auto symbol = static_cast<const ElfW(Sym) *>(lookup_symbol(name));
+  size_t offset;
+  if (!symbol || symbol->st_size < size || !to_offset(symbol->st_value, offset)) {
+    return nullptr;
+  }
+  // All the bytes must come from the file
+  size_t last;
+  if (size > 0 && !to_offset(symbol->st_value + size - 1, last)) {
+    return nullptr;
+  }
+  return m_file->at<char>(offset, size);
+}
+
+bool ElfFile::defines_symbol(const string &name) const { return lookup_symbol(name) != nullptr; }
+
+const void *ElfFile::lookup_symbol(const string &name) const {
+  if (!m_symtab) {
+    return nullptr;
+  }
+  const auto &file = *m_file;
+  // Checks whether a symbol table entry is the definition we are looking for
+  auto matches = [&](uint32_t index) -> const ElfW(Sym) * {
+    auto symbol = file.at<ElfW(Sym)>(m_symtab + index * sizeof(ElfW(Sym)));
+    if (!symbol || symbol->st_shndx == SHN_UNDEF) {
+      return nullptr;
+    }
+    auto symbol_name = file.string_at(m_strtab + symbol->st_name);
+    return (symbol_name && name == symbol_name) ? symbol : nullptr;
+  };
+  const ElfW(Sym) *symbol = nullptr;
+  if (m_gnu_hash) {
+    // Header: nbuckets, symoffset, bloom_size, bloom_shift
+    auto table = file.at<uint32_t>(m_gnu_hash, 4);
+    if (!table || table[0] == 0) {
+      return nullptr;
+    }
+    auto nbuckets = table[0];
+    auto symoffset = table[1];
+    auto bloom_size = table[2];
+    auto bloom_shift = table[3];
+    auto bloom_offset = m_gnu_hash + 4 * sizeof(uint32_t);
+    auto bloom = file.at<ElfW(Addr)>(bloom_offset, bloom_size);
+    auto buckets_offset = bloom_offset + bloom_size * sizeof(ElfW(Addr));
+    auto buckets = file.at<uint32_t>(buckets_offset, nbuckets);
+    if (!bloom || !buckets || bloom_size == 0) {
+      return nullptr;
+    }
+    auto hash = gnu_hash(name.c_str());
+    // The Bloom filter rejects most of the missing symbols right away
+    const auto bits = 8 * sizeof(ElfW(Addr));
+    auto word = bloom[(hash / bits) % bloom_size];
+    auto mask =
+        (ElfW(Addr)(1) << (hash % bits)) | (ElfW(Addr)(1) << ((hash >> bloom_shift) % bits));
+    if ((word & mask) != mask) {
+      return nullptr;
+    }
+    auto chain_offset = buckets_offset + nbuckets * sizeof(uint32_t);
+    for (auto index = buckets[hash % nbuckets]; index >= symoffset && index != 0; ++index) {
+      auto chain = file.at<uint32_t>(chain_offset + (index - symoffset) * sizeof(uint32_t));
+      if (!chain) {
+        return nullptr;
+      }
+      if ((*chain | 1) == (hash | 1) && (symbol = matches(index))) {
+        break;
+      }
+      if (*chain & 1) {
+        return nullptr;
+      }
+    }
+  } else if (m_hash) {
+    // Header: nbucket, nchain
+    auto table = file.at<uint32_t>(m_hash, 2);
+    if (!table || table[0] == 0) {
+      return nullptr;
+    }
+    auto nbucket = table[0];
+    auto nchain = table[1];
+    auto buckets = file.at<uint32_t>(m_hash + 2 * sizeof(uint32_t), nbucket);
+    auto chains = file.at<uint32_t>(m_hash + (2 + nbucket) * sizeof(uint32_t), nchain);
+    if (!buckets || !chains) {
+      return nullptr;
+    }
+    for (auto index = buckets[sysv_hash(name.c_str()) % nbucket]; index != 0 && index < nchain;
+         index = chains[index]) {
+      if ((symbol = matches(index))) {
+        break;
+      }
+    }
+  }
+  return symbol;
+}
+
+void ElfFile::prefetch(const boost::filesystem::path &path) {
+  auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+  }
+}
+}
+}
@@ -0,0 +1,183 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file elf_file.h
+ *
+ * @brief Read-only access to the dynamic section and the dynamic symbols of
+ * an ELF shared object
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 10:05 AM
+ */
+
+#ifndef ELF_FILE_H_20261018
+#define ELF_FILE_H_20261018
+
+#include <mwheel/utility.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mwheel {
+namespace implementation {
+
+/**
+ * @brief Parses the dynamic section of a shared object without loading it
+ *
+ * Only objects of the same ELF class as the running process are accepted,
+ * as no other object could be loaded by the dynamic linker anyhow. The file
+ * stays mapped in memory for the lifetime of the object.
+ */
+class ElfFile {
+public:
+  /// @brief Exception thrown if the file can't be read or is not a valid ELF shared object
+  MWHEEL_RUNTIME_EXCEPTION(invalid_elf_file);
+
+  /**
+   * @brief Reads the dynamic section of a shared object
+   *
+   * @param[in] path path of the shared object
+   *
+   * @throw invalid_elf_file if the file can't be read or is not a valid ELF shared object
+   */
+  explicit ElfFile(const boost::filesystem::path &path);
+
+  ElfFile(const ElfFile &) = delete;
+  ElfFile &operator=(const ElfFile &) = delete;
+
+  /**
+   * @brief Unmaps the file
+   */
+  ~ElfFile();
+
+  /**
+   * @brief Returns the value of DT_SONAME
+   *
+   * @return the soname of the object, or an empty string if it has none
+   */
+  const std::string &soname() const { return m_soname; }
+
+  /**
+   * @brief Returns the values of the DT_NEEDED entries, in order
+   *
+   * @return names of the libraries the object depends on
+   */
+  const std::vector<std::string> &needed() const { return m_needed; }
+
+  /**
+   * @brief Looks for a defined dynamic symbol and returns its initial value
+   *
+   * The lookup goes through the GNU hash table of the object (or the SysV one
+   * if that is missing), as the dynamic linker would do.
+   *
+   * @param[in] name name of the symbol
+   * @param[in] size number of bytes that are needed
+   *
+   * @return pointer to the bytes of the symbol in the file, or nullptr if the
+   * symbol is not defined, is smaller than `size` or has no bytes in the file
+   */
+  const void *find_symbol(const std::string &name, std::size_t size) const;
+
+  /**
+   * @brief Checks whether a dynamic symbol is defined, whatever its bytes
+   *
+   * @param[in] name name of the symbol
+   *
+   * @return true if the object defines the symbol (possibly without bytes
+   * in the file, e.g. in `.bss`)
+   */
+  bool defines_symbol(const std::string &name) const;
+
+  /**
+   * @brief Asks the kernel to start reading the whole file into the page cache
+   *
+   * @param[in] path path of the file
+   */
+  static void prefetch(const boost::filesystem::path &path);
+
+private:
+  /// Read-only mapping of the file
+  class Mapping;
+
+  /// Loadable segment (to translate virtual addresses into file offsets)
+  struct Segment {
+    /// Virtual address of the segment
+    std::uint64_t address;
+    /// Number of bytes of the segment in the file
+    std::uint64_t file_size;
+    /// Offset of the segment in the file
+    std::uint64_t offset;
+  };
+
+  /**
+   * @brief Translates a virtual address into a file offset
+   *
+   * @param[in] address virtual address
+   * @param[out] offset offset in the file
+   *
+   * @return false if the address has no bytes in the file
+   */
+  bool to_offset(std::uint64_t address, std::size_t &offset) const;
+
+  /**
+   * @brief Looks for a defined dynamic symbol through the hash tables
+   *
+   * @param[in] name name of the symbol
+   *
+   * @return entry of the symbol table (an `ElfW(Sym)`), nullptr if missing
+   */
+  const void *lookup_symbol(const std::string &name) const;
+
+  /// Mapping of the file
+  std::unique_ptr<Mapping> m_file;
+  /// Loadable segments
+  std::vector<Segment> m_segments;
+  /// Offset of the dynamic string table
+  std::size_t m_strtab;
+  /// Offset of the dynamic symbol table (0 if missing)
+  std::size_t m_symtab;
+  /// Offset of the GNU hash table (0 if missing)
+  std::size_t m_gnu_hash;
+  /// Offset of the SysV hash table (0 if missing)
+  std::size_t m_hash;
+  /// Soname of the object
+  std::string m_soname;
+  /// Libraries the object depends on
+  std::vector<std::string> m_needed;
+};
+}
+}
+
+#endif /* ELF_FILE_H_20261018 */
@@ -0,0 +1,130 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/**
+ * @file file_format.h
+ *
+ * @brief Helpers shared by the binary file formats of the library
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 9:40 PM
+ */
+
+#ifndef FILE_FORMAT_H_20261018
+#define FILE_FORMAT_H_20261018
+
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace mwheel {
+namespace implementation {
+
+/**
+ * @brief Stores an unsigned integer in little-endian order
+ *
+ * @param[out] destination first of the sizeof(T) bytes written
+ * @param[in] value integer to be stored
+ */
+template <class T> void store_le(char *destination, T value) {
+  for (std::size_t ii = 0; ii < sizeof(T); ++ii) {
+    destination[ii] = static_cast<char>((value >> (8 * ii)) & 0xff);
+  }
+}
+
+/**
+ * @brief Loads an unsigned integer stored in little-endian order
+ *
+ * @param[in] source first of the sizeof(T) bytes read
+ *
+ * @return integer stored at the given position
+ */
+template <class T> T load_le(const char *source) {
+  T value = 0;
+  for (std::size_t ii = 0; ii < sizeof(T); ++ii) {
+    value |= static_cast<T>(static_cast<unsigned char>(source[ii])) << (8 * ii);
+  }
+  return value;
+}
+
+/**
+ * @brief Computes the CRC-32 of a buffer
+ *
+ * @param[in] data first byte of the buffer
+ * @param[in] size size of the buffer
+ *
+ * @return CRC-32 of the buffer
+ */
+inline std::uint32_t checksum(const char *data, std::size_t size) {
+  boost::crc_32_type crc;
+  crc.process_bytes(data, size);
+  return crc.checksum();
+}
+
+/**
+ * @brief Synchronizes a directory, so that the entries created or renamed in
+ * it are durable
+ *
+ * @param[in] directory directory to be synchronized
+ *
+ * @return false if the directory can't be synchronized (errno is set)
+ */
+inline bool sync_directory(const boost::filesystem::path &directory) {
+  auto fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  auto result = ::fsync(fd);
+  auto error = errno;
+  ::close(fd);
+  errno = error;
+  return result == 0;
+}
+
+/**
+ * @brief Returns the directory of a file ("." for relative names without one)
+ *
+ * @param[in] path path of the file
+ *
+ * @return directory that holds the file
+ */
+inline boost::filesystem::path directory_of(const boost::filesystem::path &path) {
+  auto directory = path.parent_path();
+  return directory.empty() ? boost::filesystem::path(".") : directory;
+}
+}
+}
+
+#endif /* FILE_FORMAT_H_20261018 */
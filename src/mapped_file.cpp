@@ -0,0 +1,127 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/mapped_file.h>
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace mwheel {
+
+namespace {
+
+/**
+ * @brief Translates an access pattern into `madvise` advice
+ */
+int advice(MappedFile::Access access) {
+  switch (access) {
+  case MappedFile::Access::sequential:
+    return MADV_SEQUENTIAL;
+  case MappedFile::Access::random:
+    return MADV_RANDOM;
+  case MappedFile::Access::will_need:
+    return MADV_WILLNEED;
+  default:
+    return MADV_NORMAL;
+  }
+}
+
+/**
+ * @brief Throws a MappedFile::mapping_error that reports the last system error
+ */
+[[noreturn]] void throw_mapping_error(const boost::filesystem::path &path) {
+  auto error = errno;
+  stringstream estream;
+  estream << "ERROR : cannot map file " << path << endl;
+  estream << "\t" << strerror(error) << endl;
+  throw MappedFile::mapping_error(estream.str());
+}
+}
+
+MappedFile::MappedFile(const boost::filesystem::path &path, Access access)
+    : m_path(path), m_data(nullptr), m_size(0) {
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw_mapping_error(path);
+  }
+  struct stat status;
+  if (::fstat(fd, &status) != 0) {
+    ::close(fd);
+    throw_mapping_error(path);
+  }
+  m_size = static_cast<size_t>(status.st_size);
+  if (m_size != 0) {
+    auto data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      ::close(fd);
+      throw_mapping_error(path);
+    }
+    m_data = static_cast<const char *>(data);
+  }
+  ::close(fd);
+  advise(access);
+}
+
+MappedFile::MappedFile(MappedFile &&other)
+    : m_path(std::move(other.m_path)), m_data(other.m_data), m_size(other.m_size) {
+  other.m_data = nullptr;
+  other.m_size = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+  swap(m_path, other.m_path);
+  swap(m_data, other.m_data);
+  swap(m_size, other.m_size);
+  return *this;
+}
+
+void MappedFile::advise(Access access, size_t offset, size_t length) const {
+  if (!m_data || offset >= m_size) {
+    return;
+  }
+  auto page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  auto begin = offset - offset % page;
+  auto end = (length == 0 || length > m_size - offset) ? m_size : offset + length;
+  ::madvise(const_cast<char *>(m_data) + begin, end - begin, advice(access));
+}
+
+MappedFile::~MappedFile() {
+  if (m_data) {
+    ::munmap(const_cast<char *>(m_data), m_size);
+  }
+}
+}
@@ -0,0 +1,359 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/byte_stream.h>
+#include <mwheel/memento_log.h>
+
+#include "file_format.h"
+
+#include <boost/crc.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace mwheel {
+
+namespace {
+
+using implementation::load_le;
+using implementation::store_le;
+
+/// First bytes of every log
+const char log_magic[8] = {'M', 'W', 'M', 'E', 'M', 'L', 'O', 'G'};
+/// Size of the header of a record
+const size_t record_header_size = 8;
+
+/**
+ * @brief Computes the CRC-32 of a record, which covers its size and its state
+ *
+ * @param[in] header header of the record, followed by its state
+ */
+uint32_t record_checksum(const char *header) {
+  boost::crc_32_type crc;
+  crc.process_bytes(header, 4);
+  crc.process_bytes(header + record_header_size, load_le<uint32_t>(header));
+  return crc.checksum();
+}
+
+/**
+ * @brief Throws a MementoLog::log_error that reports the last system error
+ *
+ * @param[in] path path of the log
+ * @param[in] operation what was being done
+ */
+[[noreturn]] void throw_system_error(const boost::filesystem::path &path, const char *operation) {
+  auto error = errno;
+  stringstream estream;
+  estream << "ERROR : cannot " << operation << " memento log " << path << endl;
+  estream << "\t" << strerror(error) << endl;
+  throw MementoLog::log_error(estream.str());
+}
+
+/**
+ * @brief Closes a file descriptor at destruction
+ */
+struct FileCloser {
+  int fd;
+  ~FileCloser() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+};
+
+/**
+ * @brief Reads from a file descriptor until the buffer is full or the file ends
+ *
+ * @return number of bytes read
+ */
+size_t read_fully(int fd, char *data, size_t size, const boost::filesystem::path &path) {
+  size_t done = 0;
+  while (done < size) {
+    auto n = ::read(fd, data + done, size - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw_system_error(path, "read");
+    }
+    if (n == 0) {
+      break;
+    }
+    done += static_cast<size_t>(n);
+  }
+  return done;
+}
+
+/**
+ * @brief Throws a MementoLog::log_error if a file doesn't start with the magic string
+ */
+void check_magic(const char *header, size_t size, const boost::filesystem::path &path) {
+  if (size < sizeof(log_magic) || memcmp(header, log_magic, sizeof(log_magic)) != 0) {
+    stringstream estream;
+    estream << "ERROR : " << path << " is not a memento log" << endl;
+    throw MementoLog::log_error(estream.str());
+  }
+}
+
+/**
+ * @brief Reads the records of a log sequentially, in large chunks
+ */
+class RecordReader {
+public:
+  /**
+   * @brief Checks the magic string at the beginning of a log
+   *
+   * @param[in] fd file descriptor of the log, positioned at its beginning
+   * @param[in] path path of the log
+   * @param[in] buffer_size size of the chunks read from the file
+   */
+  RecordReader(int fd, const boost::filesystem::path &path, size_t buffer_size)
+      : m_fd(fd), m_path(path), m_buffer(max(buffer_size, record_header_size)), m_begin(0),
+        m_end(0), m_eof(false), m_offset(sizeof(log_magic)), m_current(0) {
+    struct stat status;
+    if (::fstat(fd, &status) != 0) {
+      throw_system_error(path, "read");
+    }
+    m_file_size = static_cast<uint64_t>(status.st_size);
+    fill(sizeof(log_magic));
+    check_magic(m_buffer.data(), m_end, path);
+    m_begin = sizeof(log_magic);
+  }
+
+  /**
+   * @brief Moves to the next record
+   *
+   * @return false if the log ended, or if its last record was cut short
+   */
+  bool next() {
+    m_begin += m_current;
+    m_offset += m_current;
+    m_current = 0;
+    if (m_file_size - m_offset < record_header_size || !fill(record_header_size)) {
+      return false;
+    }
+    auto record_size = record_header_size + size();
+    if (m_file_size - m_offset < record_size || !fill(record_size)) {
+      return false;
+    }
+    m_current = record_size;
+    return true;
+  }
+
+  /**
+   * @brief Checks that the state of the current record matches its checksum
+   */
+  bool intact() const { return record_checksum(header()) == load_le<uint32_t>(header() + 4); }
+
+  /**
+   * @brief Returns the state of the current record
+   */
+  const char *state() const { return header() + record_header_size; }
+
+  /**
+   * @brief Returns the size of the state of the current record
+   */
+  size_t size() const { return load_le<uint32_t>(header()); }
+
+  /**
+   * @brief Returns the offset of the current record in the file
+   */
+  uint64_t offset() const { return m_offset; }
+
+private:
+  const char *header() const { return m_buffer.data() + m_begin; }
+
+  /**
+   * @brief Makes sure that at least `needed` bytes are available after the current position
+   *
+   * @return false if the file ends before
+   */
+  bool fill(size_t needed) {
+    if (m_end - m_begin >= needed) {
+      return true;
+    }
+    // Records that don't fit in the rest of the buffer are moved to its front
+    copy(m_buffer.begin() + static_cast<ptrdiff_t>(m_begin),
+         m_buffer.begin() + static_cast<ptrdiff_t>(m_end), m_buffer.begin());
+    m_end -= m_begin;
+    m_begin = 0;
+    if (m_buffer.size() < needed) {
+      m_buffer.resize(max(needed, 2 * m_buffer.size()));
+    }
+    while (!m_eof && m_end < needed) {
+      auto n = read_fully(m_fd, m_buffer.data() + m_end, m_buffer.size() - m_end, m_path);
+      m_eof = (n < m_buffer.size() - m_end);
+      m_end += n;
+    }
+    return m_end >= needed;
+  }
+
+  /// File descriptor of the log
+  int m_fd;
+  /// Path of the log
+  const boost::filesystem::path &m_path;
+  /// Chunk of the file being read
+  vector<char> m_buffer;
+  /// Position of the current record in the buffer
+  size_t m_begin;
+  /// End of the bytes read into the buffer
+  size_t m_end;
+  /// Set when the whole file was read
+  bool m_eof;
+  /// Size of the file when it was opened
+  uint64_t m_file_size;
+  /// Position of the current record in the file
+  uint64_t m_offset;
+  /// Size of the current record, header included
+  size_t m_current;
+};
+}
+
+constexpr size_t MementoLog::default_buffer_size;
+
+MementoLog::MementoLog(const boost::filesystem::path &path, size_t buffer_size)
+    : m_path(path), m_fd(-1), m_buffer_size(max<size_t>(buffer_size, 1)), m_size(0) {
+  FileCloser file{::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644)};
+  if (file.fd < 0) {
+    throw_system_error(path, "open");
+  }
+  auto file_size = ::lseek(file.fd, 0, SEEK_END);
+  if (file_size < 0 || ::lseek(file.fd, 0, SEEK_SET) != 0) {
+    throw_system_error(path, "open");
+  }
+  if (file_size == 0) {
+    m_buffer.assign(log_magic, log_magic + sizeof(log_magic));
+  } else {
+    // Count the records and drop the ones after the first that is cut short
+    // or corrupted: a crash may leave the tail of the file zero-filled
+    RecordReader records(file.fd, path,
+                         min(static_cast<size_t>(file_size), default_buffer_size));
+    while (records.next() && records.intact()) {
+      ++m_size;
+    }
+    auto offset = records.offset();
+    if (offset != static_cast<uint64_t>(file_size) &&
+        ::ftruncate(file.fd, static_cast<off_t>(offset)) != 0) {
+      throw_system_error(path, "repair");
+    }
+  }
+  m_buffer.reserve(m_buffer_size + record_header_size);
+  swap(m_fd, file.fd);
+}
+
+void MementoLog::append(const SerializableObject &memento) {
+  auto start = m_buffer.size();
+  m_buffer.resize(start + record_header_size);
+  try {
+    VectorSink sink(m_buffer);
+    memento.serialize(sink);
+    auto size = m_buffer.size() - start - record_header_size;
+    if (size > numeric_limits<uint32_t>::max()) {
+      stringstream estream;
+      estream << "ERROR : cannot append to memento log " << m_path << endl;
+      estream << "\tthe state of the memento exceeds 4 GiB" << endl;
+      throw log_error(estream.str());
+    }
+    auto header = m_buffer.data() + start;
+    store_le<uint32_t>(header, static_cast<uint32_t>(size));
+    store_le<uint32_t>(header + 4, record_checksum(header));
+  } catch (...) {
+    m_buffer.resize(start);
+    throw;
+  }
+  ++m_size;
+  if (m_buffer.size() >= m_buffer_size) {
+    write_buffer();
+  }
+}
+
+void MementoLog::flush(bool sync) {
+  write_buffer();
+  if (sync && ::fdatasync(m_fd) != 0) {
+    throw_system_error(m_path, "sync");
+  }
+}
+
+MementoLog::~MementoLog() {
+  try {
+    write_buffer();
+  } catch (const log_error &) {
+  }
+  ::close(m_fd);
+}
+
+void MementoLog::write_buffer() {
+  size_t done = 0;
+  while (done < m_buffer.size()) {
+    auto n = ::write(m_fd, m_buffer.data() + done, m_buffer.size() - done);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // Keep what was not written, so that a later flush can retry
+      m_buffer.erase(m_buffer.begin(), m_buffer.begin() + static_cast<ptrdiff_t>(done));
+      throw_system_error(m_path, "write");
+    }
+    done += static_cast<size_t>(n);
+  }
+  m_buffer.clear();
+}
+
+uint64_t MementoLog::replay(const boost::filesystem::path &path, const visitor_type &visitor,
+                            size_t buffer_size) {
+  FileCloser file{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (file.fd < 0) {
+    throw_system_error(path, "open");
+  }
+  ::posix_fadvise(file.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  RecordReader records(file.fd, path, buffer_size);
+  uint64_t count = 0;
+  // A record cut short by a crash ends the log
+  while (records.next()) {
+    if (!records.intact()) {
+      stringstream estream;
+      estream << "ERROR : memento log " << path << " is corrupted" << endl;
+      estream << "\tthe checksum of memento " << count << " doesn't match its state" << endl;
+      throw log_error(estream.str());
+    }
+    MemorySource source(records.state(), records.size());
+    visitor(source, records.size());
+    ++count;
+  }
+  return count;
+}
+}
@@ -0,0 +1,289 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/byte_stream.h>
+#include <mwheel/object_archive.h>
+
+#include "file_format.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace mwheel {
+
+namespace {
+
+using implementation::checksum;
+using implementation::directory_of;
+using implementation::load_le;
+using implementation::store_le;
+using implementation::sync_directory;
+
+/// First and last bytes of every archive
+const char archive_magic[8] = {'M', 'W', 'A', 'R', 'C', 'H', 'I', 'V'};
+/// Size of an entry of the index
+const size_t entry_size = 20;
+/// Size of the footer
+const size_t footer_size = 24;
+
+/**
+ * @brief Throws an ArchiveWriter::archive_error
+ *
+ * @param[in] path path of the archive
+ * @param[in] reason why the archive can't be written
+ */
+[[noreturn]] void throw_write_error(const boost::filesystem::path &path, const string &reason) {
+  stringstream estream;
+  estream << "ERROR : cannot write archive " << path << endl;
+  estream << "\t" << reason << endl;
+  throw ArchiveWriter::archive_error(estream.str());
+}
+
+/**
+ * @brief Throws an ArchiveReader::archive_error
+ *
+ * @param[in] path path of the archive
+ * @param[in] reason why the archive can't be read
+ */
+[[noreturn]] void throw_read_error(const boost::filesystem::path &path, const string &reason) {
+  stringstream estream;
+  estream << "ERROR : cannot read archive " << path << endl;
+  estream << "\t" << reason << endl;
+  throw ArchiveReader::archive_error(estream.str());
+}
+
+/**
+ * @brief States serialized by one task
+ */
+struct Chunk {
+  /// States, one after the other
+  vector<char> buffer;
+  /// Position of each state in the buffer
+  vector<implementation::ArchiveEntry> entries;
+};
+
+/**
+ * @brief Maps an archive, turning failures into ArchiveReader::archive_error
+ */
+MappedFile map(const boost::filesystem::path &path) {
+  try {
+    return MappedFile(path, MappedFile::Access::random);
+  } catch (const MappedFile::mapping_error &) {
+    throw_read_error(path, "the file can't be mapped");
+  }
+}
+}
+
+ArchiveWriter::ArchiveWriter(const boost::filesystem::path &path, ThreadPool &pool)
+    : m_path(path), m_fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)),
+      m_failed(false), m_pool(pool), m_offset(0) {
+  if (m_fd < 0) {
+    throw_write_error(path, strerror(errno));
+  }
+  try {
+    FileDescriptorSink(m_fd).write(archive_magic, sizeof(archive_magic));
+  } catch (const ByteSink::write_error &) {
+    ::close(m_fd);
+    throw_write_error(path, "the header can't be written");
+  }
+  m_offset = sizeof(archive_magic);
+}
+
+void ArchiveWriter::write(const vector<const SerializableObject *> &objects) {
+  check_open();
+  if (objects.empty()) {
+    return;
+  }
+  auto nchunks = min(objects.size(), max<size_t>(m_pool.size(), 1));
+  vector<Chunk> chunks(nchunks);
+  vector<future<void>> tasks;
+  for (size_t ii = 0; ii < nchunks; ++ii) {
+    auto first = objects.size() * ii / nchunks;
+    auto last = objects.size() * (ii + 1) / nchunks;
+    auto &chunk = chunks[ii];
+    tasks.push_back(m_pool.submit([&objects, &chunk, first, last]() {
+      VectorSink sink(chunk.buffer);
+      for (auto jj = first; jj < last; ++jj) {
+        auto begin = chunk.buffer.size();
+        objects[jj]->serialize(sink);
+        auto size = chunk.buffer.size() - begin;
+        chunk.entries.push_back({begin, size, checksum(chunk.buffer.data() + begin, size)});
+      }
+    }));
+  }
+  // Every task must be over before the chunks go out of scope
+  exception_ptr error;
+  for (auto &x : tasks) {
+    try {
+      m_pool.wait(x);
+      x.get();
+    } catch (...) {
+      if (!error) {
+        error = current_exception();
+      }
+    }
+  }
+  if (error) {
+    rethrow_exception(error);
+  }
+  vector<ConstBuffer> buffers;
+  for (const auto &x : chunks) {
+    buffers.push_back({x.buffer.data(), x.buffer.size()});
+  }
+  try {
+    FileDescriptorSink(m_fd).write(buffers.data(), buffers.size());
+  } catch (const ByteSink::write_error &e) {
+    fail(e.what());
+  }
+  for (const auto &x : chunks) {
+    for (auto entry : x.entries) {
+      entry.offset += m_offset;
+      m_index.push_back(entry);
+    }
+    m_offset += x.buffer.size();
+  }
+}
+
+void ArchiveWriter::commit() {
+  check_open();
+  vector<char> tail(m_index.size() * entry_size + footer_size);
+  auto position = tail.data();
+  for (const auto &x : m_index) {
+    store_le<uint64_t>(position, x.offset);
+    store_le<uint64_t>(position + 8, x.size);
+    store_le<uint32_t>(position + 16, x.checksum);
+    position += entry_size;
+  }
+  store_le<uint64_t>(position, m_offset);
+  store_le<uint64_t>(position + 8, m_index.size());
+  memcpy(position + 16, archive_magic, sizeof(archive_magic));
+  try {
+    FileDescriptorSink(m_fd).write(tail.data(), tail.size());
+  } catch (const ByteSink::write_error &e) {
+    fail(e.what());
+  }
+  if (::fdatasync(m_fd) != 0) {
+    fail(strerror(errno));
+  }
+  auto fd = m_fd;
+  m_fd = -1;
+  if (::close(fd) != 0) {
+    throw_write_error(m_path, strerror(errno));
+  }
+  // The archive may have just been created: make its directory entry durable too
+  if (!sync_directory(directory_of(m_path))) {
+    throw_write_error(m_path, strerror(errno));
+  }
+}
+
+ArchiveWriter::~ArchiveWriter() {
+  if (m_fd >= 0) {
+    ::close(m_fd);
+  }
+}
+
+void ArchiveWriter::check_open() const {
+  if (m_failed) {
+    throw_write_error(m_path, "a previous write failed");
+  }
+  if (m_fd < 0) {
+    throw_write_error(m_path, "the archive is already committed");
+  }
+}
+
+void ArchiveWriter::fail(const string &reason) {
+  // Part of the data may have reached the file: nothing else can be appended
+  m_failed = true;
+  ::close(m_fd);
+  m_fd = -1;
+  throw_write_error(m_path, reason);
+}
+
+ArchiveReader::ArchiveReader(const boost::filesystem::path &path) : m_file(map(path)) {
+  auto data = m_file.data();
+  auto size = m_file.size();
+  if (size < sizeof(archive_magic) + footer_size ||
+      memcmp(data, archive_magic, sizeof(archive_magic)) != 0 ||
+      memcmp(data + size - sizeof(archive_magic), archive_magic, sizeof(archive_magic)) != 0) {
+    throw_read_error(path, "the file is not a committed archive");
+  }
+  auto footer = data + size - footer_size;
+  auto index_offset = load_le<uint64_t>(footer);
+  auto count = load_le<uint64_t>(footer + 8);
+  if (index_offset < sizeof(archive_magic) || index_offset > size - footer_size ||
+      (size - footer_size - index_offset) / entry_size != count ||
+      (size - footer_size - index_offset) % entry_size != 0) {
+    throw_read_error(path, "the index is corrupted");
+  }
+  // Only the index is needed now: the states are read on demand
+  m_file.advise(MappedFile::Access::will_need, index_offset);
+  m_index.reserve(count);
+  for (auto position = data + index_offset; position != footer; position += entry_size) {
+    implementation::ArchiveEntry entry{load_le<uint64_t>(position), load_le<uint64_t>(position + 8),
+                                       load_le<uint32_t>(position + 16)};
+    if (entry.offset < sizeof(archive_magic) || entry.offset > index_offset ||
+        entry.size > index_offset - entry.offset) {
+      throw_read_error(path, "the index is corrupted");
+    }
+    m_index.push_back(entry);
+  }
+}
+
+size_t ArchiveReader::state_size(size_t index) const { return entry(index).size; }
+
+void ArchiveReader::read(size_t index, SerializableObject &object) const {
+  const auto &x = entry(index);
+  auto state = m_file.data() + x.offset;
+  if (checksum(state, x.size) != x.checksum) {
+    stringstream reason;
+    reason << "the checksum of state " << index << " doesn't match its content";
+    throw_read_error(m_file.path(), reason.str());
+  }
+  MemorySource source(state, x.size);
+  object.deserialize(source);
+}
+
+const implementation::ArchiveEntry &ArchiveReader::entry(size_t index) const {
+  if (index >= m_index.size()) {
+    stringstream reason;
+    reason << "state " << index << " is out of range (the archive has " << m_index.size()
+           << " states)";
+    throw_read_error(m_file.path(), reason.str());
+  }
+  return m_index[index];
+}
+}
@@ -0,0 +1,69 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/on_demand_loader.h>
+
+using namespace std;
+
+namespace mwheel {
+
+OnDemandLoader::~OnDemandLoader() {
+  // Waits for the load in progress, if any
+  lock_guard<recursive_mutex> lock(m_mutex);
+  for (const auto &x : m_attached) {
+    x.second();
+  }
+}
+
+bool OnDemandLoader::load_provider(const PluginProduct &product) {
+  auto provider = m_catalog.find_provider(product);
+  if (!provider) {
+    return false;
+  }
+  // Threads that miss while a load is in progress wait here, then find
+  // the library already loaded
+  lock_guard<recursive_mutex> lock(m_mutex);
+  const auto &library = provider->library;
+  if (m_manager.is_loaded(library)) {
+    return true;
+  }
+  // A recursive request can't be served before the library finishes loading
+  if (m_in_flight.count(library)) {
+    return false;
+  }
+  m_in_flight.insert(library);
+  try {
+    m_manager.load_library(library);
+  } catch (...) {
+    m_in_flight.erase(library);
+    throw;
+  }
+  m_in_flight.erase(library);
+  return true;
+}
+}
@@ -0,0 +1,264 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/durable_file.h>
+#include <mwheel/plugin_catalog.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+using namespace std;
+
+namespace mwheel {
+
+namespace {
+
+/// First line of a manifest
+const string manifest_header = "mwheel-plugin-manifest 1";
+
+/**
+ * @brief Checks whether a file name looks like the one of a shared library
+ *
+ * @param[in] path path of the file
+ *
+ * @return true if the file name ends in `.so` or contains `.so.`
+ */
+bool is_shared_library(const boost::filesystem::path &path) {
+  auto name = path.filename().string();
+  auto position = name.rfind(".so");
+  return position != string::npos &&
+         (position + 3 == name.size() || name.find(".so.") != string::npos);
+}
+
+/**
+ * @brief Computes the 64-bit FNV-1a hash of the content of a file
+ *
+ * @param[in] path path of the file
+ *
+ * @return hash of the content of the file
+ */
+uint64_t hash_file(const boost::filesystem::path &path) {
+  uint64_t hash = 14695981039346656037ull;
+  ifstream input(path.string(), ios::binary);
+  vector<char> buffer(1 << 16);
+  while (input) {
+    input.read(buffer.data(), buffer.size());
+    for (auto ii = 0; ii < input.gcount(); ++ii) {
+      hash = (hash ^ static_cast<unsigned char>(buffer[ii])) * 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+/**
+ * @brief Reads the rest of a line, skipping the separator
+ *
+ * @param[in] stream stream positioned right before the separator
+ *
+ * @return the rest of the line
+ */
+string rest_of_line(istream &stream) {
+  string value;
+  stream.get();
+  getline(stream, value);
+  return value;
+}
+}
+
+PluginCatalog::PluginCatalog(boost::filesystem::path manifest_path)
+    : m_manifest_path(std::move(manifest_path)) {
+  if (!boost::filesystem::exists(m_manifest_path)) {
+    return;
+  }
+  ifstream input(m_manifest_path.string());
+  string line;
+  auto line_number = 0u;
+  auto fail = [&](const string &reason) {
+    stringstream estream;
+    estream << "ERROR : invalid plug-in manifest " << m_manifest_path << endl;
+    estream << "\tline " << line_number << ": " << reason << endl;
+    throw invalid_manifest(estream.str());
+  };
+  Entry *current = nullptr;
+  while (getline(input, line)) {
+    ++line_number;
+    if (line_number == 1) {
+      if (line != manifest_header) {
+        fail("unknown header");
+      }
+      continue;
+    }
+    istringstream fields(line);
+    string kind;
+    fields >> kind;
+    if (kind == "library") {
+      Entry entry;
+      fields >> entry.size >> entry.last_write_time >> hex >> entry.hash;
+      entry.library = rest_of_line(fields);
+      if (!fields || entry.library.empty()) {
+        fail("malformed library entry");
+      }
+      current = &(m_entries[entry.library] = std::move(entry));
+    } else if (kind == "product") {
+      PluginProduct product;
+      fields >> product.interface;
+      product.tag = rest_of_line(fields);
+      if (!fields || !current) {
+        fail("malformed product entry");
+      }
+      current->products.push_back(std::move(product));
+    } else if (!kind.empty()) {
+      fail("unknown entry \"" + kind + "\"");
+    }
+  }
+  if (line_number == 0) {
+    fail("empty file");
+  }
+  rebuild_index();
+}
+
+PluginCatalog::ScanReport PluginCatalog::scan(const boost::filesystem::path &directory,
+                                              DLManager &manager, bool recursive) {
+  ScanReport report;
+  // List candidate libraries
+  vector<boost::filesystem::path> candidates;
+  auto consider = [&](const boost::filesystem::directory_entry &x) {
+    if (boost::filesystem::is_regular_file(x.status()) && is_shared_library(x.path())) {
+      candidates.push_back(x.path());
+    }
+  };
+  if (recursive) {
+    for_each(boost::filesystem::recursive_directory_iterator(directory),
+             boost::filesystem::recursive_directory_iterator(), consider);
+  } else {
+    for_each(boost::filesystem::directory_iterator(directory),
+             boost::filesystem::directory_iterator(), consider);
+  }
+  sort(candidates.begin(), candidates.end());
+  // Sort out what changed since the last scan
+  vector<boost::filesystem::path> changed;
+  map<boost::filesystem::path, Entry> pending;
+  for (const auto &x : candidates) {
+    Entry entry;
+    entry.library = x;
+    entry.size = boost::filesystem::file_size(x);
+    entry.last_write_time = boost::filesystem::last_write_time(x);
+    auto it = m_entries.find(x);
+    if (it != m_entries.end() && it->second.size == entry.size &&
+        it->second.last_write_time == entry.last_write_time) {
+      report.unchanged.push_back(x);
+      continue;
+    }
+    // Hash only what is new or looks modified
+    entry.hash = hash_file(x);
+    if (it != m_entries.end() && it->second.size == entry.size && it->second.hash == entry.hash) {
+      it->second.last_write_time = entry.last_write_time;
+      report.unchanged.push_back(x);
+      continue;
+    }
+    changed.push_back(x);
+    pending.insert(make_pair(x, std::move(entry)));
+  }
+  // Load what changed to learn its products
+  report.loaded = manager.load_libraries(changed);
+  for (const auto &x : report.loaded) {
+    if (x.second.valid()) {
+      auto &entry = pending[x.first];
+      entry.products = manager.registered_products(x.first);
+      m_entries[x.first] = std::move(entry);
+    } else {
+      m_entries.erase(x.first);
+    }
+  }
+  // Drop what disappeared from the directory
+  set<boost::filesystem::path> found(candidates.begin(), candidates.end());
+  auto prefix = (directory / "").string();
+  for (auto it = m_entries.begin(); it != m_entries.end();) {
+    const auto &library = it->first;
+    auto in_directory = recursive ? library.string().compare(0, prefix.size(), prefix) == 0
+                                  : library.parent_path() == directory;
+    if (in_directory && !found.count(library)) {
+      report.removed.push_back(library);
+      it = m_entries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  rebuild_index();
+  return report;
+}
+
+void PluginCatalog::save() const {
+  stringstream output;
+  output << manifest_header << '\n';
+  for (const auto &x : m_entries) {
+    const auto &entry = x.second;
+    output << "library " << entry.size << ' ' << entry.last_write_time << ' ' << hex << setw(16)
+           << setfill('0') << entry.hash << dec << ' ' << entry.library.string() << '\n';
+    for (const auto &y : entry.products) {
+      output << "product " << y.interface << ' ' << y.tag << '\n';
+    }
+  }
+  auto text = output.str();
+  try {
+    AtomicFileSink sink(m_manifest_path);
+    sink.write(text.data(), text.size());
+    sink.commit();
+  } catch (const ByteSink::write_error &error) {
+    stringstream estream;
+    estream << "ERROR : cannot write plug-in manifest " << m_manifest_path << endl;
+    estream << "\t" << error.what();
+    throw error_writing_manifest(estream.str());
+  } catch (const AtomicFileSink::commit_error &error) {
+    stringstream estream;
+    estream << "ERROR : cannot write plug-in manifest " << m_manifest_path << endl;
+    estream << "\t" << error.what();
+    throw error_writing_manifest(estream.str());
+  }
+}
+
+const PluginCatalog::Entry *PluginCatalog::find_provider(const PluginProduct &product) const {
+  auto it = m_providers.find(make_pair(product.interface, product.tag));
+  if (it == m_providers.end()) {
+    return nullptr;
+  }
+  return &m_entries.at(it->second);
+}
+
+void PluginCatalog::rebuild_index() {
+  m_providers.clear();
+  for (const auto &x : m_entries) {
+    for (const auto &y : x.second.products) {
+      m_providers.insert(make_pair(make_pair(y.interface, y.tag), x.first));
+    }
+  }
+}
+}
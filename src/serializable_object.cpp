@@ -26,8 +26,165 @@
  *
  */
 
+#include <mwheel/byte_stream.h>
+#include <mwheel/durable_file.h>
+#include <mwheel/mapped_file.h>
 #include <mwheel/serializable_object.h>
 
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
 namespace mwheel {
+
+namespace {
+
+/// Exception thrown if the files of the path adapters can't be used
+MWHEEL_RUNTIME_EXCEPTION(file_error);
+
+/**
+ * @brief Temporary file, removed at destruction
+ */
+class TemporaryFile {
+public:
+  TemporaryFile()
+      : m_path(boost::filesystem::temp_directory_path() /
+               boost::filesystem::unique_path("mwheel-%%%%-%%%%-%%%%-%%%%")) {}
+
+  TemporaryFile(const TemporaryFile &) = delete;
+  TemporaryFile &operator=(const TemporaryFile &) = delete;
+
+  ~TemporaryFile() {
+    boost::system::error_code error;
+    boost::filesystem::remove(m_path, error);
+  }
+
+  /**
+   * @brief Returns the path of the file
+   */
+  const boost::filesystem::path &path() const { return m_path; }
+
+private:
+  /// Path of the file
+  boost::filesystem::path m_path;
+};
+
+/**
+ * @brief File descriptor opened on a path, closed at destruction
+ */
+class File {
+public:
+  File(const boost::filesystem::path &path, int flags) : m_fd(::open(path.c_str(), flags, 0644)) {
+    if (m_fd < 0) {
+      auto error = errno;
+      stringstream estream;
+      estream << "ERROR : cannot open " << path << endl;
+      estream << "\t" << strerror(error) << endl;
+      throw file_error(estream.str());
+    }
+  }
+
+  File(const File &) = delete;
+  File &operator=(const File &) = delete;
+
+  ~File() { ::close(m_fd); }
+
+  /**
+   * @brief Returns the file descriptor
+   */
+  int fd() const { return m_fd; }
+
+private:
+  /// File descriptor
+  int m_fd;
+};
+
+/**
+ * @brief Copies a source to a sink until the source ends
+ */
+void copy(ByteSource &source, ByteSink &sink) {
+  vector<char> buffer(1 << 16);
+  for (auto n = source.read_some(buffer.data(), buffer.size()); n > 0;
+       n = source.read_some(buffer.data(), buffer.size())) {
+    sink.write(buffer.data(), n);
+  }
+}
+}
+
 SerializableObject::~SerializableObject() {}
+
+void SerializableObject::serialize(const boost::filesystem::path &path) const {
+  do_serialize_file(path);
+}
+
+void SerializableObject::deserialize(const boost::filesystem::path &path) {
+  do_deserialize_file(path);
+}
+
+void SerializableObject::serialize(ByteSink &sink) const { do_serialize(sink); }
+
+void SerializableObject::deserialize(ByteSource &source) { do_deserialize(source); }
+
+void SerializableObject::serialize(ostream &stream) const {
+  StreamSink sink(stream);
+  do_serialize(sink);
+}
+
+void SerializableObject::deserialize(istream &stream, size_t size) {
+  StreamSource source(stream, size);
+  do_deserialize(source);
+}
+
+void SerializableObject::serialize_atomically(const boost::filesystem::path &path) const {
+  AtomicFileSink sink(path);
+  do_serialize(sink);
+  sink.commit();
+}
+
+void SerializableObject::deserialize(const MappedFile &file) { do_deserialize_mapped(file); }
+
+void SerializableObject::do_serialize_file(const boost::filesystem::path &path) const {
+  File file(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC);
+  FileDescriptorSink sink(file.fd());
+  do_serialize(sink);
+}
+
+void SerializableObject::do_deserialize_file(const boost::filesystem::path &path) {
+  File file(path, O_RDONLY | O_CLOEXEC);
+  FileDescriptorSource source(file.fd());
+  do_deserialize(source);
+}
+
+void SerializableObject::do_deserialize_mapped(const MappedFile &file) {
+  MemorySource source(file.data(), file.size());
+  do_deserialize(source);
+}
+
+void PathSerializable::do_serialize(ByteSink &sink) const {
+  TemporaryFile temporary;
+  do_serialize_file(temporary.path());
+  File file(temporary.path(), O_RDONLY | O_CLOEXEC);
+  FileDescriptorSource source(file.fd());
+  copy(source, sink);
+}
+
+void PathSerializable::do_deserialize(ByteSource &source) {
+  TemporaryFile temporary;
+  {
+    File file(temporary.path(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC);
+    FileDescriptorSink sink(file.fd());
+    copy(source, sink);
+  }
+  do_deserialize_file(temporary.path());
+}
+
+void PathSerializable::do_deserialize_mapped(const MappedFile &file) {
+  do_deserialize_file(file.path());
+}
 }
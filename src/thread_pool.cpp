@@ -0,0 +1,104 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/thread_pool.h>
+
+#include <algorithm>
+
+using namespace std;
+
+namespace mwheel {
+
+namespace {
+/// Pool the calling thread works for, if any
+thread_local const ThreadPool *current_pool = nullptr;
+}
+
+ThreadPool::ThreadPool(size_t nthreads) : m_stopping(false) {
+  if (nthreads == 0) {
+    nthreads = max(1u, thread::hardware_concurrency());
+  }
+  m_workers.reserve(nthreads);
+  for (size_t ii = 0; ii < nthreads; ++ii) {
+    m_workers.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_ready.notify_all();
+  for (auto &x : m_workers) {
+    x.join();
+  }
+}
+
+void ThreadPool::enqueue(function<void()> task) {
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+  }
+  m_ready.notify_one();
+}
+
+bool ThreadPool::is_worker() const { return current_pool == this; }
+
+bool ThreadPool::run_pending_task() {
+  function<void()> task;
+  {
+    lock_guard<mutex> lock(m_mutex);
+    if (m_tasks.empty()) {
+      return false;
+    }
+    task = std::move(m_tasks.front());
+    m_tasks.pop_front();
+  }
+  task();
+  return true;
+}
+
+void ThreadPool::work() {
+  current_pool = this;
+  for (;;) {
+    function<void()> task;
+    {
+      unique_lock<mutex> lock(m_mutex);
+      m_ready.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+      if (m_tasks.empty()) {
+        return;
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    // Exceptions are stored in the future by std::packaged_task
+    task();
+  }
+}
+}
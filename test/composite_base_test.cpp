@@ -27,6 +27,7 @@
  */
 
 #include <mwheel/composite_base.h>
+#include <mwheel/object_arena.h>
 
 #include <boost/test/unit_test.hpp>
 #include <boost/test/unit_test_suite.hpp>
@@ -50,16 +51,32 @@ public:
   int get() const override { return 5; }
 };
 
-class Composite : public mwheel::CompositeBase<Base> {
+template <class StoredType = shared_ptr<Base>>
+class GenericComposite : public mwheel::CompositeBase<Base, StoredType> {
 public:
   int get() const override {
     auto sum = 0;
-    for (const auto &x : m_items) {
+    for (const auto &x : this->m_items) {
       sum += x->get();
     }
     return sum;
   }
 };
+
+using Composite = GenericComposite<>;
+using UniqueComposite = GenericComposite<unique_ptr<Base>>;
+using RawComposite = GenericComposite<Base *>;
+
+class Tracked : public Base {
+public:
+  Tracked(vector<int> &destroyed, int value) : m_destroyed(destroyed), m_value(value) {}
+  int get() const override { return m_value; }
+  ~Tracked() { m_destroyed.push_back(m_value); }
+
+private:
+  vector<int> &m_destroyed;
+  int m_value;
+};
 }
 
 BOOST_AUTO_TEST_SUITE(CompositeBaseTest)
@@ -93,4 +110,51 @@ BOOST_AUTO_TEST_CASE(BasicOperations) {
   BOOST_CHECK_EQUAL(composite->empty(), true);
   BOOST_CHECK_EQUAL(composite->size(), 0);
 }
+
+BOOST_AUTO_TEST_CASE(UniqueOwnership) {
+  UniqueComposite composite;
+  auto get_3 = unique_ptr<Get3>(new Get3);
+  composite.push_back(std::move(get_3));
+  composite.push_back(unique_ptr<Base>(new Get5));
+  composite.push_back(unique_ptr<Base>(new Get5));
+  BOOST_CHECK(!get_3);
+  BOOST_CHECK_EQUAL(composite.size(), 3);
+  BOOST_CHECK_EQUAL(composite.get(), 13);
+  // Move a child to another composite
+  UniqueComposite other;
+  other.push_back(composite.extract(0));
+  BOOST_CHECK_EQUAL(composite.size(), 2);
+  BOOST_CHECK_EQUAL(composite.get(), 10);
+  BOOST_CHECK_EQUAL(other.get(), 3);
+  // Remove children
+  composite.erase(1);
+  BOOST_CHECK_EQUAL(composite.get(), 5);
+  composite.pop_back();
+  BOOST_CHECK_EQUAL(composite.empty(), true);
+  BOOST_CHECK_THROW(composite.pop_back(), std::out_of_range);
+  BOOST_CHECK_THROW(composite.erase(0), std::out_of_range);
+  BOOST_CHECK_THROW(other.extract(1), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(ArenaOwnership) {
+  vector<int> destroyed;
+  {
+    mwheel::ObjectArena arena(64);
+    RawComposite composite;
+    for (auto ii = 0; ii < 10; ++ii) {
+      composite.push_back(arena.create<Tracked>(destroyed, ii));
+    }
+    composite.push_back(arena.create<Get3>());
+    BOOST_CHECK_EQUAL(arena.size(), 11);
+    BOOST_CHECK_EQUAL(composite.get(), 48);
+    // Removing a child does not destroy it
+    composite.erase(0);
+    composite.clear();
+    BOOST_CHECK(destroyed.empty());
+  }
+  // The arena destroys its objects in reverse order of construction
+  BOOST_CHECK_EQUAL(destroyed.size(), 10);
+  BOOST_CHECK_EQUAL(destroyed.front(), 9);
+  BOOST_CHECK_EQUAL(destroyed.back(), 0);
+}
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -33,8 +33,40 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/test/unit_test_suite.hpp>
 
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dlfcn.h>
+
 using namespace std;
 
+namespace {
+/**
+ * @brief Descriptor of mwheel::test::ClientInterface, as seen by newer or
+ * different applications
+ */
+template <class TagType, uint32_t Major, uint32_t Minor> struct ClientInterfaceAt {
+  static constexpr mwheel::PluginDescriptor plugin_descriptor() {
+    return mwheel::implementation::make_plugin_descriptor(
+        mwheel::implementation::type_hash<mwheel::test::ClientInterface>(),
+        mwheel::implementation::type_hash<TagType>(), Major, Minor, 0);
+  }
+};
+
+/// Unrelated interface that happens to have the same unqualified name
+namespace unrelated {
+struct ClientInterface {
+  using clone_type = std::shared_ptr<ClientInterface>;
+  MWHEEL_EXPOSE_VERSIONED_INTERFACE_FACTORY(ClientInterface, std::string, 2, 0, 0);
+};
+}
+}
+
 BOOST_AUTO_TEST_SUITE(DLManagerTest)
 BOOST_AUTO_TEST_CASE(DynamicLibraryLoading) {
   using TheFactory = mwheel::test::ClientInterface::factory_type;
@@ -66,4 +98,415 @@ BOOST_AUTO_TEST_CASE(DynamicLibraryUnloading) {
   manager.load_library(external_path);
   BOOST_CHECK_NO_THROW(manager.unload_library(external_path));
 }
+
+BOOST_AUTO_TEST_CASE(BatchLoading) {
+  using TheFactory = mwheel::test::ClientInterface::factory_type;
+  auto fixtures = boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures");
+  auto external_path = fixtures / "libplugin_extension_test.so";
+  auto dependent_path = fixtures / "libdependent_extension_test.so";
+  auto missing_path = fixtures / "this_does_not_exist.so";
+  mwheel::DLManager manager;
+  // The dependent library comes first in the request, but must be loaded last
+  auto manifest = mwheel::DLManager::dependency_manifest_type{{dependent_path, {external_path}}};
+  auto report = manager.load_libraries(
+      vector<boost::filesystem::path>{dependent_path, missing_path, external_path}, manifest);
+  BOOST_REQUIRE_EQUAL(report.size(), 3);
+  BOOST_CHECK_EQUAL(report[0].first, dependent_path);
+  BOOST_CHECK_EQUAL(report[0].second.valid(), true);
+  BOOST_CHECK_EQUAL(report[2].second.valid(), true);
+  BOOST_CHECK(report[2].second.get().dlopen.count() > 0);
+  // A failure does not stop the batch
+  BOOST_CHECK_EQUAL(report[1].second.valid(), false);
+  BOOST_CHECK_EQUAL(
+      report[1].second.has_exception<mwheel::DLManager::error_loading_dynamic_library>(), true);
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("DependentExtension")->get(), 30);
+  BOOST_CHECK_NO_THROW(manager.unload_library(dependent_path));
+  BOOST_CHECK_NO_THROW(manager.unload_library(external_path));
+}
+
+BOOST_AUTO_TEST_CASE(BatchLoadingNeeded) {
+  using TheFactory = mwheel::test::ClientInterface::factory_type;
+  auto fixtures = boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures");
+  auto external_path = fixtures / "libplugin_extension_test.so";
+  auto needed_path = fixtures / "libneeded_extension_test.so";
+  mwheel::DLManager manager;
+  // No manifest: the order comes from the DT_NEEDED entries alone
+  auto report =
+      manager.load_libraries(vector<boost::filesystem::path>{needed_path, external_path});
+  BOOST_REQUIRE_EQUAL(report.size(), 2);
+  BOOST_CHECK_EQUAL(report[0].second.valid(), true);
+  BOOST_CHECK_EQUAL(report[1].second.valid(), true);
+  // Opened first, the dependency would have been initialized by the dynamic linker
+  // on behalf of the dependent library, and its products recorded for the latter
+  BOOST_CHECK_EQUAL(manager.registered_products(external_path).size(), 2);
+  auto products = manager.registered_products(needed_path);
+  BOOST_REQUIRE_EQUAL(products.size(), 1);
+  BOOST_CHECK_EQUAL(products[0].tag, "DependentExtension");
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("DependentExtension")->get(), 30);
+  BOOST_CHECK_NO_THROW(manager.unload_library(needed_path));
+  BOOST_CHECK_NO_THROW(manager.unload_library(external_path));
+}
+
+BOOST_AUTO_TEST_CASE(BatchLoadingFailures) {
+  auto fixtures = boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures");
+  auto external_path = fixtures / "libplugin_extension_test.so";
+  auto dependent_path = fixtures / "libdependent_extension_test.so";
+  auto missing_path = fixtures / "this_does_not_exist.so";
+  mwheel::DLManager manager;
+  // Libraries whose dependencies failed are not loaded
+  auto report = manager.load_libraries(
+      vector<boost::filesystem::path>{dependent_path, missing_path},
+      mwheel::DLManager::dependency_manifest_type{{dependent_path, {missing_path}}});
+  BOOST_CHECK_EQUAL(report[0].second.valid(), false);
+  BOOST_CHECK_EQUAL(report[1].second.valid(), false);
+  BOOST_CHECK_THROW(manager.unload_library(dependent_path), mwheel::DLManager::library_not_loaded);
+  // Circular dependencies are detected
+  report = manager.load_libraries(vector<boost::filesystem::path>{dependent_path, external_path},
+                                  mwheel::DLManager::dependency_manifest_type{
+                                      {dependent_path, {external_path}},
+                                      {external_path, {dependent_path}}});
+  BOOST_CHECK_EQUAL(report[0].second.valid(), false);
+  BOOST_CHECK_EQUAL(report[1].second.valid(), false);
+}
+
+BOOST_AUTO_TEST_CASE(LoadOptionsAndTimings) {
+  using TheFactory = mwheel::test::ClientInterface::factory_type;
+  auto external_path =
+      boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures/libplugin_extension_test.so");
+  mwheel::DLManager manager;
+  mwheel::DLManager::LoadOptions options;
+  options.binding = mwheel::DLManager::LoadOptions::Binding::now;
+  options.deep_bind = true;
+  auto timings = manager.load_library(external_path, options);
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("PluginExtension")->get(), 10);
+  // Registrations happen in static initializers, after relocation
+  BOOST_CHECK(timings.static_initialization.count() > 0);
+  BOOST_CHECK(timings.relocation.count() > 0);
+  BOOST_CHECK(timings.relocation + timings.static_initialization == timings.dlopen);
+  // Reloading keeps the options
+  BOOST_CHECK_NO_THROW(manager.reload_library(external_path));
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("PluginExtension")->get(), 10);
+  BOOST_CHECK_NO_THROW(manager.unload_library(external_path));
+}
+
+BOOST_AUTO_TEST_CASE(ProductTable) {
+  using TheFactory = mwheel::test::ClientInterface::factory_type;
+  using FactoryType = mwheel::PrototypeFactory<mwheel::test::ClientInterface, string>;
+  auto table_path =
+      boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures/libtable_extension_test.so");
+  mwheel::DLManager manager;
+  auto timings = manager.load_library(table_path);
+  BOOST_CHECK(timings.table_import.count() > 0);
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("TableExtension")->get(), 40);
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("AnotherTableExtension")->get(), 40);
+  BOOST_CHECK_EQUAL(manager.registered_products(table_path).size(), 2);
+  // Tables are imported on reload too
+  manager.reload_library(table_path);
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("TableExtension")->get(), 40);
+  manager.unload_library(table_path);
+  BOOST_CHECK_THROW(TheFactory::get_instance().create("TableExtension"),
+                    FactoryType::tag_not_registered);
+  // A tag already taken fails the load, undoing the other imports
+  auto external_path = table_path.parent_path() / "libplugin_extension_test.so";
+  manager.load_library(external_path);
+  auto taken = TheFactory::get_instance().create("PluginExtension");
+  BOOST_REQUIRE(TheFactory::get_instance().register_prototype("AnotherTableExtension", taken));
+  BOOST_CHECK_THROW(manager.load_library(table_path),
+                    mwheel::DLManager::error_loading_dynamic_library);
+  BOOST_CHECK(!manager.is_loaded(table_path));
+  BOOST_CHECK_THROW(TheFactory::get_instance().create("TableExtension"),
+                    FactoryType::tag_not_registered);
+  TheFactory::get_instance().unregister_prototype("AnotherTableExtension");
+  manager.load_library(table_path);
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("AnotherTableExtension")->get(), 40);
+  taken.reset();
+  manager.unload_all();
+}
+
+BOOST_AUTO_TEST_CASE(PluginDescriptors) {
+  using TheFactory = mwheel::test::ClientInterface::factory_type;
+  using FactoryType = mwheel::PrototypeFactory<mwheel::test::ClientInterface, string>;
+  auto external_path =
+      boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures/libplugin_extension_test.so");
+  auto table_path =
+      boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures/libtable_extension_test.so");
+  // Plug-ins built against an older minor version are accepted
+  {
+    mwheel::DLManager manager;
+    manager.require_interface<mwheel::test::ClientInterface>();
+    manager.require_interface<ClientInterfaceAt<string, 1, 3>>();
+    manager.load_library(external_path);
+    BOOST_CHECK_EQUAL(TheFactory::get_instance().create("PluginExtension")->get(), 10);
+  }
+  // Interfaces are told apart by their fully qualified names
+  {
+    mwheel::DLManager manager;
+    manager.require_interface<unrelated::ClientInterface>();
+    manager.load_library(external_path);
+    BOOST_CHECK(manager.is_loaded(external_path));
+  }
+  static_assert(mwheel::test::ClientInterface::plugin_descriptor().interface_hash !=
+                    unrelated::ClientInterface::plugin_descriptor().interface_hash,
+                "interfaces with the same unqualified name must differ");
+  static_assert(ClientInterfaceAt<std::string, 1, 0>::plugin_descriptor().tag_type_hash ==
+                    ClientInterfaceAt<std::basic_string<char>, 1, 0>::plugin_descriptor()
+                        .tag_type_hash,
+                "aliases of the tag type must be resolved");
+  // A different major version or tag type is rejected before any registration
+  {
+    mwheel::DLManager manager;
+    manager.require_interface<ClientInterfaceAt<string, 2, 0>>();
+    BOOST_CHECK_THROW(manager.load_library(external_path), mwheel::DLManager::incompatible_plugin);
+    BOOST_CHECK(!manager.is_loaded(external_path));
+    BOOST_CHECK_THROW(TheFactory::get_instance().create("PluginExtension"),
+                      FactoryType::tag_not_registered);
+  }
+  {
+    mwheel::DLManager manager;
+    manager.require_interface<ClientInterfaceAt<int, 1, 0>>();
+    BOOST_CHECK_THROW(manager.load_library(external_path), mwheel::DLManager::incompatible_plugin);
+    // Libraries without a descriptor are accepted unless asked otherwise
+    manager.load_library(table_path);
+    manager.unload_library(table_path);
+    mwheel::DLManager::LoadOptions options;
+    options.require_descriptor = true;
+    BOOST_CHECK_THROW(manager.load_library(table_path, options),
+                      mwheel::DLManager::incompatible_plugin);
+  }
+  // A descriptor that is not in the file can't be checked, and is rejected
+  {
+    mwheel::DLManager manager;
+    auto late_path = boost::filesystem::path(
+        "@CMAKE_CURRENT_BINARY_DIR@/fixtures/liblate_descriptor_test.so");
+    BOOST_CHECK_THROW(manager.load_library(late_path), mwheel::DLManager::incompatible_plugin);
+    BOOST_CHECK(!manager.is_loaded(late_path));
+  }
+  // The C++ ABI is checked only for the required interfaces
+  {
+    mwheel::DLManager manager;
+    auto foreign_path =
+        boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures/libforeign_abi_test.so");
+    manager.load_library(foreign_path);
+    manager.unload_library(foreign_path);
+    manager.require_interface<mwheel::test::ClientInterface>();
+    BOOST_CHECK_THROW(manager.load_library(foreign_path), mwheel::DLManager::incompatible_plugin);
+    BOOST_CHECK(!manager.is_loaded(foreign_path));
+  }
+  // Long type names are hashed at compile-time all the same
+  using Pair = pair<string, string>;
+  using Quad = pair<Pair, Pair>;
+  using Octet = pair<Quad, Quad>;
+  using LongName = map<pair<Octet, Octet>, vector<pair<Octet, Octet>>>;
+  static_assert(mwheel::implementation::type_signature<LongName>().size > 1000,
+                "the name of the type must exceed the recursion limit of the old hash");
+  static_assert(ClientInterfaceAt<LongName, 1, 0>::plugin_descriptor().tag_type_hash !=
+                    ClientInterfaceAt<string, 1, 0>::plugin_descriptor().tag_type_hash,
+                "long type names must be hashed");
+}
+
+BOOST_AUTO_TEST_CASE(WarmUp) {
+  auto external_path =
+      boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures/libplugin_extension_test.so");
+  mwheel::DLManager manager;
+  BOOST_CHECK_THROW(manager.warm_up(external_path), mwheel::DLManager::library_not_loaded);
+  manager.load_library(external_path);
+  auto report = manager.warm_up(external_path);
+  BOOST_CHECK(report.pages > 0);
+  BOOST_CHECK_EQUAL(report.locked_pages, 0);
+  BOOST_CHECK_EQUAL(report.huge_pages, 0);
+  // Locking is best effort, but never exceeds the pages touched
+  mwheel::DLManager::WarmUpOptions options;
+  options.lock = true;
+  options.huge_pages = true;
+  auto locked_report = manager.warm_up(external_path, options);
+  BOOST_CHECK_EQUAL(locked_report.pages, report.pages);
+  BOOST_CHECK(locked_report.locked_pages <= locked_report.pages);
+  BOOST_CHECK(locked_report.huge_pages <= locked_report.pages);
+}
+
+BOOST_AUTO_TEST_CASE(SymbolLookup) {
+  auto external_path =
+      boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures/libplugin_extension_test.so");
+  mwheel::DLManager manager;
+  BOOST_CHECK_THROW(manager.get_symbol<int()>(external_path, "plugin_extension_value"),
+                    mwheel::DLManager::library_not_loaded);
+  manager.load_library(external_path);
+  auto value = manager.get_symbol<int()>(external_path, "plugin_extension_value");
+  BOOST_CHECK_EQUAL(value(), 10);
+  BOOST_CHECK_EQUAL(manager.get_symbol<int()>(external_path, "plugin_extension_value"), value);
+  BOOST_CHECK_THROW(manager.get_symbol<int()>(external_path, "not_a_symbol"),
+                    mwheel::DLManager::symbol_not_found);
+  // Bulk binding is all or nothing
+  int (*scale)(int) = nullptr;
+  value = nullptr;
+  BOOST_CHECK_THROW(manager.bind(external_path,
+                                 {mwheel::DLManager::binding("plugin_extension_value", value),
+                                  mwheel::DLManager::binding("not_a_symbol", scale)}),
+                    mwheel::DLManager::symbol_not_found);
+  BOOST_CHECK(value == nullptr);
+  manager.bind(external_path, {mwheel::DLManager::binding("plugin_extension_value", value),
+                               mwheel::DLManager::binding("plugin_extension_scale", scale)});
+  BOOST_CHECK_EQUAL(value(), 10);
+  BOOST_CHECK_EQUAL(scale(3), 30);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentAccess) {
+  using TheFactory = mwheel::test::ClientInterface::factory_type;
+  auto fixtures = boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures");
+  auto external_path = fixtures / "libplugin_extension_test.so";
+  auto dependent_path = fixtures / "libdependent_extension_test.so";
+  mwheel::DLManager manager;
+  // Concurrent loads of the same library share a single dlopen (Boost.Test
+  // assertions are not thread-safe: workers only count failures)
+  atomic<int> failures(0);
+  vector<thread> workers;
+  for (int ii = 0; ii < 8; ++ii) {
+    workers.emplace_back([&]() {
+      manager.load_library(external_path);
+      if (!manager.is_loaded(external_path) ||
+          manager.get_symbol<int()>(external_path, "plugin_extension_value")() != 10) {
+        ++failures;
+      }
+    });
+  }
+  for (auto &x : workers) {
+    x.join();
+  }
+  workers.clear();
+  BOOST_CHECK_EQUAL(failures.load(), 0);
+  BOOST_CHECK_EQUAL(manager.registered_products(external_path).size(), 2);
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("PluginExtension")->get(), 10);
+  // Readers run while another library is loaded and unloaded
+  atomic<bool> done(false);
+  atomic<long> reads(0);
+  for (int ii = 0; ii < 4; ++ii) {
+    workers.emplace_back([&]() {
+      while (!done) {
+        manager.is_loaded(dependent_path);
+        if (!manager.is_loaded(external_path) ||
+            manager.registered_products(external_path).size() != 2) {
+          ++failures;
+        }
+        ++reads;
+      }
+    });
+  }
+  // Readers must overlap the updates, even on a loaded machine
+  while (reads.load() == 0) {
+    this_thread::yield();
+  }
+  for (int ii = 0; ii < 20; ++ii) {
+    manager.load_library(dependent_path);
+    BOOST_CHECK_EQUAL(TheFactory::get_instance().create("DependentExtension")->get(), 30);
+    manager.unload_library(dependent_path);
+  }
+  done = true;
+  for (auto &x : workers) {
+    x.join();
+  }
+  BOOST_CHECK_EQUAL(failures.load(), 0);
+  BOOST_CHECK(reads.load() > 0);
+  BOOST_CHECK_NO_THROW(manager.unload_library(external_path));
+}
+
+BOOST_AUTO_TEST_CASE(ResidentReload) {
+  using TheFactory = mwheel::test::ClientInterface::factory_type;
+  using FactoryType = mwheel::PrototypeFactory<mwheel::test::ClientInterface, string>;
+  auto fixtures = boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures");
+  auto external_path = fixtures / "libplugin_extension_test.so";
+  mwheel::DLManager manager;
+  manager.load_library(external_path);
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("PluginExtension")->get(), 10);
+  // A foreign handle keeps the library resident after the manager unloads it
+  auto handle = dlopen(external_path.c_str(), RTLD_NOW | RTLD_LOCAL | RTLD_NOLOAD);
+  BOOST_REQUIRE(handle);
+  auto value = dlsym(handle, "plugin_extension_value");
+  for (int ii = 0; ii < 3; ++ii) {
+    manager.unload_library(external_path);
+    BOOST_CHECK_THROW(TheFactory::get_instance().create("PluginExtension"),
+                      FactoryType::tag_not_registered);
+    // The resident instance is reused and its products are registered again
+    manager.load_library(external_path);
+    BOOST_CHECK_EQUAL(manager.registered_products(external_path).size(), 2);
+    BOOST_CHECK_EQUAL(TheFactory::get_instance().create("PluginExtension")->get(), 10);
+    BOOST_CHECK(manager.get_symbol<int()>(external_path, "plugin_extension_value") ==
+                reinterpret_cast<int (*)()>(value));
+  }
+  manager.unload_library(external_path);
+  dlclose(handle);
+}
+
+BOOST_AUTO_TEST_CASE(Teardown) {
+  using TheFactory = mwheel::test::ClientInterface::factory_type;
+  using FactoryType = mwheel::PrototypeFactory<mwheel::test::ClientInterface, string>;
+  auto fixtures = boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures");
+  auto external_path = fixtures / "libplugin_extension_test.so";
+  auto dependent_path = fixtures / "libdependent_extension_test.so";
+  {
+    mwheel::DLManager manager;
+    manager.load_libraries(
+        vector<boost::filesystem::path>{dependent_path, external_path},
+        mwheel::DLManager::dependency_manifest_type{{dependent_path, {external_path}}});
+    BOOST_CHECK(manager.unload_all().empty());
+    BOOST_CHECK(!manager.is_loaded(external_path));
+    BOOST_CHECK(!manager.is_loaded(dependent_path));
+    BOOST_CHECK_THROW(TheFactory::get_instance().create("DependentExtension"),
+                      FactoryType::tag_not_registered);
+    // The manager can be used again afterwards
+    manager.load_library(external_path);
+    BOOST_CHECK_EQUAL(TheFactory::get_instance().create("PluginExtension")->get(), 10);
+  }
+  BOOST_CHECK_THROW(TheFactory::get_instance().create("PluginExtension"),
+                    FactoryType::tag_not_registered);
+  // Skipping dlclose leaves the library mapped (use a private copy not to leak the fixture)
+  auto directory = boost::filesystem::temp_directory_path() /
+                   boost::filesystem::unique_path("mwheel-%%%%-%%%%-%%%%");
+  boost::filesystem::create_directory(directory);
+  auto copy_path = directory / external_path.filename();
+  boost::filesystem::copy_file(external_path, copy_path);
+  {
+    mwheel::DLManager manager;
+    manager.load_library(copy_path);
+    mwheel::DLManager::TeardownOptions options;
+    options.skip_dlclose = true;
+    options.parallel = false;
+    BOOST_CHECK(manager.unload_all(options).empty());
+    BOOST_CHECK(!manager.is_loaded(copy_path));
+    BOOST_CHECK_THROW(TheFactory::get_instance().create("PluginExtension"),
+                      FactoryType::tag_not_registered);
+  }
+  auto handle = dlopen(copy_path.c_str(), RTLD_LAZY | RTLD_NOLOAD);
+  BOOST_CHECK(handle != nullptr);
+  if (handle) {
+    dlclose(handle);
+  }
+  boost::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(HotReload) {
+  using TheFactory = mwheel::test::ClientInterface::factory_type;
+  using FactoryType = mwheel::PrototypeFactory<mwheel::test::ClientInterface, string>;
+  auto fixtures = boost::filesystem::path("@CMAKE_CURRENT_BINARY_DIR@/fixtures");
+  auto external_path = fixtures / "libplugin_extension_test.so";
+  auto replacement_path = fixtures / "libplugin_extension_v2_test.so";
+  mwheel::DLManager manager;
+  BOOST_CHECK_THROW(manager.reload_library(external_path), mwheel::DLManager::library_not_loaded);
+  manager.load_library(external_path);
+  auto old_object = TheFactory::get_instance().create("PluginExtension");
+  BOOST_CHECK_EQUAL(old_object->get(), 10);
+  // New products come from the replacement, old ones keep working
+  manager.reload_library(external_path, replacement_path);
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("PluginExtension")->get(), 11);
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("AnotherExtension")->get(), 11);
+  BOOST_CHECK_EQUAL(old_object->get(), 10);
+  BOOST_CHECK_EQUAL(old_object->clone()->get(), 10);
+  old_object.reset();
+  // Reloading from the same file loads a fresh copy of it
+  manager.reload_library(external_path);
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().create("PluginExtension")->get(), 10);
+  BOOST_CHECK_EQUAL(manager.registered_products(external_path).size(), 2);
+  BOOST_CHECK_NO_THROW(manager.unload_library(external_path));
+  BOOST_CHECK_THROW(TheFactory::get_instance().create("PluginExtension"),
+                    FactoryType::tag_not_registered);
+}
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
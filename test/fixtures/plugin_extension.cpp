@@ -42,4 +42,13 @@ MWHEEL_REGISTER_TAG_PLUGIN_OBJECT_PAIR("PluginExtension", make_shared<PluginExte
     MWHEEL_REGISTER_TAG_PLUGIN_OBJECT_PAIR("AnotherExtension", make_shared<PluginExtension>())
     MWHEEL_REGISTER_PLUGIN_PRODUCT_END();
 }
+}
+
+MWHEEL_PLUGIN_DESCRIPTOR(mwheel::test::ClientInterface);
+
+/// Entry points resolved by name at run-time
+extern "C" {
+int plugin_extension_value() { return PLUGIN_EXTENSION_VALUE; }
+
+int plugin_extension_scale(int x) { return PLUGIN_EXTENSION_VALUE * x; }
 }
\ No newline at end of file
@@ -45,6 +45,10 @@
 #include <functional>
 #include <vector>
 
+#ifndef PLUGIN_EXTENSION_VALUE
+#define PLUGIN_EXTENSION_VALUE 10
+#endif
+
 namespace mwheel {
 namespace test {
 
@@ -55,7 +59,7 @@ public:
   ClientInterface::clone_type clone() override;
 
 private:
-  int m_int = 10;
+  int m_int = PLUGIN_EXTENSION_VALUE;
   MWHEEL_REGISTRABLE_PRODUCT;
 };
 }
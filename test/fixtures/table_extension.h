@@ -0,0 +1,58 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+/**
+ * @file table_extension.h
+ *
+ * @brief Mimics an external extension that lists its products in a table
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026, 4:10 PM
+ */
+
+#ifndef TABLE_EXTENSION_H_20261018
+#define TABLE_EXTENSION_H_20261018
+
+#include <fixtures/client_interface.h>
+
+namespace mwheel {
+namespace test {
+
+class TableExtension : public ClientInterface {
+public:
+  int get() override;
+
+  ClientInterface::clone_type clone() override;
+
+private:
+  int m_int = 40;
+};
+}
+}
+
+#endif /* TABLE_EXTENSION_H_20261018 */
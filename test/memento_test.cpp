@@ -0,0 +1,527 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/async_memento_originator.h>
+#include <mwheel/byte_stream.h>
+#include <mwheel/delta_memento_originator.h>
+#include <mwheel/memento_history.h>
+#include <mwheel/memento_log.h>
+#include <mwheel/memento_pool.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include <cstddef>
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+namespace {
+/// Change of a single cell of a Grid
+struct CellChange {
+  size_t index;
+  int before;
+  int after;
+};
+
+/// Large state that changes a few cells at a time
+class Grid : public mwheel::DeltaMementoOriginator<CellChange> {
+public:
+  explicit Grid(size_t size) : m_cells(size, 0) {}
+
+  void set(size_t index, int value) {
+    record(CellChange{index, m_cells[index], value});
+    m_cells[index] = value;
+  }
+
+  int get(size_t index) const { return m_cells[index]; }
+
+  const vector<int> &cells() const { return m_cells; }
+
+  /// Keeps a single change per cell
+  bool coalesce(vector<CellChange> &deltas) const override {
+    map<size_t, size_t> position;
+    vector<CellChange> merged;
+    for (const auto &x : deltas) {
+      auto it = position.find(x.index);
+      if (it == position.end()) {
+        position[x.index] = merged.size();
+        merged.push_back(x);
+      } else {
+        merged[it->second].after = x.after;
+      }
+    }
+    deltas.swap(merged);
+    return true;
+  }
+
+private:
+  void apply(const CellChange &delta) override { m_cells[delta.index] = delta.after; }
+  void revert(const CellChange &delta) override { m_cells[delta.index] = delta.before; }
+
+  vector<int> m_cells;
+};
+
+/// Grid that keeps every change, with the default coalesce
+class Tape : public mwheel::DeltaMementoOriginator<CellChange> {
+public:
+  explicit Tape(size_t size) : m_cells(size, 0) {}
+
+  void set(size_t index, int value) {
+    record(CellChange{index, m_cells[index], value});
+    m_cells[index] = value;
+  }
+
+  const vector<int> &cells() const { return m_cells; }
+
+private:
+  void apply(const CellChange &delta) override { m_cells[delta.index] = delta.after; }
+  void revert(const CellChange &delta) override { m_cells[delta.index] = delta.before; }
+
+  vector<int> m_cells;
+};
+
+/// Abstract memento
+class Snapshot {
+public:
+  virtual int value() const = 0;
+  virtual ~Snapshot() {}
+};
+
+/// Originator that checkpoints at a high rate
+class Counter : public mwheel::MementoOriginator<Snapshot> {
+public:
+  Counter() : m_value(0) {}
+
+  memento_type create_memento() const override { return m_pool.make<CounterSnapshot>(m_value); }
+
+  void set_state(memento_type token) override { m_value = token->value(); }
+
+  void increment() { ++m_value; }
+
+  int value() const { return m_value; }
+
+  mwheel::MementoPool<Snapshot>::Statistics statistics() const { return m_pool.statistics(); }
+
+  void shrink() { m_pool.shrink(); }
+
+private:
+  class CounterSnapshot : public Snapshot {
+  public:
+    explicit CounterSnapshot(int value) : m_value(value) {}
+    int value() const override { return m_value; }
+
+  private:
+    int m_value;
+  };
+
+  int m_value;
+  mutable mwheel::MementoPool<Snapshot> m_pool;
+};
+
+/// Memento with a binary fast path
+class Checkpoint : public Snapshot, public mwheel::SerializableObject {
+public:
+  Checkpoint() : m_value(0) {}
+  explicit Checkpoint(int value) : m_value(value) {}
+
+  int value() const override { return m_value; }
+
+protected:
+  void do_serialize_file(const boost::filesystem::path &path) const override {
+    ofstream(path.c_str()) << m_value;
+  }
+
+  void do_deserialize_file(const boost::filesystem::path &path) override {
+    ifstream(path.c_str()) >> m_value;
+  }
+
+  void do_serialize(mwheel::ByteSink &sink) const override {
+    sink.write(&m_value, sizeof(m_value));
+  }
+
+  void do_deserialize(mwheel::ByteSource &source) override {
+    source.read(&m_value, sizeof(m_value));
+  }
+
+private:
+  int m_value;
+};
+
+/// Memento that knows only about files
+class FileCheckpoint : public mwheel::PathSerializable {
+public:
+  FileCheckpoint() {}
+  explicit FileCheckpoint(string text) : m_text(std::move(text)) {}
+
+  const string &text() const { return m_text; }
+
+protected:
+  void do_serialize_file(const boost::filesystem::path &path) const override {
+    ofstream(path.c_str(), ios::binary) << m_text;
+  }
+
+  void do_deserialize_file(const boost::filesystem::path &path) override {
+    ifstream input(path.c_str(), ios::binary);
+    m_text.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+  }
+
+private:
+  string m_text;
+};
+
+/// Large state captured in the background
+class Document : public mwheel::AsyncMementoOriginator<vector<int>, vector<int>> {
+public:
+  Document(mwheel::ThreadPool &pool, shared_future<void> gate)
+      : AsyncMementoOriginator(make_shared<vector<int>>(1 << 16, 0),
+                               [gate](const vector<int> &x) {
+                                 gate.wait();
+                                 return make_shared<vector<int>>(x);
+                               },
+                               pool) {}
+
+  void set(size_t index, int value) { mutable_state()[index] = value; }
+
+  int get(size_t index) const { return state()[index]; }
+
+  void set_state(memento_type token) override { replace_state(std::move(token)); }
+};
+}
+
+BOOST_AUTO_TEST_SUITE(MementoTest)
+BOOST_AUTO_TEST_CASE(DeltaMementos) {
+  Grid grid(1 << 20);
+  auto initial = grid.create_memento();
+  BOOST_CHECK_EQUAL(initial->depth(), 0);
+  // Nothing changed: no new memento
+  BOOST_CHECK_EQUAL(grid.create_memento(), initial);
+  grid.set(1, 10);
+  grid.set(2, 20);
+  BOOST_CHECK_EQUAL(grid.pending_changes(), 2);
+  auto first = grid.create_memento();
+  BOOST_CHECK_EQUAL(grid.pending_changes(), 0);
+  BOOST_CHECK_EQUAL(first->deltas().size(), 2);
+  BOOST_CHECK_EQUAL(first->parent(), initial);
+  grid.set(1, 11);
+  auto second = grid.create_memento();
+  BOOST_CHECK_EQUAL(second->depth(), 2);
+  // Changes not yet in a memento are discarded too
+  grid.set(3, 30);
+  grid.set_state(first);
+  BOOST_CHECK_EQUAL(grid.get(1), 10);
+  BOOST_CHECK_EQUAL(grid.get(2), 20);
+  BOOST_CHECK_EQUAL(grid.get(3), 0);
+  // Branch off an earlier memento, then jump across branches
+  grid.set(2, 21);
+  auto branch = grid.create_memento();
+  BOOST_CHECK_EQUAL(branch->parent(), first);
+  grid.set_state(second);
+  BOOST_CHECK_EQUAL(grid.get(1), 11);
+  BOOST_CHECK_EQUAL(grid.get(2), 20);
+  grid.set_state(branch);
+  BOOST_CHECK_EQUAL(grid.get(1), 10);
+  BOOST_CHECK_EQUAL(grid.get(2), 21);
+  grid.set_state(initial);
+  BOOST_CHECK_EQUAL(grid.get(1), 0);
+  BOOST_CHECK_EQUAL(grid.get(2), 0);
+  // Mementos of other objects are rejected
+  Grid other(4);
+  BOOST_CHECK_THROW(other.set_state(second), Grid::foreign_memento);
+  BOOST_CHECK_THROW(other.set_state(nullptr), Grid::foreign_memento);
+}
+
+BOOST_AUTO_TEST_CASE(LongDeltaChains) {
+  Grid grid(16);
+  for (auto ii = 0; ii < 200000; ++ii) {
+    grid.set(ii % 16, ii);
+    grid.create_memento();
+  }
+  BOOST_CHECK_EQUAL(grid.create_memento()->depth(), 200000);
+  // Releasing the whole chain must not overflow the stack
+}
+BOOST_AUTO_TEST_CASE(HistoryAccess) {
+  using History = mwheel::MementoHistory<CellChange>;
+  Grid grid(64);
+  History::Options options;
+  options.keyframe_interval = 4;
+  History history(grid, options);
+  vector<vector<int>> states;
+  vector<History::sequence_type> sequences;
+  for (auto ii = 0; ii < 40; ++ii) {
+    grid.set(ii % 8, ii);
+    grid.set((ii * 7) % 64, -ii);
+    sequences.push_back(history.checkpoint());
+    states.push_back(grid.cells());
+  }
+  auto statistics = history.statistics();
+  BOOST_CHECK_EQUAL(statistics.entries, 40);
+  BOOST_CHECK_EQUAL(statistics.keyframes, 10);
+  BOOST_CHECK_EQUAL(statistics.evictions, 0);
+  // Any past state, in any order
+  for (auto ii : {3, 39, 0, 17, 16, 38, 5}) {
+    history.restore(sequences[ii]);
+    BOOST_CHECK(grid.cells() == states[ii]);
+  }
+  BOOST_CHECK_EQUAL(history.statistics().restores, 7);
+  // Undo, redo, and a new checkpoint after an undo drops the redo states
+  history.restore(sequences[20]);
+  BOOST_CHECK(history.undo());
+  BOOST_CHECK(grid.cells() == states[19]);
+  BOOST_CHECK(history.redo());
+  BOOST_CHECK(history.undo());
+  grid.set(63, 1000);
+  auto sequence = history.checkpoint();
+  BOOST_CHECK_EQUAL(history.size(), 21);
+  BOOST_CHECK(!history.redo());
+  BOOST_CHECK(!history.find(sequences[20]));
+  BOOST_CHECK_THROW(history.restore(sequences[20]), History::state_not_available);
+  history.restore(sequences[2]);
+  BOOST_CHECK(grid.cells() == states[2]);
+  history.restore(sequence);
+  BOOST_CHECK_EQUAL(grid.get(63), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(HistoryBudget) {
+  using History = mwheel::MementoHistory<CellChange>;
+  Grid grid(16);
+  History::Options options;
+  options.keyframe_interval = 8;
+  options.budget = 4096;
+  History history(grid, options);
+  vector<vector<int>> states;
+  vector<History::sequence_type> sequences;
+  for (auto ii = 0; ii < 500; ++ii) {
+    grid.set(ii % 16, ii);
+    sequences.push_back(history.checkpoint());
+    states.push_back(grid.cells());
+  }
+  weak_ptr<const mwheel::DeltaMemento<CellChange>> oldest = history.find(sequences[0]);
+  auto statistics = history.statistics();
+  BOOST_CHECK(statistics.bytes <= options.budget);
+  BOOST_CHECK(statistics.peak_bytes >= statistics.bytes);
+  BOOST_CHECK(statistics.evictions > 0);
+  BOOST_CHECK(statistics.allocations > 0);
+  BOOST_CHECK_EQUAL(statistics.entries + statistics.evictions, 500);
+  // Evicted states are gone, along with their changes
+  BOOST_CHECK(oldest.expired());
+  BOOST_CHECK_THROW(history.restore(sequences[0]), History::state_not_available);
+  auto first = 500 - statistics.entries;
+  for (auto ii : {first, size_t(499), first + 1, size_t(250)}) {
+    if (ii >= first) {
+      history.restore(sequences[ii]);
+      BOOST_CHECK(grid.cells() == states[ii]);
+    }
+  }
+}
+BOOST_AUTO_TEST_CASE(HistoryWithoutCoalesce) {
+  using History = mwheel::MementoHistory<CellChange>;
+  Tape tape(16);
+  History::Options options;
+  options.keyframe_interval = 8;
+  options.budget = 4096;
+  History history(tape, options);
+  vector<vector<int>> states;
+  vector<History::sequence_type> sequences;
+  for (auto ii = 0; ii < 2000; ++ii) {
+    tape.set(ii % 16, ii);
+    sequences.push_back(history.checkpoint());
+    states.push_back(tape.cells());
+  }
+  // Nothing can be merged: no keyframes, no evictions, one copy of each change
+  auto statistics = history.statistics();
+  BOOST_CHECK_EQUAL(statistics.entries, 2000);
+  BOOST_CHECK_EQUAL(statistics.keyframes, 0);
+  BOOST_CHECK_EQUAL(statistics.evictions, 0);
+  BOOST_CHECK_EQUAL(statistics.allocations, 0);
+  BOOST_CHECK(statistics.bytes > options.budget);
+  BOOST_CHECK(statistics.bytes <=
+              2000 * (sizeof(mwheel::DeltaMemento<CellChange>) + sizeof(CellChange)));
+  for (auto ii : {0, 1999, 1000, 1}) {
+    history.restore(sequences[ii]);
+    BOOST_CHECK(tape.cells() == states[ii]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MementoPooling) {
+  Counter counter;
+  for (auto ii = 0; ii < 1000; ++ii) {
+    auto token = counter.create_memento();
+    counter.increment();
+    counter.set_state(token);
+  }
+  BOOST_CHECK_EQUAL(counter.value(), 0);
+  auto statistics = counter.statistics();
+  BOOST_CHECK_EQUAL(statistics.allocations, 1);
+  BOOST_CHECK_EQUAL(statistics.reuses, 999);
+  BOOST_CHECK_EQUAL(statistics.free_blocks, 1);
+  counter.shrink();
+  BOOST_CHECK_EQUAL(counter.statistics().free_blocks, 0);
+  // Mementos may outlive the pool they come from
+  Counter::memento_type token;
+  {
+    Counter other;
+    other.increment();
+    token = other.create_memento();
+  }
+  BOOST_CHECK_EQUAL(token->value(), 1);
+  // Checkpointing within a bounded history reaches a steady state
+  using History = mwheel::MementoHistory<CellChange>;
+  Grid grid(16);
+  History::Options options;
+  options.keyframe_interval = 8;
+  options.budget = 4096;
+  History history(grid, options);
+  for (auto ii = 0; ii < 1000; ++ii) {
+    grid.set(ii % 16, ii);
+    history.checkpoint();
+  }
+  auto warm = grid.pool_statistics();
+  auto warm_deltas = grid.delta_statistics();
+  for (auto ii = 0; ii < 1000; ++ii) {
+    grid.set(ii % 16, ii);
+    history.checkpoint();
+  }
+  BOOST_CHECK_EQUAL(grid.pool_statistics().allocations, warm.allocations);
+  BOOST_CHECK(grid.pool_statistics().reuses > warm.reuses);
+  // The changes are recorded in the vectors of the evicted mementos
+  BOOST_CHECK(grid.delta_statistics().reuses > warm_deltas.reuses);
+  // Mementos released on another thread go back to the same pool
+  auto before = counter.statistics();
+  auto released = counter.create_memento();
+  std::async(std::launch::async, [&released]() { released.reset(); }).get();
+  BOOST_CHECK_EQUAL(counter.statistics().free_blocks, 1);
+  BOOST_CHECK_EQUAL(counter.create_memento()->value(), 0);
+  BOOST_CHECK_EQUAL(counter.statistics().allocations, before.allocations + 1);
+  BOOST_CHECK_EQUAL(counter.statistics().reuses, before.reuses + 1);
+}
+
+BOOST_AUTO_TEST_CASE(MementoLogs) {
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("memento-log-%%%%-%%%%.bin");
+  {
+    // A small buffer forces several writes
+    mwheel::MementoLog log(path, 64);
+    for (auto ii = 0; ii < 1000; ++ii) {
+      log.append(Checkpoint(ii));
+    }
+    BOOST_CHECK_EQUAL(log.size(), 1000);
+  }
+  auto mementos = mwheel::MementoLog::load<Checkpoint>(path);
+  BOOST_CHECK_EQUAL(mementos.size(), 1000);
+  BOOST_CHECK_EQUAL(mementos[0]->value(), 0);
+  BOOST_CHECK_EQUAL(mementos[999]->value(), 999);
+  // A record cut short by a crash is dropped, and appending resumes after the last good one
+  boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 2);
+  {
+    mwheel::MementoLog log(path);
+    BOOST_CHECK_EQUAL(log.size(), 999);
+    log.append(Checkpoint(-1));
+    log.flush(true);
+  }
+  mementos = mwheel::MementoLog::load<Checkpoint>(path);
+  BOOST_CHECK_EQUAL(mementos.size(), 1000);
+  BOOST_CHECK_EQUAL(mementos[998]->value(), 998);
+  BOOST_CHECK_EQUAL(mementos[999]->value(), -1);
+  // So is a tail whose size reached the disk before its data
+  auto intact_size = boost::filesystem::file_size(path);
+  {
+    fstream file(path.c_str(), ios::in | ios::out | ios::binary | ios::ate);
+    const string zeros(64, '\0');
+    file.write(zeros.data(), zeros.size());
+  }
+  {
+    mwheel::MementoLog log(path);
+    BOOST_CHECK_EQUAL(log.size(), 1000);
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), intact_size);
+    log.append(Checkpoint(-2));
+  }
+  mementos = mwheel::MementoLog::load<Checkpoint>(path);
+  BOOST_CHECK_EQUAL(mementos.size(), 1001);
+  BOOST_CHECK_EQUAL(mementos[1000]->value(), -2);
+  // Corrupted states are detected
+  {
+    fstream file(path.c_str(), ios::in | ios::out | ios::binary);
+    file.seekp(8 + 8);
+    file.put('\x7f');
+  }
+  BOOST_CHECK_THROW(mwheel::MementoLog::load<Checkpoint>(path), mwheel::MementoLog::log_error);
+  boost::filesystem::remove(path);
+  // Mementos without a binary fast path go through their files
+  {
+    mwheel::MementoLog log(path);
+    log.append(FileCheckpoint("first"));
+    log.append(FileCheckpoint(""));
+    log.append(FileCheckpoint("third"));
+  }
+  auto files = mwheel::MementoLog::load<FileCheckpoint>(path);
+  BOOST_CHECK_EQUAL(files.size(), 3);
+  BOOST_CHECK_EQUAL(files[0]->text(), "first");
+  BOOST_CHECK_EQUAL(files[1]->text(), "");
+  BOOST_CHECK_EQUAL(files[2]->text(), "third");
+  boost::filesystem::remove(path);
+  // Other files are not logs
+  BOOST_CHECK_THROW(mwheel::MementoLog::replay(path, [](mwheel::ByteSource &, size_t) {}),
+                    mwheel::MementoLog::log_error);
+}
+
+BOOST_AUTO_TEST_CASE(AsyncCapture) {
+  mwheel::ThreadPool pool(2);
+  promise<void> open;
+  Document document(pool, open.get_future().share());
+  document.set(0, 1);
+  // Modifying the state while the memento is created copies it once
+  auto first = document.capture();
+  document.set(0, 2);
+  document.set(1, 2);
+  BOOST_CHECK_EQUAL(document.copies(), 1);
+  open.set_value();
+  BOOST_CHECK_EQUAL(first.get()->at(0), 1);
+  BOOST_CHECK_EQUAL(first.get()->at(1), 0);
+  // Once the memento is ready the state is modified in place
+  auto second = document.capture();
+  second.wait();
+  document.set(0, 3);
+  BOOST_CHECK_EQUAL(document.copies(), 1);
+  BOOST_CHECK_EQUAL(second.get()->at(0), 2);
+  BOOST_CHECK_EQUAL(document.create_memento()->at(0), 3);
+  document.set_state(first.get());
+  BOOST_CHECK_EQUAL(document.get(0), 1);
+  // The memento is not modified through the state it was set from
+  document.set(0, 4);
+  BOOST_CHECK_EQUAL(first.get()->at(0), 1);
+  BOOST_CHECK_EQUAL(document.copies(), 2);
+  // Threads of the pool run whatever is submitted
+  BOOST_CHECK_EQUAL(pool.size(), 2);
+  BOOST_CHECK_EQUAL(pool.submit([]() { return 42; }).get(), 42);
+}
+BOOST_AUTO_TEST_SUITE_END()
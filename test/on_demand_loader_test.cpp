@@ -0,0 +1,92 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/on_demand_loader.h>
+
+#include <fixtures/client_interface.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(OnDemandLoaderTest)
+BOOST_AUTO_TEST_CASE(LoadOnFactoryMiss) {
+  using TheFactory = mwheel::test::ClientInterface::factory_type;
+  using FactoryType = mwheel::PrototypeFactory<mwheel::test::ClientInterface, string>;
+  auto plugins = boost::filesystem::temp_directory_path() /
+                 boost::filesystem::unique_path("mwheel-%%%%-%%%%-%%%%");
+  boost::filesystem::create_directories(plugins);
+  auto library = plugins / "libplugin_extension_test.so";
+  boost::filesystem::copy_file(
+      "@CMAKE_CURRENT_BINARY_DIR@/fixtures/libplugin_extension_test.so", library);
+  auto manifest_path = plugins / "manifest.txt";
+  {
+    // Learn which products are provided by the plug-in
+    mwheel::DLManager manager;
+    mwheel::PluginCatalog catalog(manifest_path);
+    catalog.scan(plugins, manager);
+    catalog.save();
+  }
+  {
+    mwheel::DLManager manager;
+    mwheel::PluginCatalog catalog(manifest_path);
+    catalog.scan(plugins, manager);
+    BOOST_CHECK_EQUAL(manager.is_loaded(library), false);
+    mwheel::OnDemandLoader loader(manager, catalog);
+    auto &factory = TheFactory::get_instance();
+    loader.attach(factory);
+    // Many threads miss the same tag at once
+    atomic<int> sum(0);
+    vector<thread> threads;
+    for (auto ii = 0; ii < 8; ++ii) {
+      threads.emplace_back([&]() { sum += factory.create("PluginExtension")->get(); });
+    }
+    for (auto &x : threads) {
+      x.join();
+    }
+    BOOST_CHECK_EQUAL(sum, 80);
+    BOOST_CHECK_EQUAL(manager.is_loaded(library), true);
+    BOOST_CHECK_EQUAL(factory.create("AnotherExtension")->get(), 10);
+    // Tags not provided by any plug-in still end up in the default action
+    BOOST_CHECK_THROW(factory.create("NotAnExtension"), FactoryType::tag_not_registered);
+    loader.detach(factory);
+    // A loader that goes away detaches itself
+    {
+      mwheel::OnDemandLoader other(manager, catalog);
+      other.attach(factory);
+    }
+    BOOST_CHECK_THROW(factory.create("NotAnExtension"), FactoryType::tag_not_registered);
+  }
+  boost::filesystem::remove_all(plugins);
+}
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/plugin_catalog.h>
+
+#include <fixtures/client_interface.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+using namespace std;
+
+namespace {
+
+/// Temporary directory removed at the end of the scope
+struct TemporaryDirectory {
+  TemporaryDirectory()
+      : path(boost::filesystem::temp_directory_path() /
+             boost::filesystem::unique_path("mwheel-%%%%-%%%%-%%%%")) {
+    boost::filesystem::create_directories(path);
+  }
+  ~TemporaryDirectory() { boost::filesystem::remove_all(path); }
+  boost::filesystem::path path;
+};
+}
+
+BOOST_AUTO_TEST_SUITE(PluginCatalogTest)
+BOOST_AUTO_TEST_CASE(DiscoveryAndCache) {
+  using TheFactory = mwheel::test::ClientInterface::factory_type;
+  using FactoryType = mwheel::PrototypeFactory<mwheel::test::ClientInterface, string>;
+  TemporaryDirectory plugins;
+  auto manifest_path = plugins.path / "manifest.txt";
+  auto library = plugins.path / "libplugin_extension_test.so";
+  boost::filesystem::copy_file(
+      "@CMAKE_CURRENT_BINARY_DIR@/fixtures/libplugin_extension_test.so", library);
+  {
+    // The first scan loads the library to learn its products
+    mwheel::DLManager manager;
+    mwheel::PluginCatalog catalog(manifest_path);
+    auto report = catalog.scan(plugins.path, manager);
+    BOOST_CHECK_EQUAL(report.unchanged.size(), 0);
+    BOOST_REQUIRE_EQUAL(report.loaded.size(), 1);
+    BOOST_CHECK_EQUAL(report.loaded[0].second.valid(), true);
+    BOOST_CHECK_EQUAL(manager.is_loaded(library), true);
+    BOOST_REQUIRE_EQUAL(catalog.entries().size(), 1);
+    BOOST_CHECK_EQUAL(catalog.entries().begin()->second.products.size(), 2);
+    auto provider = catalog.find_provider<FactoryType>("AnotherExtension");
+    BOOST_REQUIRE(provider);
+    BOOST_CHECK_EQUAL(provider->library, library);
+    BOOST_CHECK(!catalog.find_provider<FactoryType>("NotAnExtension"));
+    catalog.save();
+  }
+  BOOST_CHECK_EQUAL(TheFactory::get_instance().has_tag("PluginExtension"), false);
+  {
+    // The second scan trusts the manifest
+    mwheel::DLManager manager;
+    mwheel::PluginCatalog catalog(manifest_path);
+    auto provider = catalog.find_provider<FactoryType>("PluginExtension");
+    BOOST_REQUIRE(provider);
+    BOOST_CHECK_EQUAL(provider->library, library);
+    auto report = catalog.scan(plugins.path, manager);
+    BOOST_CHECK_EQUAL(report.unchanged.size(), 1);
+    BOOST_CHECK_EQUAL(report.loaded.size(), 0);
+    BOOST_CHECK_EQUAL(manager.is_loaded(library), false);
+    // Removed libraries are dropped
+    boost::filesystem::remove(library);
+    report = catalog.scan(plugins.path, manager);
+    BOOST_CHECK_EQUAL(report.removed.size(), 1);
+    BOOST_CHECK_EQUAL(catalog.entries().empty(), true);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(InvalidManifest) {
+  TemporaryDirectory plugins;
+  auto manifest_path = plugins.path / "manifest.txt";
+  {
+    boost::filesystem::ofstream output(manifest_path);
+    output << "this is not a manifest" << endl;
+  }
+  BOOST_CHECK_THROW(mwheel::PluginCatalog{manifest_path},
+                    mwheel::PluginCatalog::invalid_manifest);
+}
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,79 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+/**
+ * @file plugin_test.cpp
+ *
+ * @brief Unit tests for the plug-in support
+ *
+ * @author Massimiliano Culpo
+ *
+ * Created on October 18, 2026
+ */
+
+#include <mwheel/plugin.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(PluginTest)
+BOOST_AUTO_TEST_CASE(UnloaderOrder) {
+  using mwheel::implementation::unload_slot;
+  struct FirstSite {};
+  struct SecondSite {};
+  struct ThirdSite {};
+  vector<int> order;
+  auto first = [&order]() { order.push_back(1); };
+  auto second = [&order]() {
+    order.push_back(2);
+    throw runtime_error("unloading failed");
+  };
+  auto third = [&order]() { order.push_back(3); };
+  {
+    mwheel::implementation::PluginUnloader unloader;
+    auto &first_slot = unload_slot<FirstSite, decltype(first)>();
+    BOOST_REQUIRE(first_slot.arm(first));
+    // A slot holds a single action
+    BOOST_CHECK(!first_slot.arm(first));
+    unloader.on_unload(first_slot.node);
+    auto &second_slot = unload_slot<SecondSite, decltype(second)>();
+    BOOST_REQUIRE(second_slot.arm(second));
+    unloader.on_unload(second_slot.node);
+    auto &third_slot = unload_slot<ThirdSite, decltype(third)>();
+    BOOST_REQUIRE(third_slot.arm(third));
+    unloader.on_unload(third_slot.node);
+  }
+  // Reverse registration order, and a throwing action doesn't stop the others
+  BOOST_CHECK(order == (vector<int>{3, 2, 1}));
+  // Slots can be armed again once their action ran
+  BOOST_CHECK((unload_slot<FirstSite, decltype(first)>().node.run == nullptr));
+}
+BOOST_AUTO_TEST_SUITE_END()
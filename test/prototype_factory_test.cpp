@@ -31,7 +31,9 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/test/unit_test_suite.hpp>
 
+#include <future>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -111,6 +113,26 @@ BOOST_AUTO_TEST_CASE(NoParameters) {
   factory.on_tag_not_registered([](FactoryType::tag_type tag) { return nullptr; });
   BOOST_CHECK_EQUAL(factory.create("DerivedA"), FactoryType::product_type(nullptr));
 }
+BOOST_AUTO_TEST_CASE(TagResolver) {
+  using FactoryType = mwheel::PrototypeFactory<BaseMultiParms, int>;
+  FactoryType factory;
+  // The resolver registers the missing tag, so creation is retried with the same parameters
+  auto ncalls = 0;
+  factory.set_tag_resolver([&](int tag) {
+    ++ncalls;
+    return tag == 1 && factory.register_prototype(tag, make_shared<DerivedSum>(0));
+  });
+  BOOST_CHECK_EQUAL(factory.create(1, 3, 4)->get(), 7);
+  BOOST_CHECK_EQUAL(factory.create(1, 5)->get(), 5);
+  BOOST_CHECK_EQUAL(ncalls, 1);
+  // If the resolver fails the default action is taken
+  BOOST_CHECK_THROW(factory.create(2, 3), FactoryType::tag_not_registered);
+  BOOST_CHECK_EQUAL(ncalls, 2);
+  // An empty resolver is never called
+  factory.set_tag_resolver(nullptr);
+  BOOST_CHECK_THROW(factory.create(2, 3), FactoryType::tag_not_registered);
+  BOOST_CHECK_EQUAL(ncalls, 2);
+}
 BOOST_AUTO_TEST_CASE(MultipleParameters) {
   // Create a factory and register a type
   using FactoryType = mwheel::PrototypeFactory<BaseMultiParms, int>;
@@ -122,4 +144,36 @@ BOOST_AUTO_TEST_CASE(MultipleParameters) {
   auto objb = factory.create(0, 3, 6);
   BOOST_CHECK_EQUAL(objb->get(), 9);
 }
+BOOST_AUTO_TEST_CASE(UpdateBatch) {
+  using FactoryType = mwheel::PrototypeFactory<BaseMultiParms, int>;
+  FactoryType factory;
+  factory.register_prototype(0, make_shared<DerivedSum>(0));
+  auto seen_elsewhere = [&](int tag) {
+    return async(launch::async, [&factory, tag]() { return factory.has_tag(tag); }).get();
+  };
+  {
+    FactoryType::UpdateBatch batch(factory);
+    // A nested batch has no effect
+    FactoryType::UpdateBatch nested(factory);
+    BOOST_CHECK(factory.register_prototype(1, make_shared<DerivedSum>(0)));
+    BOOST_CHECK(!factory.register_prototype(1, make_shared<DerivedSum>(0)));
+    BOOST_CHECK(factory.register_prototype(2, make_shared<DerivedSum>(0)));
+    BOOST_CHECK(factory.unregister_prototype(0));
+    // The updates are seen only by the thread that made them
+    BOOST_CHECK(factory.has_tag(1));
+    BOOST_CHECK_EQUAL(factory.create(2, 3)->get(), 3);
+    BOOST_CHECK(!seen_elsewhere(1));
+    BOOST_CHECK(seen_elsewhere(0));
+    // Those of the other threads are not delayed, and are kept once the batch is published
+    auto elsewhere = async(launch::async, [&factory]() {
+      return factory.register_prototype(3, make_shared<DerivedSum>(0));
+    });
+    BOOST_CHECK(elsewhere.get());
+    BOOST_CHECK(seen_elsewhere(3));
+  }
+  BOOST_CHECK(seen_elsewhere(1));
+  BOOST_CHECK(!seen_elsewhere(0));
+  auto products = factory.product_list();
+  BOOST_CHECK((products == vector<int>{1, 2, 3}));
+}
 BOOST_AUTO_TEST_SUITE_END()
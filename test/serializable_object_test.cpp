@@ -0,0 +1,742 @@
+/**
+ *
+ * Modern Wheel : all the things that shouldn't be reinvented from one project to the other
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (C) 2015  Massimiliano Culpo
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <mwheel/async_serializer.h>
+#include <mwheel/byte_stream.h>
+#include <mwheel/compression.h>
+#include <mwheel/durable_file.h>
+#include <mwheel/mapped_file.h>
+#include <mwheel/object_archive.h>
+#include <mwheel/schema.h>
+#include <mwheel/serializable_object.h>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/test/unit_test_suite.hpp>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+/// Keeps the words of a text file
+class WordList : public mwheel::PathSerializable {
+public:
+  void add(string word) { m_words.push_back(std::move(word)); }
+
+  const vector<string> &words() const { return m_words; }
+
+protected:
+  void do_serialize_file(const boost::filesystem::path &path) const override {
+    ofstream output(path.c_str(), ios::binary);
+    for (const auto &x : m_words) {
+      output << x << '\n';
+    }
+  }
+
+  void do_deserialize_file(const boost::filesystem::path &path) override {
+    m_words.clear();
+    ifstream input(path.c_str(), ios::binary);
+    for (string word; getline(input, word);) {
+      m_words.push_back(word);
+    }
+  }
+
+private:
+  vector<string> m_words;
+};
+
+/// Array of integers that reads a mapped file in place
+class IntegerArray : public mwheel::PathSerializable {
+public:
+  vector<int32_t> &values() { return m_values; }
+
+  const int32_t *view() const { return m_view; }
+
+protected:
+  void do_serialize_file(const boost::filesystem::path &path) const override {
+    ofstream(path.c_str(), ios::binary)
+        .write(reinterpret_cast<const char *>(m_values.data()),
+               static_cast<streamsize>(m_values.size() * sizeof(int32_t)));
+  }
+
+  void do_deserialize_file(const boost::filesystem::path &path) override {
+    do_deserialize_mapped(mwheel::MappedFile(path));
+  }
+
+  void do_deserialize_mapped(const mwheel::MappedFile &file) override {
+    m_view = reinterpret_cast<const int32_t *>(file.data());
+    m_values.assign(m_view, m_view + file.size() / sizeof(int32_t));
+  }
+
+private:
+  vector<int32_t> m_values;
+  const int32_t *m_view = nullptr;
+};
+
+/// Point that needs no file system, and reads exactly its own bytes
+class Point : public mwheel::SerializableObject {
+public:
+  Point() : m_x(0), m_y(0) {}
+  Point(int32_t x, int32_t y) : m_x(x), m_y(y) {}
+
+  bool operator==(const Point &other) const { return m_x == other.m_x && m_y == other.m_y; }
+
+protected:
+  void do_serialize(mwheel::ByteSink &sink) const override {
+    mwheel::ConstBuffer buffers[] = {{&m_x, sizeof(m_x)}, {&m_y, sizeof(m_y)}};
+    sink.write(buffers, 2);
+  }
+
+  void do_deserialize(mwheel::ByteSource &source) override {
+    mwheel::MutableBuffer buffers[] = {{&m_x, sizeof(m_x)}, {&m_y, sizeof(m_y)}};
+    source.read(buffers, 2);
+  }
+
+private:
+  int32_t m_x;
+  int32_t m_y;
+};
+
+/// Integers that keep track of the bytes that changed
+class Ledger : public mwheel::IncrementalSerializableObject {
+public:
+  void set(size_t index, int32_t value) {
+    m_values[index] = value;
+    m_dirty.push_back({index * sizeof(int32_t), sizeof(int32_t)});
+  }
+
+  void resize(size_t size) {
+    m_values.resize(size);
+    m_dirty.push_back({0, state_size()});
+  }
+
+  const vector<int32_t> &values() const { return m_values; }
+
+  size_t state_size() const override { return m_values.size() * sizeof(int32_t); }
+
+  vector<Region> dirty_regions() const override { return m_dirty; }
+
+  void clear_dirty_regions() override { m_dirty.clear(); }
+
+protected:
+  void do_serialize_region(size_t offset, size_t size, char *destination) const override {
+    memcpy(destination, reinterpret_cast<const char *>(m_values.data()) + offset, size);
+  }
+
+  void do_deserialize(mwheel::ByteSource &source) override {
+    m_values.clear();
+    for (int32_t value; source.read_some(&value, sizeof(value)) == sizeof(value);) {
+      m_values.push_back(value);
+    }
+    m_dirty.clear();
+  }
+
+private:
+  vector<int32_t> m_values;
+  vector<Region> m_dirty;
+};
+
+/// Ledger compressed on the pool it is serialized from
+class CompressedLedger : public mwheel::SerializableObject {
+public:
+  explicit CompressedLedger(mwheel::ThreadPool &pool) : m_pool(pool) {}
+
+  Ledger &ledger() { return m_ledger; }
+
+protected:
+  void do_serialize(mwheel::ByteSink &sink) const override {
+    mwheel::CompressedSink compressed(sink, "lz", 4096, m_pool);
+    m_ledger.serialize(compressed);
+    compressed.finish();
+  }
+
+  void do_deserialize(mwheel::ByteSource &source) override {
+    mwheel::CompressedSource decompressed(source);
+    m_ledger.deserialize(decompressed);
+  }
+
+private:
+  mwheel::ThreadPool &m_pool;
+  Ledger m_ledger;
+};
+
+/// Fields laid out by a schema
+class Particle : public mwheel::SerializableObject {
+public:
+  enum class Kind : uint8_t { electron, proton };
+
+  int32_t id = 0;
+  Kind kind = Kind::electron;
+  double mass = 0.0;
+  bool alive = false;
+  string name;
+  vector<double> trajectory;
+  vector<int16_t> charges;
+  MWHEEL_SCHEMA(Particle, id, kind, mass, alive, name, trajectory, charges);
+};
+
+/// Schema with a single field
+class Counter : public mwheel::SerializableObject {
+public:
+  uint64_t count = 0;
+  MWHEEL_SCHEMA(Counter, count);
+};
+
+/// Overrides none of the versions
+class Unserializable : public mwheel::SerializableObject {};
+
+/// Overrides none of the path-based versions
+class UnserializablePath : public mwheel::PathSerializable {};
+
+static_assert(is_abstract<Unserializable>::value && is_abstract<UnserializablePath>::value,
+              "implementations must override one of the versions");
+}
+
+BOOST_AUTO_TEST_SUITE(SerializableObjectTest)
+BOOST_AUTO_TEST_CASE(MappedDeserialization) {
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("mapped-%%%%-%%%%.bin");
+  IntegerArray array;
+  for (auto ii = 0; ii < 10000; ++ii) {
+    array.values().push_back(ii);
+  }
+  array.serialize(path);
+  {
+    mwheel::MappedFile file(path);
+    BOOST_CHECK_EQUAL(file.size(), 10000 * sizeof(int32_t));
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(file.data()) % 4096, 0);
+    file.advise(mwheel::MappedFile::Access::random, 100, 100);
+    IntegerArray copy;
+    copy.deserialize(file);
+    BOOST_CHECK(copy.view() == reinterpret_cast<const int32_t *>(file.data()));
+    BOOST_CHECK(copy.values() == array.values());
+    // Mappings can be moved around
+    auto moved = std::move(file);
+    BOOST_CHECK_EQUAL(moved.size(), 10000 * sizeof(int32_t));
+    BOOST_CHECK(file.data() == nullptr);
+  }
+  // Path-based implementations read the mapped file through its path
+  WordList words;
+  words.add("alpha");
+  words.add("beta");
+  words.serialize(path);
+  WordList other;
+  other.deserialize(mwheel::MappedFile(path));
+  BOOST_CHECK(other.words() == words.words());
+  // Empty files map to an empty view
+  boost::filesystem::resize_file(path, 0);
+  mwheel::MappedFile empty(path);
+  BOOST_CHECK_EQUAL(empty.size(), 0);
+  BOOST_CHECK(empty.data() == nullptr);
+  // The others read the mapping, even once the file is removed
+  Point(5, 6).serialize(path);
+  {
+    mwheel::MappedFile file(path);
+    boost::filesystem::remove(path);
+    Point point;
+    point.deserialize(file);
+    BOOST_CHECK(point == Point(5, 6));
+  }
+  BOOST_CHECK_THROW(mwheel::MappedFile file(path), mwheel::MappedFile::mapping_error);
+}
+
+BOOST_AUTO_TEST_CASE(SinksAndSources) {
+  // Many objects in one buffer, without touching the file system
+  vector<char> buffer;
+  mwheel::VectorSink sink(buffer);
+  for (auto ii = 0; ii < 1000; ++ii) {
+    Point(ii, -ii).serialize(sink);
+  }
+  BOOST_CHECK_EQUAL(buffer.size(), 1000 * 2 * sizeof(int32_t));
+  mwheel::MemorySource source(buffer.data(), buffer.size());
+  for (auto ii = 0; ii < 1000; ++ii) {
+    Point point;
+    point.deserialize(source);
+    BOOST_CHECK(point == Point(ii, -ii));
+  }
+  BOOST_CHECK_EQUAL(source.remaining(), 0);
+  Point point;
+  BOOST_CHECK_THROW(point.deserialize(source), mwheel::ByteSource::read_error);
+  // Scatter/gather through a pipe
+  int fds[2];
+  BOOST_REQUIRE_EQUAL(::pipe(fds), 0);
+  {
+    mwheel::FileDescriptorSink pipe_sink(fds[1]);
+    Point(7, 8).serialize(pipe_sink);
+    ::close(fds[1]);
+    mwheel::FileDescriptorSource pipe_source(fds[0]);
+    point.deserialize(pipe_source);
+    BOOST_CHECK(point == Point(7, 8));
+    BOOST_CHECK_THROW(point.deserialize(pipe_source), mwheel::ByteSource::read_error);
+    ::close(fds[0]);
+  }
+  // Path and stream versions adapt the sink/source ones
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("point-%%%%-%%%%.bin");
+  Point(1, 2).serialize(path);
+  BOOST_CHECK_EQUAL(boost::filesystem::file_size(path), 2 * sizeof(int32_t));
+  point.deserialize(path);
+  BOOST_CHECK(point == Point(1, 2));
+  stringstream stream;
+  Point(3, 4).serialize(stream);
+  point.deserialize(stream, 2 * sizeof(int32_t));
+  BOOST_CHECK(point == Point(3, 4));
+  // Path-based implementations still work with sinks and sources
+  WordList words;
+  words.add("gamma");
+  words.add("delta");
+  buffer.clear();
+  words.serialize(sink);
+  BOOST_CHECK_EQUAL(string(buffer.begin(), buffer.end()), "gamma\ndelta\n");
+  WordList other;
+  mwheel::MemorySource words_source(buffer.data(), buffer.size());
+  other.deserialize(words_source);
+  BOOST_CHECK(other.words() == words.words());
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(Archives) {
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("archive-%%%%-%%%%.bin");
+  mwheel::ThreadPool pool(4);
+  vector<Point> points;
+  for (auto ii = 0; ii < 10000; ++ii) {
+    points.emplace_back(ii, 2 * ii);
+  }
+  vector<shared_ptr<WordList>> lists(3, make_shared<WordList>());
+  lists[1] = make_shared<WordList>();
+  lists[1]->add("epsilon");
+  {
+    mwheel::ArchiveWriter writer(path, pool);
+    writer.write(points.begin(), points.end());
+    writer.write(lists.begin(), lists.end());
+    BOOST_CHECK_EQUAL(writer.size(), 10003);
+    // Archives that are not committed can't be read
+    BOOST_CHECK_THROW(mwheel::ArchiveReader reader(path), mwheel::ArchiveReader::archive_error);
+    writer.commit();
+    BOOST_CHECK_THROW(writer.write(points.begin(), points.end()),
+                      mwheel::ArchiveWriter::archive_error);
+    BOOST_CHECK_THROW(writer.commit(), mwheel::ArchiveWriter::archive_error);
+  }
+  {
+    mwheel::ArchiveReader reader(path);
+    BOOST_CHECK_EQUAL(reader.size(), 10003);
+    BOOST_CHECK_EQUAL(reader.state_size(0), 2 * sizeof(int32_t));
+    for (auto ii : {9999, 0, 4711, 2500, 5000}) {
+      Point point;
+      reader.read(ii, point);
+      BOOST_CHECK(point == points[ii]);
+    }
+    WordList words;
+    reader.read(10001, words);
+    BOOST_CHECK(words.words() == lists[1]->words());
+    reader.read(10002, words);
+    BOOST_CHECK(words.words().empty());
+    Point point;
+    BOOST_CHECK_THROW(reader.read(10003, point), mwheel::ArchiveReader::archive_error);
+    BOOST_CHECK_THROW(reader.state_size(10003), mwheel::ArchiveReader::archive_error);
+  }
+  // Corrupted states are detected when they are read
+  {
+    fstream file(path.c_str(), ios::in | ios::out | ios::binary);
+    file.seekp(8 + 3);
+    file.put('\x7f');
+  }
+  mwheel::ArchiveReader reader(path);
+  Point point;
+  BOOST_CHECK_THROW(reader.read(0, point), mwheel::ArchiveReader::archive_error);
+  reader.read(1, point);
+  BOOST_CHECK(point == points[1]);
+  boost::filesystem::remove(path);
+  // A write that fails leaves the writer unusable
+  auto failed_path = boost::filesystem::temp_directory_path() /
+                     boost::filesystem::unique_path("archive-%%%%-%%%%.bin");
+  {
+    mwheel::ArchiveWriter writer(failed_path, pool);
+    rlimit previous;
+    BOOST_REQUIRE_EQUAL(::getrlimit(RLIMIT_FSIZE, &previous), 0);
+    auto handler = ::signal(SIGXFSZ, SIG_IGN);
+    auto limit = previous;
+    limit.rlim_cur = 4096;
+    BOOST_REQUIRE_EQUAL(::setrlimit(RLIMIT_FSIZE, &limit), 0);
+    BOOST_CHECK_THROW(writer.write(points.begin(), points.end()),
+                      mwheel::ArchiveWriter::archive_error);
+    ::setrlimit(RLIMIT_FSIZE, &previous);
+    ::signal(SIGXFSZ, handler);
+    BOOST_CHECK_THROW(writer.write(points.begin(), points.begin() + 1),
+                      mwheel::ArchiveWriter::archive_error);
+    BOOST_CHECK_THROW(writer.commit(), mwheel::ArchiveWriter::archive_error);
+    BOOST_CHECK_EQUAL(writer.size(), 0);
+  }
+  BOOST_CHECK_THROW(mwheel::ArchiveReader reader(failed_path),
+                    mwheel::ArchiveReader::archive_error);
+  boost::filesystem::remove(failed_path);
+}
+
+BOOST_AUTO_TEST_CASE(AsyncSerialization) {
+  auto directory = boost::filesystem::temp_directory_path() /
+                   boost::filesystem::unique_path("async-%%%%-%%%%");
+  boost::filesystem::create_directory(directory);
+  mwheel::ThreadPool pool(4);
+  for (auto use_io_uring : {true, false}) {
+    mwheel::AsyncSerializer::Options options;
+    options.queue_depth = 8;
+    options.use_io_uring = use_io_uring;
+    mwheel::AsyncSerializer serializer(pool, options);
+    if (!use_io_uring) {
+      BOOST_CHECK(serializer.backend() == mwheel::AsyncSerializer::Backend::thread_pool);
+    }
+    vector<Point> points;
+    for (auto ii = 0; ii < 200; ++ii) {
+      points.emplace_back(ii, -ii);
+    }
+    WordList words;
+    words.add("zeta");
+    words.add("eta");
+    auto name = [&directory](int ii) { return directory / to_string(ii); };
+    vector<future<void>> writes;
+    for (auto ii = 0; ii < 200; ++ii) {
+      writes.push_back(serializer.serialize(points[ii], name(ii)));
+      BOOST_CHECK_LE(serializer.in_flight(), 8);
+    }
+    writes.push_back(serializer.serialize(words, name(200)));
+    for (auto &x : writes) {
+      x.get();
+    }
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(name(199)), 2 * sizeof(int32_t));
+    vector<Point> copies(200);
+    WordList other;
+    vector<future<void>> reads;
+    for (auto ii = 0; ii < 200; ++ii) {
+      reads.push_back(serializer.deserialize(copies[ii], name(ii)));
+    }
+    reads.push_back(serializer.deserialize(other, name(200)));
+    serializer.wait();
+    BOOST_CHECK_EQUAL(serializer.in_flight(), 0);
+    for (auto &x : reads) {
+      x.get();
+    }
+    BOOST_CHECK(copies == points);
+    BOOST_CHECK(other.words() == words.words());
+    // Failures are reported through the futures
+    Point point;
+    auto missing = serializer.deserialize(point, directory / "missing");
+    BOOST_CHECK_THROW(missing.get(), std::runtime_error);
+    ofstream(name(201).c_str(), ios::binary) << "abc";
+    auto truncated = serializer.deserialize(point, name(201));
+    BOOST_CHECK_THROW(truncated.get(), mwheel::ByteSource::read_error);
+  }
+  boost::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(AtomicWrites) {
+  auto directory = boost::filesystem::temp_directory_path() /
+                   boost::filesystem::unique_path("atomic-%%%%-%%%%");
+  boost::filesystem::create_directory(directory);
+  auto path = directory / "point.bin";
+  Point(1, 1).serialize_atomically(path);
+  Point(2, 3).serialize_atomically(path);
+  Point point;
+  point.deserialize(path);
+  BOOST_CHECK(point == Point(2, 3));
+  // Nothing changes until the commit
+  {
+    mwheel::AtomicFileSink sink(path);
+    Point(4, 5).serialize(sink);
+    point.deserialize(path);
+    BOOST_CHECK(point == Point(2, 3));
+  }
+  point.deserialize(path);
+  BOOST_CHECK(point == Point(2, 3));
+  {
+    mwheel::AtomicFileSink sink(path);
+    Point(4, 5).serialize(sink);
+    sink.commit();
+    BOOST_CHECK_THROW(sink.commit(), mwheel::AtomicFileSink::commit_error);
+    BOOST_CHECK_THROW(Point(6, 7).serialize(sink), mwheel::ByteSink::write_error);
+  }
+  point.deserialize(path);
+  BOOST_CHECK(point == Point(4, 5));
+  // No temporary file is left behind
+  auto entries = distance(boost::filesystem::directory_iterator(directory),
+                          boost::filesystem::directory_iterator());
+  BOOST_CHECK_EQUAL(entries, 1);
+  boost::filesystem::remove_all(directory);
+}
+
+BOOST_AUTO_TEST_CASE(IncrementalWrites) {
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("incremental-%%%%-%%%%.bin");
+  Ledger ledger;
+  ledger.resize(1000);
+  for (auto ii = 0; ii < 1000; ++ii) {
+    ledger.set(ii, ii);
+  }
+  Ledger copy;
+  {
+    mwheel::IncrementalFile file(path, 64);
+    BOOST_CHECK_THROW(file.read(copy), mwheel::IncrementalFile::file_error);
+    BOOST_CHECK_EQUAL(file.write(ledger), 63);
+    // Only the blocks that changed are written
+    ledger.set(0, -1);
+    ledger.set(999, -1);
+    BOOST_CHECK_EQUAL(file.write(ledger), 2);
+    BOOST_CHECK_EQUAL(file.write(ledger), 0);
+    file.read(copy);
+    BOOST_CHECK(copy.values() == ledger.values());
+  }
+  // The file remembers its checksums, and its block size
+  {
+    mwheel::IncrementalFile file(path);
+    BOOST_CHECK_EQUAL(file.block_size(), 64);
+    ledger.set(500, 42);
+    BOOST_CHECK_EQUAL(file.write(ledger), 1);
+    ledger.resize(1010);
+    ledger.clear_dirty_regions();
+    ledger.set(1005, 7);
+    BOOST_CHECK_EQUAL(file.write(ledger), 2);
+    file.read(copy);
+    BOOST_CHECK(copy.values() == ledger.values());
+    ledger.resize(10);
+    file.write(ledger);
+    file.read(copy);
+    BOOST_CHECK(copy.values() == ledger.values());
+  }
+  // Corrupted blocks are detected
+  {
+    fstream file(path.c_str(), ios::in | ios::out | ios::binary);
+    file.seekp(4096 + 5);
+    file.put('\x7f');
+  }
+  mwheel::IncrementalFile file(path);
+  BOOST_CHECK_THROW(file.read(copy), mwheel::IncrementalFile::file_error);
+  // Headers that don't fit the file are rewritten, or rejected
+  auto overwrite = [&path](streamoff offset, uint64_t value) {
+    fstream stream(path.c_str(), ios::in | ios::out | ios::binary);
+    stream.seekp(offset);
+    for (auto ii = 0; ii < 8; ++ii) {
+      stream.put(static_cast<char>((value >> (8 * ii)) & 0xff));
+    }
+  };
+  overwrite(16, uint64_t(1) << 40);
+  {
+    mwheel::IncrementalFile other(path);
+    BOOST_CHECK_THROW(other.read(copy), mwheel::IncrementalFile::file_error);
+    BOOST_CHECK_EQUAL(other.write(ledger), 1);
+    other.read(copy);
+    BOOST_CHECK(copy.values() == ledger.values());
+  }
+  overwrite(8, uint64_t(1) << 62);
+  BOOST_CHECK_THROW(mwheel::IncrementalFile other(path), mwheel::IncrementalFile::file_error);
+  // Other files are rejected
+  WordList words;
+  words.add("theta");
+  words.serialize(path);
+  BOOST_CHECK_THROW(mwheel::IncrementalFile other(path), mwheel::IncrementalFile::file_error);
+  boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(Compression) {
+  mwheel::ThreadPool pool(4);
+  Ledger ledger;
+  ledger.resize(100000);
+  for (auto ii = 0; ii < 100000; ++ii) {
+    ledger.set(ii, ii % 100);
+  }
+  const auto original = reinterpret_cast<const char *>(ledger.values().data());
+  auto codecs = mwheel::Codec::factory_type::get_instance().product_list();
+  BOOST_CHECK(find(codecs.begin(), codecs.end(), "identity") != codecs.end());
+  BOOST_CHECK(find(codecs.begin(), codecs.end(), "lz") != codecs.end());
+  for (const auto &codec : codecs) {
+    vector<char> buffer;
+    mwheel::VectorSink sink(buffer);
+    mwheel::CompressedSink compressed(sink, codec, 4096, pool);
+    ledger.serialize(compressed);
+    compressed.finish();
+    if (codec != "identity") {
+      BOOST_CHECK_LT(buffer.size(), ledger.state_size() / 5);
+    }
+    // Streaming decompression
+    mwheel::MemorySource source(buffer.data(), buffer.size());
+    mwheel::CompressedSource decompressed(source);
+    Ledger copy;
+    copy.deserialize(decompressed);
+    BOOST_CHECK(copy.values() == ledger.values());
+    // Random access, within a block and across many of them
+    mwheel::CompressedReader reader(buffer.data(), buffer.size(), pool);
+    BOOST_CHECK_EQUAL(reader.size(), ledger.state_size());
+    BOOST_CHECK_EQUAL(reader.blocks(), (ledger.state_size() + 4095) / 4096);
+    vector<char> range(50000);
+    reader.read(1000, 10, range.data());
+    BOOST_CHECK(equal(range.begin(), range.begin() + 10, original + 1000));
+    reader.read(123457, 50000, range.data());
+    BOOST_CHECK(equal(range.begin(), range.end(), original + 123457));
+    BOOST_CHECK_THROW(reader.read(ledger.state_size() - 1, 2, range.data()),
+                      mwheel::Codec::corrupted_data);
+  }
+  // Incompressible blocks are stored as they are
+  mt19937 generator(42);
+  vector<char> noise(10000);
+  for (auto &x : noise) {
+    x = static_cast<char>(generator());
+  }
+  vector<char> buffer;
+  mwheel::VectorSink sink(buffer);
+  {
+    mwheel::CompressedSink compressed(sink, "lz", 4096, pool);
+    compressed.write(noise.data(), noise.size());
+    compressed.finish();
+    BOOST_CHECK_THROW(compressed.write(noise.data(), 1), mwheel::ByteSink::write_error);
+  }
+  BOOST_CHECK_LT(buffer.size(), noise.size() + 200);
+  mwheel::CompressedReader reader(buffer.data(), buffer.size(), pool);
+  vector<char> copy(noise.size());
+  reader.read(0, copy.size(), copy.data());
+  BOOST_CHECK(copy == noise);
+  // Corrupted blocks are detected
+  buffer[100] ^= 0x7f;
+  mwheel::CompressedReader corrupted(buffer.data(), buffer.size(), pool);
+  BOOST_CHECK_THROW(corrupted.read(0, 10, copy.data()), mwheel::Codec::corrupted_data);
+  BOOST_CHECK_THROW(mwheel::CompressedReader(buffer.data(), 10, pool),
+                    mwheel::Codec::corrupted_data);
+  using CodecFactory = mwheel::PrototypeFactory<mwheel::Codec, string>;
+  BOOST_CHECK_THROW(mwheel::CompressedSink(sink, "unknown"), CodecFactory::tag_not_registered);
+}
+
+BOOST_AUTO_TEST_CASE(NestedParallelism) {
+  // Objects compress their state on the same pool that serializes them
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("nested-%%%%-%%%%.bin");
+  mwheel::ThreadPool pool(4);
+  vector<shared_ptr<CompressedLedger>> ledgers;
+  for (auto ii = 0; ii < 64; ++ii) {
+    ledgers.push_back(make_shared<CompressedLedger>(pool));
+    ledgers.back()->ledger().resize(20000);
+    for (auto jj = 0; jj < 20000; ++jj) {
+      ledgers.back()->ledger().set(jj, (ii + jj) % 50);
+    }
+  }
+  {
+    mwheel::ArchiveWriter writer(path, pool);
+    writer.write(ledgers.begin(), ledgers.end());
+    writer.commit();
+  }
+  mwheel::ArchiveReader reader(path);
+  BOOST_CHECK_EQUAL(reader.size(), 64);
+  for (auto ii : {0, 17, 63}) {
+    CompressedLedger copy(pool);
+    reader.read(ii, copy);
+    BOOST_CHECK(copy.ledger().values() == ledgers[ii]->ledger().values());
+  }
+  boost::filesystem::remove(path);
+  // Random access from inside the pool
+  vector<char> buffer;
+  mwheel::VectorSink sink(buffer);
+  ledgers[0]->serialize(sink);
+  const char *stream = buffer.data();
+  auto size = buffer.size();
+  vector<future<bool>> reads;
+  for (auto ii = 0; ii < 16; ++ii) {
+    reads.push_back(pool.submit([stream, size, &pool, &ledgers]() {
+      mwheel::CompressedReader reader(stream, size, pool);
+      vector<int32_t> values(20000);
+      reader.read(0, reader.size(), reinterpret_cast<char *>(values.data()));
+      return values == ledgers[0]->ledger().values();
+    }));
+  }
+  for (auto &x : reads) {
+    BOOST_CHECK(x.get());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SchemaViews) {
+  Particle particle;
+  particle.id = 42;
+  particle.kind = Particle::Kind::proton;
+  particle.mass = 1.007;
+  particle.alive = true;
+  particle.name = "p+";
+  particle.trajectory = {0.5, 1.5, 2.5};
+  particle.charges = {-1, 0, 1, 2};
+  vector<char> buffer;
+  mwheel::VectorSink sink(buffer);
+  particle.serialize(sink);
+  // Fields are read in place
+  auto view = Particle::view(buffer.data(), buffer.size());
+  BOOST_CHECK_EQUAL(view.id(), 42);
+  BOOST_CHECK(view.kind() == Particle::Kind::proton);
+  BOOST_CHECK_EQUAL(view.mass(), 1.007);
+  BOOST_CHECK(view.alive());
+  BOOST_CHECK(view.name() == "p+");
+  BOOST_CHECK_EQUAL(view.trajectory().size(), 3);
+  BOOST_CHECK_EQUAL(view.trajectory()[2], 2.5);
+  BOOST_CHECK(view.trajectory().data() >= reinterpret_cast<const double *>(buffer.data()));
+  BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(view.trajectory().data()) % 8, 0);
+  BOOST_CHECK(view.charges().to_vector() == particle.charges);
+  // ... or copied back into an object
+  Particle copy;
+  mwheel::MemorySource source(buffer.data(), buffer.size());
+  copy.deserialize(source);
+  BOOST_CHECK_EQUAL(copy.id, 42);
+  BOOST_CHECK(copy.kind == Particle::Kind::proton);
+  BOOST_CHECK(copy.alive);
+  BOOST_CHECK_EQUAL(copy.name, "p+");
+  BOOST_CHECK(copy.trajectory == particle.trajectory);
+  BOOST_CHECK(copy.charges == particle.charges);
+  // Mapped files are viewed without reading them
+  auto path = boost::filesystem::temp_directory_path() /
+              boost::filesystem::unique_path("schema-%%%%-%%%%.bin");
+  Counter counter;
+  counter.count = 1ull << 40;
+  counter.serialize(path);
+  {
+    mwheel::MappedFile file(path);
+    BOOST_CHECK_EQUAL(Counter::view(file.data(), file.size()).count(), 1ull << 40);
+    BOOST_CHECK_THROW(Particle::view(file.data(), file.size()), mwheel::schema::invalid_layout);
+  }
+  boost::filesystem::remove(path);
+  // Layouts are checked when the view is created
+  BOOST_CHECK_THROW(Particle::view(buffer.data(), 16), mwheel::schema::invalid_layout);
+  buffer.pop_back();
+  BOOST_CHECK_THROW(Particle::view(buffer.data(), buffer.size()), mwheel::schema::invalid_layout);
+}
+BOOST_AUTO_TEST_SUITE_END()